@@ -0,0 +1,142 @@
+// Benchmark of the all-to-all coupling y = K * sin(x) with a dense coupling matrix K:
+// the MatVecExpression against a naive kernel which computes one row per thread.
+
+#include "dense/matrix.hpp"
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+typedef double value_type;
+
+using Dim = alpaka::DimInt<1u>;
+using Idx = std::size_t;
+using Acc = alpaka::ExampleDefaultAcc<Dim, Idx>;
+using QueueAcc = alpaka::Queue<Acc, alpaka::Blocking>;
+using BufAcc = alpaka::Buf<Acc, value_type, Dim, Idx>;
+using state_type = Vector<BufAcc, QueueAcc, Acc>;
+using matrix_type = Matrix<BufAcc, QueueAcc, Acc>;
+
+//! y_i = sum_j K_ij sin(x_j), sin is evaluated for every element of the matrix
+struct NaiveMatVecKernel
+{
+    template<typename TAcc>
+    ALPAKA_FN_ACC void operator()(
+        TAcc const& acc,
+        value_type* const y,
+        value_type const* const K,
+        value_type const* const x,
+        Idx const N) const
+    {
+        Idx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+        Idx const threadElemExtent(alpaka::getWorkDiv<alpaka::Thread, alpaka::Elems>(acc)[0u]);
+        Idx const first = gridThreadIdx * threadElemExtent;
+        Idx const last = std::min(first + threadElemExtent, N);
+
+        for(Idx i = first; i < last; ++i)
+        {
+            value_type sum = 0;
+            for(Idx j = 0; j < N; ++j)
+                sum += K[i * N + j] * alpaka::math::sin(acc, x[j]);
+            y[i] = sum;
+        }
+    }
+};
+
+template<typename TFunc>
+double measure(TFunc&& func, int repetitions)
+{
+    func(); // warm up
+    auto const start = std::chrono::steady_clock::now();
+    for(int r = 0; r < repetitions; ++r)
+        func();
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / repetitions;
+}
+
+int main(int argc, char** argv)
+{
+    // the largest size needs N * N * 8 bytes (8 GiB for N = 32768) on the host and on the device
+    Idx const maxN = argc > 1 ? static_cast<Idx>(std::atol(argv[1])) : 32768;
+    int const repetitions = 5;
+
+    auto const devAcc = alpaka::getDevByIdx<Acc>(0u);
+    QueueAcc queue(devAcc);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+    std::cout << "N\tblocked [ms]\tnaive [ms]\tblocked [GB/s]\tmax difference\n";
+
+    for(Idx N = 1024; N <= maxN; N *= 2)
+    {
+        std::vector<value_type> K(N * N);
+        std::vector<value_type> x0(N);
+        for(Idx i = 0; i < N; ++i)
+        {
+            x0[i] = 2.0 * M_PI * static_cast<value_type>(i) / static_cast<value_type>(N);
+            for(Idx j = 0; j < N; ++j)
+                K[i * N + j] = 1.0 + 0.5 * std::cos(static_cast<value_type>(i + 2 * j));
+        }
+
+        matrix_type coupling(queue, N, N, K);
+        state_type x(queue, N);
+        state_type blocked(queue, N);
+        state_type naive(queue, N);
+        alpaka::memcpy(
+            queue,
+            x.getBuffer(),
+            alpaka::createView(alpaka::getDevByIdx<alpaka::DevCpu>(0u), x0.data(), alpaka::Vec<Dim, Idx>(N)));
+        alpaka::wait(queue);
+
+        // the coupling matrix is modified before every product, so the memoized result is not reused
+        auto const blockedTime = measure(
+            [&]
+            {
+                coupling.getData().markModified();
+                blocked = coupling * sin(x);
+            },
+            repetitions);
+
+        alpaka::WorkDivMembers<Dim, Idx> const workDiv(alpaka::getValidWorkDiv<Acc>(
+            devAcc,
+            alpaka::Vec<Dim, Idx>(N),
+            Idx{1},
+            false,
+            alpaka::GridBlockExtentSubDivRestrictions::Unrestricted));
+        auto const naiveTime = measure(
+            [&]
+            {
+                alpaka::enqueue(
+                    queue,
+                    alpaka::createTaskKernel<Acc>(
+                        workDiv,
+                        NaiveMatVecKernel{},
+                        naive.getPtr(),
+                        static_cast<value_type const*>(coupling.getPtr()),
+                        static_cast<value_type const*>(x.getPtr()),
+                        N));
+                alpaka::wait(queue);
+            },
+            repetitions);
+
+        std::vector<value_type> blockedHost(N), naiveHost(N);
+        auto const extent = alpaka::Vec<Dim, Idx>(N);
+        auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+        alpaka::memcpy(queue, alpaka::createView(devHost, blockedHost.data(), extent), blocked.getConstBuffer());
+        alpaka::memcpy(queue, alpaka::createView(devHost, naiveHost.data(), extent), naive.getConstBuffer());
+        alpaka::wait(queue);
+
+        value_type difference = 0;
+        for(Idx i = 0; i < N; ++i)
+            difference = std::max(difference, std::abs(blockedHost[i] - naiveHost[i]));
+
+        auto const bytes = static_cast<double>(N) * static_cast<double>(N) * sizeof(value_type);
+        std::cout << N << '\t' << blockedTime * 1e3 << '\t' << naiveTime * 1e3 << '\t' << bytes / blockedTime * 1e-9
+                  << '\t' << difference << '\n';
+    }
+}
@@ -7,41 +7,19 @@
 #include <alpaka/example/ExampleDefaultAcc.hpp>
 
 #include <boost/numeric/odeint.hpp>
-#include <boost/random/cauchy_distribution.hpp>
 #include <boost/timer.hpp>
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 #include <utility>
+#include <vector>
 
 using namespace std;
 
 using namespace boost::numeric::odeint;
 
-// /*
-//  * Sorry for that dirty hack, but nvcc has large problems with boost::random.
-//  *
-//  * Nevertheless we need the cauchy distribution from boost::random, and therefore
-//  * we need a generator. Here it is:
-//  */
-struct drand48_generator
-{
-    typedef double result_type;
-    result_type operator()(void) const
-    {
-        return drand48();
-    }
-    result_type min(void) const
-    {
-        return 0.0;
-    }
-    result_type max(void) const
-    {
-        return 1.0;
-    }
-};
-
 // change this to float if your device does not support double computation
 typedef double value_type;
 
@@ -52,16 +30,16 @@ using QueueProperty = alpaka::Blocking;
 using QueueAcc = alpaka::Queue<Acc, QueueProperty>;
 using BufAcc = alpaka::Buf<Acc, value_type, Dim, Idx>;
 using state_type = alpaka_buffer_wrapper<BufAcc, QueueAcc, Acc>;
-using DevHost = alpaka::DevCpu;
-using BufHost = alpaka::Buf<DevHost, value_type, Dim, Idx>;
 
 
 struct mean_field_calculator
 {
     static std::pair<value_type, value_type> get_mean(state_type const& x)
     {
-        auto sin_sum = x.sin().sum().compute();
-        auto cos_sum = x.cos().sum().compute();
+        // one pass over x with a single sincos per element
+        auto const sums = x.sincos().sum().compute();
+        auto sin_sum = sums.sin;
+        auto cos_sum = sums.cos;
 
         cos_sum /= value_type(x.getExtent()[0]);
         sin_sum /= value_type(x.getExtent()[0]);
@@ -133,6 +111,91 @@ struct statistics_observer
 };
 
 
+// All values of epsilon in one pass: the P ensembles are stacked into one state of P * N phases, the
+// phases of ensemble p are the segment [p * N, (p + 1) * N) and it is coupled by its own mean field.
+
+//! epsilon_p K_p sin(Theta_p - x_i) of the segment p of x_i, where K_p e^(i Theta_p) = (cos_sum + i sin_sum) / N.
+struct segment_coupling
+{
+    Idx n;
+
+    template<typename TX, typename TSums, typename TEpsilon>
+    ALPAKA_FN_ACC auto operator()(Idx i, TX const& x, TSums const& sums, TEpsilon const& epsilon) const -> value_type
+    {
+        Idx const p = i / n;
+        auto const sum = sums[p];
+        value_type const xi = x[i];
+        return epsilon[p] / value_type(n) * (sum.sin * cos(xi) - sum.cos * sin(xi));
+    }
+};
+
+//! K_p of every segment.
+struct segment_order_parameter
+{
+    Idx n;
+
+    template<typename TSums>
+    ALPAKA_FN_ACC auto operator()(Idx p, TSums const& sums) const -> value_type
+    {
+        auto const sum = sums[p];
+        return sqrt(sum.cos * sum.cos + sum.sin * sum.sin) / value_type(n);
+    }
+};
+
+class batched_phase_oscillator_ensemble
+{
+public:
+    //! omega holds the frequencies of all P * N oscillators, epsilon one value per ensemble.
+    batched_phase_oscillator_ensemble(state_type const& omega, state_type const& epsilon, Idx n)
+        : m_omega(omega)
+        , m_epsilon(epsilon)
+        , m_n(n)
+    {
+    }
+
+    void operator()(state_type const& x, state_type& dxdt, value_type const dt) const
+    {
+        // one kernel reduces the mean fields of all ensembles, one kernel computes all derivatives
+        auto const sums = segmented_sum(x.sincos(), m_n);
+        dxdt = m_omega + indexed(segment_coupling{m_n}, x, sums, m_epsilon);
+    }
+
+private:
+    state_type m_omega;
+    state_type m_epsilon;
+    Idx m_n;
+};
+
+//! Sums K_p of every ensemble on the device, nothing is copied to the host until the end.
+struct batched_statistics_observer
+{
+    state_type m_K_sum;
+    Idx m_n;
+    size_t m_count;
+
+    batched_statistics_observer(QueueAcc queue, Idx batch, Idx n) : m_K_sum(queue, batch), m_n(n), m_count(0)
+    {
+        m_K_sum = fill<Acc>(queue, value_type(0), batch);
+    }
+
+    template<class State>
+    void operator()(State const& x, value_type t)
+    {
+        m_K_sum = m_K_sum + indexed(segment_order_parameter{m_n}, segmented_sum(x.sincos(), m_n));
+        ++m_count;
+    }
+
+    std::vector<value_type> get_K_mean(void) const
+    {
+        std::vector<value_type> K_mean(m_K_sum.getExtent()[0]);
+        m_K_sum.download_async(K_mean.data(), K_mean.size()).wait();
+        for(auto& K : K_mean)
+            K = (m_count != 0) ? K / value_type(m_count) : 0.0;
+        return K_mean;
+    }
+};
+
+
 // const size_t N = 16384 * 128;
 size_t const N = 16384;
 value_type const pi = 3.1415926535897932384626433832795029;
@@ -143,49 +206,35 @@ value_type const epsilon_max = 5.0;
 value_type const t_transients = 10.0;
 value_type const t_max = 100.0;
 
-template<typename TAcc>
-state_type create_frequencies(std::size_t N, value_type g, TAcc devAcc, QueueAcc queue, DevHost devHost)
+// The frequencies and the initial condition are drawn on the device from counter based random numbers,
+// so they don't depend on the accelerator and no host buffers are filled and copied.
+state_type create_frequencies(std::size_t N, value_type g, QueueAcc queue)
 {
-    boost::cauchy_distribution<value_type> cauchy(0.0, g);
-    drand48_generator d48;
-
-    alpaka::Vec<Dim, Idx> extent{N};
-    BufHost omegaHostBuf(alpaka::allocBuf<value_type, Idx>(devHost, extent));
-    BufAcc omegaAccBuf(alpaka::allocBuf<value_type, Idx>(devAcc, extent));
-
-    value_type* const omega(alpaka::getPtrNative(omegaHostBuf));
-    for(size_t i = 0; i < N; ++i)
-        omega[i] = cauchy(d48);
-
-    alpaka::memcpy(queue, omegaAccBuf, omegaHostBuf);
-    return {queue, omegaAccBuf};
+    state_type omega{queue, N};
+    omega = random<Acc>(queue, N, CauchyDistribution<value_type>{0.0, g}, 1);
+    return omega;
 }
 
-BufHost get_initial_condition(std::size_t N, QueueAcc queue, DevHost devHost)
+state_type get_initial_condition(std::size_t N, QueueAcc queue)
 {
-    alpaka::Vec<Dim, Idx> extent{N};
-    BufHost xHostBuf(alpaka::allocBuf<value_type, Idx>(devHost, extent));
-
-    value_type* const x_host(alpaka::getPtrNative(xHostBuf));
-    for(size_t i = 0; i < N; ++i)
-        x_host[i] = 2.0 * pi * drand48();
-
-    return xHostBuf;
+    state_type x{queue, N};
+    x = random<Acc>(queue, N, UniformDistribution<value_type>{0.0, 2.0 * pi}, 2);
+    return x;
 }
 
 int main(int arc, char* argv[])
 {
     auto const devAcc = alpaka::getDevByIdx<Acc>(0u);
     QueueAcc queue(devAcc);
-    auto const devHost = alpaka::getDevByIdx<DevHost>(0u);
 
-    auto omegas = create_frequencies(N, 1.0, devAcc, queue, devHost);
+    auto omegas = create_frequencies(N, 1.0, queue);
     phase_oscillator_ensemble ensemble(omegas, 1.0);
-    BufHost init = get_initial_condition(N, queue, devHost);
+    state_type init = get_initial_condition(N, queue);
 
     boost::timer timer;
     boost::timer timer_local;
     double dopri5_time = 0.0, rk4_time = 0.0;
+    std::vector<value_type> K_rk4;
     {
         typedef runge_kutta_dopri5<state_type, value_type, state_type, value_type> stepper_type;
 
@@ -198,7 +247,7 @@ int main(int arc, char* argv[])
 
             // copy to reuse the same initial condition
             state_type x{queue, N};
-            alpaka::memcpy(queue, x.getBuffer(), init);
+            alpaka::memcpy(queue, x.getBuffer(), init.getConstBuffer());
 
             timer_local.restart();
 
@@ -241,7 +290,7 @@ int main(int arc, char* argv[])
 
             // copy to reuse the same initial condition
             state_type x{queue, N};
-            alpaka::memcpy(queue, x.getBuffer(), init);
+            alpaka::memcpy(queue, x.getBuffer(), init.getConstBuffer());
 
             timer_local.restart();
 
@@ -251,14 +300,93 @@ int main(int arc, char* argv[])
             // integrate and compute the statistics
             size_t steps2 = integrate_const(stepper_type(), boost::ref(ensemble), x, 0.0, t_max, dt, boost::ref(obs));
             fout << epsilon << "\t" << obs.get_K_mean() << endl;
+            K_rk4.push_back(obs.get_K_mean());
             cout << "RK4     : " << epsilon << "\t" << obs.get_K_mean() << "\t" << timer_local.elapsed() << "\t"
                  << steps1 << "\t" << steps2 << endl;
         }
         rk4_time = timer.elapsed();
     }
 
+    // the same sweep with all values of epsilon in one state, P-fold fewer kernel launches
+    std::vector<value_type> epsilons;
+    for(value_type epsilon = epsilon_min; epsilon < epsilon_max; epsilon += d_epsilon)
+        epsilons.push_back(epsilon);
+    Idx const P = epsilons.size();
+
+    state_type epsilon_batch{queue, P};
+    epsilon_batch.upload_async(epsilons.data(), P).wait();
+    state_type omega_batch{queue, P * N};
+    omega_batch = repeat_segments(omegas, P);
+    batched_phase_oscillator_ensemble batch(omega_batch, epsilon_batch, N);
+
+    double batched_dopri5_time = 0.0, batched_rk4_time = 0.0;
+    {
+        typedef runge_kutta_dopri5<state_type, value_type, state_type, value_type> stepper_type;
+
+        ofstream fout("phase_ensemble_dopri5_batched.dat");
+        timer.restart();
+        batched_statistics_observer obs(queue, P, N);
+
+        // every ensemble starts from the same initial condition
+        state_type x{queue, P * N};
+        x = repeat_segments(init, P);
+
+        // the step size is controlled by the largest error of all ensembles
+        size_t steps1 = integrate_const(
+            make_controlled(1.0e-6, 1.0e-6, stepper_type()),
+            boost::ref(batch),
+            x,
+            0.0,
+            t_transients,
+            dt);
+
+        size_t steps2 = integrate_const(
+            make_dense_output(1.0e-6, 1.0e-6, stepper_type()),
+            boost::ref(batch),
+            x,
+            0.0,
+            t_max,
+            dt,
+            boost::ref(obs));
+
+        auto const K_mean = obs.get_K_mean();
+        for(Idx p = 0; p < P; ++p)
+            fout << epsilons[p] << "\t" << K_mean[p] << endl;
+        batched_dopri5_time = timer.elapsed();
+        cout << "Dopri5 batched : " << P << " ensembles\t" << batched_dopri5_time << "\t" << steps1 << "\t" << steps2
+             << endl;
+    }
+
+    {
+        typedef runge_kutta4<state_type, value_type, state_type, value_type> stepper_type;
+
+        ofstream fout("phase_ensemble_rk4_batched.dat");
+        timer.restart();
+        batched_statistics_observer obs(queue, P, N);
+
+        state_type x{queue, P * N};
+        x = repeat_segments(init, P);
+
+        size_t steps1 = integrate_const(stepper_type(), boost::ref(batch), x, 0.0, t_transients, dt);
+        size_t steps2 = integrate_const(stepper_type(), boost::ref(batch), x, 0.0, t_max, dt, boost::ref(obs));
+
+        // with fixed steps the ensembles follow the sequential runs up to the order of the summations
+        auto const K_mean = obs.get_K_mean();
+        value_type deviation = 0.0;
+        for(Idx p = 0; p < P; ++p)
+        {
+            fout << epsilons[p] << "\t" << K_mean[p] << endl;
+            deviation = std::max(deviation, std::abs(K_mean[p] - K_rk4[p]));
+        }
+        batched_rk4_time = timer.elapsed();
+        cout << "RK4 batched    : " << P << " ensembles\t" << batched_rk4_time << "\t" << steps1 << "\t" << steps2
+             << "\tmax deviation " << deviation << endl;
+    }
+
     cout << "Dopri 5 : " << dopri5_time << " s\n";
     cout << "RK4     : " << rk4_time << "\n";
+    cout << "Dopri 5 batched : " << batched_dopri5_time << " s\n";
+    cout << "RK4 batched     : " << batched_rk4_time << " s\n";
 
     return 0;
 }
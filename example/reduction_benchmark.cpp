@@ -0,0 +1,76 @@
+// Benchmark of the reduction x.sum() against the memory bandwidth: the sum reads every element once, so
+// its throughput is compared with a device to device copy of the same vector (STREAM copy, 2 * N * 8 bytes).
+
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+typedef double value_type;
+
+using Dim = alpaka::DimInt<1u>;
+using Idx = std::size_t;
+using Acc = alpaka::ExampleDefaultAcc<Dim, Idx>;
+using QueueAcc = alpaka::Queue<Acc, alpaka::Blocking>;
+using BufAcc = alpaka::Buf<Acc, value_type, Dim, Idx>;
+using state_type = Vector<BufAcc, QueueAcc, Acc>;
+
+template<typename TFunc>
+double measure(TFunc&& func, int repetitions)
+{
+    func(); // warm up
+    auto const start = std::chrono::steady_clock::now();
+    for(int r = 0; r < repetitions; ++r)
+        func();
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / repetitions;
+}
+
+int main(int argc, char** argv)
+{
+    // the largest size needs 2 * N * 8 bytes (2 GiB for N = 2^27)
+    Idx const maxN = argc > 1 ? static_cast<Idx>(std::atol(argv[1])) : (Idx{1} << 26);
+    int const repetitions = 20;
+
+    auto const devAcc = alpaka::getDevByIdx<Acc>(0u);
+    QueueAcc queue(devAcc);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+    std::cout << "N\tsum [ms]\tcopy [ms]\tsum [GB/s]\tcopy [GB/s]\tsum / copy\terror\n";
+
+    for(Idx N = Idx{1} << 20; N <= maxN; N *= 4)
+    {
+        state_type x(queue, N);
+        state_type y(queue, N);
+        x = fill<Acc>(queue, value_type(1), N);
+
+        // the vector is marked as modified before every sum, so the memoized result is not reused
+        value_type sum = 0;
+        auto const sumTime = measure(
+            [&]
+            {
+                x.markModified();
+                sum = x.sum().compute();
+            },
+            repetitions);
+
+        auto const copyTime = measure(
+            [&]
+            {
+                alpaka::memcpy(queue, y.getBuffer(), x.getConstBuffer(), alpaka::Vec<Dim, Idx>(N));
+                alpaka::wait(queue);
+            },
+            repetitions);
+
+        auto const bytes = static_cast<double>(N) * sizeof(value_type);
+        auto const sumBandwidth = bytes / sumTime * 1e-9;
+        auto const copyBandwidth = 2.0 * bytes / copyTime * 1e-9;
+        std::cout << N << '\t' << sumTime * 1e3 << '\t' << copyTime * 1e3 << '\t' << sumBandwidth << '\t'
+                  << copyBandwidth << '\t' << sumBandwidth / copyBandwidth << '\t'
+                  << std::abs(sum - static_cast<value_type>(N)) << '\n';
+    }
+}
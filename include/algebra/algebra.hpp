@@ -21,4 +21,16 @@ namespace boost::numeric::odeint
     {
         typedef vector_space_algebra algebra_type;
     };
+
+    template<typename TState>
+    struct vector_space_norm_inf<TState, impl_detail::enable_if_bundle_state<TState>>
+        : vector_space_norm_inf<impl_detail::bundle_vector_t<TState>>
+    {
+    };
+
+    template<typename TState>
+    struct algebra_dispatcher_sfinae<TState, impl_detail::enable_if_bundle_state<TState>>
+    {
+        typedef vector_space_algebra algebra_type;
+    };
 } // namespace boost::numeric::odeint
\ No newline at end of file
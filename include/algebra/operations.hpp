@@ -80,7 +80,7 @@ namespace boost::numeric::odeint
                 using Dim = alpaka::Dim<typename StateType1::buf_type>;
                 using Idx = alpaka::Idx<typename StateType1::buf_type>;
                 Idx const elementsPerThread(8u);
-                alpaka::Vec<Dim, Idx> const extent = alpaka::getExtentVec(x1.getBuffer());
+                alpaka::Vec<Dim, Idx> const extent = alpaka::getExtentVec(x1.getConstBuffer());
 
                 // Let alpaka calculate good block and grid sizes given our full problem extent
                 alpaka::WorkDivMembers<Dim, Idx> const workDiv(alpaka::getValidWorkDiv<Acc>(
@@ -96,7 +96,7 @@ namespace boost::numeric::odeint
                     kernel,
                     alpaka::getPtrNative(x1.getBuffer()),
                     alpaka::getPtrNative(x2.getBuffer()),
-                    alpaka::getPtrNative(x3.getBuffer()),
+                    alpaka::getPtrNative(x3.getConstBuffer()),
                     a1,
                     a2,
                     extent[0]);
@@ -136,4 +136,10 @@ namespace boost::numeric::odeint
         typedef alpaka_operations operations_type;
     };
 
+    template<typename TState>
+    struct operations_dispatcher_sfinae<TState, impl_detail::enable_if_bundle_state<TState>>
+    {
+        typedef alpaka_operations operations_type;
+    };
+
 } // namespace boost::numeric::odeint
\ No newline at end of file
@@ -8,9 +8,36 @@
 #include <boost/numeric/odeint/util/is_resizeable.hpp>
 #include <boost/numeric/odeint/util/state_wrapper.hpp>
 
+#include <type_traits>
+#include <utility>
+
 template<typename TBuf, typename TQueue, typename TAcc>
 using alpaka_buffer_wrapper = Vector<TBuf, TQueue, TAcc>;
 
+template<typename TBuf, typename TQueue, typename TAcc, std::size_t TComponents>
+using alpaka_bundle_wrapper = StateBundle<TBuf, TQueue, TAcc, TComponents>;
+
+template<typename TBuf, typename TQueue, typename TAcc, std::size_t N>
+using alpaka_fixed_wrapper = FixedVector<TBuf, TQueue, TAcc, N>;
+
+namespace impl_detail
+{
+    template<typename TBuf, typename TQueue, typename TAcc, std::size_t TComponents>
+    auto bundle_base(alpaka_bundle_wrapper<TBuf, TQueue, TAcc, TComponents> const*)
+        -> alpaka_bundle_wrapper<TBuf, TQueue, TAcc, TComponents>;
+    auto bundle_base(...) -> void;
+
+    //! A StateBundle or a state deriving from one, like FixedVector. odeint treats all of them like their
+    //! underlying Vector, so they share one set of specializations.
+    template<typename TState>
+    inline constexpr bool is_bundle_state = !std::is_void_v<decltype(bundle_base(std::declval<TState const*>()))>;
+
+    template<typename TState>
+    using enable_if_bundle_state = std::enable_if_t<is_bundle_state<TState>>;
+
+    template<typename TState>
+    using bundle_vector_t = typename TState::vector_type;
+} // namespace impl_detail
 
 namespace boost::numeric::odeint
 {
@@ -26,7 +53,7 @@ namespace boost::numeric::odeint
         {
             if(other.m_v.isInitialized())
             {
-                auto buff = other.m_v.getBuffer();
+                auto buff = other.m_v.getConstBuffer();
                 auto queue = other.m_v.getQueue();
                 auto size = alpaka::getExtentVec(buff)[0];
 
@@ -46,7 +73,7 @@ namespace boost::numeric::odeint
         {
             if(left.isInitialized() && right.isInitialized())
             {
-                return alpaka::getExtent<0>(left.getBuffer()) == alpaka::getExtent<0>(right.getBuffer());
+                return left.getExtent()[0] == right.getExtent()[0];
             }
             else
             {
@@ -69,7 +96,7 @@ namespace boost::numeric::odeint
             alpaka_buffer_wrapper<TBuf1, TQueue, TAcc>& left,
             alpaka_buffer_wrapper<TBuf2, TQueue, TAcc> const& right)
         {
-            auto size = alpaka::getExtent<0>(right.getBuffer());
+            auto size = right.getExtent()[0];
             if(left.isInitialized())
             {
                 left.adjust_size(size);
@@ -81,4 +108,52 @@ namespace boost::numeric::odeint
             }
         }
     };
-} // namespace boost::numeric::odeint
+
+    template<typename TState>
+    struct state_wrapper<TState, impl_detail::enable_if_bundle_state<TState>>
+    {
+        using state_type = TState;
+
+        state_type m_v;
+
+        state_wrapper(){};
+        state_wrapper(state_wrapper<state_type> const& other)
+        {
+            if(other.m_v.isInitialized())
+            {
+                auto buff = other.m_v.getConstBuffer();
+                auto queue = other.m_v.getQueue();
+                auto size = alpaka::getExtentVec(buff)[0];
+
+                m_v.adjust_size(size, queue);
+
+                alpaka::memcpy(queue, m_v.getBuffer(), buff);
+            }
+        }
+    };
+
+    template<typename TState1, typename TState2>
+    struct same_size_impl_sfinae<
+        TState1,
+        TState2,
+        std::enable_if_t<impl_detail::is_bundle_state<TState1> && impl_detail::is_bundle_state<TState2>>>
+        : same_size_impl<impl_detail::bundle_vector_t<TState1>, impl_detail::bundle_vector_t<TState2>>
+    {
+    };
+
+    template<typename TState>
+    struct is_resizeable_sfinae<TState, impl_detail::enable_if_bundle_state<TState>>
+    {
+        using type = boost::true_type;
+        static bool const value = true;
+    };
+
+    template<typename TState1, typename TState2>
+    struct resize_impl_sfinae<
+        TState1,
+        TState2,
+        std::enable_if_t<impl_detail::is_bundle_state<TState1> && impl_detail::is_bundle_state<TState2>>>
+        : resize_impl<impl_detail::bundle_vector_t<TState1>, impl_detail::bundle_vector_t<TState2>>
+    {
+    };
+} // namespace boost::numeric::odeint
\ No newline at end of file
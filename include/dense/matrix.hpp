@@ -0,0 +1,414 @@
+#pragma once
+
+#include "../expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+//! Dense row major matrix. The elements are stored in a Vector of rows * cols elements, so the
+//! matrix takes part in memoization like every other leaf.
+template<typename TBuf, typename TQueue, typename TAcc>
+class Matrix
+{
+public:
+    using acc_type = TAcc;
+    using buf_type = TBuf;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TBuf>;
+    using idx_type = alpaka::Idx<TBuf>;
+    using value_type = alpaka::Elem<TBuf>;
+    using data_type = Vector<TBuf, TQueue, TAcc>;
+
+private:
+    data_type data_;
+    idx_type rows_ = 0;
+    idx_type cols_ = 0;
+
+public:
+    Matrix(TQueue& queue, idx_type rows, idx_type cols) : data_(queue, rows * cols), rows_(rows), cols_(cols)
+    {
+    }
+
+    //! Uploads the row major host data.
+    Matrix(TQueue& queue, idx_type rows, idx_type cols, std::vector<value_type> const& host)
+        : Matrix(queue, rows, cols)
+    {
+        if(host.size() != static_cast<std::size_t>(rows * cols))
+            throw std::invalid_argument("Size of the host data doesn't match the extent of the matrix");
+
+        alpaka::Vec<dim_type, idx_type> const extent(rows * cols);
+        auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+        auto view = alpaka::createView(devHost, const_cast<value_type*>(host.data()), extent);
+        alpaka::memcpy(queue, data_.getBuffer(), view);
+        alpaka::wait(queue);
+    }
+
+    idx_type getRows() const
+    {
+        return rows_;
+    }
+
+    idx_type getCols() const
+    {
+        return cols_;
+    }
+
+    TQueue getQueue() const
+    {
+        return data_.getQueue();
+    }
+
+    //! The elements as a Vector, e.g. to assign expressions to all of them.
+    data_type& getData()
+    {
+        return data_;
+    }
+
+    data_type const& getData() const
+    {
+        return data_;
+    }
+
+    value_type* getPtr() const
+    {
+        return data_.getPtr();
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<Matrix>();
+        key.append(rows_);
+        data_.appendCacheKey(key);
+    }
+};
+
+namespace impl_detail
+{
+    //! Number of matrix columns of a tile on CPU accelerators, the tile of the operand stays in the L1 cache
+    //! while it is streamed against a group of rows.
+    template<typename T>
+    constexpr uint32_t matvec_cpu_tile_cols = 8192 / sizeof(T);
+
+    //! Rows which a CPU worker computes together against one tile of the operand.
+    constexpr uint32_t matvec_cpu_rows_per_group = 32;
+
+    //! Every worker computes groups of TRowsPerGroup contiguous rows, the groups are distributed round robin.
+    template<uint32_t TRowsPerGroup, uint32_t TTileCols, typename T>
+    struct CpuMatVecKernel
+    {
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            T* const result,
+            T const* const matrix,
+            T const* const vector,
+            TIdx const& rows,
+            TIdx const& cols) const -> void
+        {
+            constexpr uint32_t partials = 4;
+
+            auto const worker(static_cast<TIdx>(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0]));
+            auto const workers(static_cast<TIdx>(alpaka::getWorkDiv<alpaka::Grid, alpaka::Threads>(acc)[0]));
+
+            for(TIdx firstRow = worker * TRowsPerGroup; firstRow < rows; firstRow += workers * TRowsPerGroup)
+            {
+                cheapArray<T, TRowsPerGroup> sums;
+                ALPAKA_UNROLL()
+                for(uint32_t r = 0; r < TRowsPerGroup; ++r)
+                    sums[r] = 0;
+
+                for(TIdx tileFirst = 0; tileFirst < cols; tileFirst += TTileCols)
+                {
+                    TIdx const tileCols = cols - tileFirst < TTileCols ? cols - tileFirst : TIdx{TTileCols};
+                    T const* const tile = vector + tileFirst;
+
+                    for(uint32_t r = 0; r < TRowsPerGroup; ++r)
+                    {
+                        TIdx const row = firstRow + r;
+                        if(row >= rows)
+                            break;
+
+                        // independent partial sums, so the loop can be vectorized without reassociation
+                        T const* const rowPtr = matrix + row * cols + tileFirst;
+                        cheapArray<T, partials> partial;
+                        ALPAKA_UNROLL()
+                        for(uint32_t p = 0; p < partials; ++p)
+                            partial[p] = 0;
+
+                        TIdx j = 0;
+                        for(; j + partials <= tileCols; j += partials)
+                        {
+                            ALPAKA_UNROLL()
+                            for(uint32_t p = 0; p < partials; ++p)
+                                partial[p] += rowPtr[j + p] * tile[j + p];
+                        }
+                        for(; j < tileCols; ++j)
+                            partial[0] += rowPtr[j] * tile[j];
+
+                        sums[r] += (partial[0] + partial[1]) + (partial[2] + partial[3]);
+                    }
+                }
+
+                for(uint32_t r = 0; r < TRowsPerGroup; ++r)
+                    if(firstRow + r < rows)
+                        result[firstRow + r] = sums[r];
+            }
+        }
+    };
+
+    //! A block computes one row at a time: consecutive threads read consecutive elements of the row and
+    //! of the operand, so the loads are coalesced, and the partial sums are reduced in shared memory.
+    template<uint32_t TBlockSize, typename T>
+    struct RowMatVecKernel
+    {
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            T* const result,
+            T const* const matrix,
+            T const* const vector,
+            TIdx const& rows,
+            TIdx const& cols) const -> void
+        {
+            static_assert((TBlockSize & (TBlockSize - 1)) == 0, "The block size has to be a power of two");
+
+            auto& partials(alpaka::declareSharedVar<cheapArray<T, TBlockSize>, __COUNTER__>(acc));
+
+            auto const threadIndex(static_cast<uint32_t>(alpaka::getIdx<alpaka::Block, alpaka::Threads>(acc)[0]));
+            auto const blockIndex(static_cast<TIdx>(alpaka::getIdx<alpaka::Grid, alpaka::Blocks>(acc)[0]));
+            auto const blocks(static_cast<TIdx>(alpaka::getWorkDiv<alpaka::Grid, alpaka::Blocks>(acc)[0]));
+
+            for(TIdx row = blockIndex; row < rows; row += blocks)
+            {
+                T const* const rowPtr = matrix + row * cols;
+                T sum = 0;
+                for(TIdx j = threadIndex; j < cols; j += TBlockSize)
+                    sum += rowPtr[j] * vector[j];
+                partials[threadIndex] = sum;
+                alpaka::syncBlockThreads(acc);
+
+                for(uint32_t width = TBlockSize / 2; width > 0; width /= 2)
+                {
+                    if(threadIndex < width)
+                        partials[threadIndex] += partials[threadIndex + width];
+                    alpaka::syncBlockThreads(acc);
+                }
+
+                if(threadIndex == 0)
+                    result[row] = partials[0];
+                // the partials are overwritten by the next row
+                alpaka::syncBlockThreads(acc);
+            }
+        }
+    };
+} // namespace impl_detail
+
+//! y = K * x for a dense matrix K and an arbitrary expression x with K.getCols() elements.
+//!
+//! The product is computed when the tree is prepared. The operand (e.g. sin(x)) is evaluated once into a
+//! temporary of K.getCols() elements, so the inner functor is not evaluated once per matrix element.
+template<typename TMatrix, typename InnerExpr>
+class MatVecExpression : public ExpressionBase<MatVecExpression<TMatrix, InnerExpr>>
+{
+public:
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename TMatrix::value_type;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+    using eval_ret_type = typename TMatrix::data_type;
+
+public:
+    struct AccExpressionHandler
+    {
+        MatVecExpression const& results_;
+        value_type* ptr_ = nullptr;
+
+        AccExpressionHandler(MatVecExpression const& results) : results_(results)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return ptr_[i];
+        }
+
+        void prepare()
+        {
+            impl_detail::TilingScope suspend_tiling;
+            results_.compute();
+            ptr_ = results_.getPtr();
+        }
+    };
+
+private:
+    // shared by all copies of the expression
+    struct State
+    {
+        eval_ret_type result;
+        eval_ret_type operand;
+        std::optional<impl_detail::ExpressionKey> computed_key;
+        std::uint64_t evaluation = 0;
+    };
+
+    TMatrix matrix_;
+    InnerExpr expr_;
+    std::shared_ptr<State> state_;
+
+private:
+    void compute() const
+    {
+        impl_detail::EvaluationScope evaluation;
+        if(state_->evaluation == evaluation.id())
+            return;
+
+        auto key = impl_detail::make_cache_key(*this);
+        if(!state_->computed_key || *state_->computed_key != key)
+        {
+            auto queue = expr_.getQueue();
+            idx_type const rows = matrix_.getRows();
+            idx_type const cols = matrix_.getCols();
+            state_->result.adjust_size(rows, queue);
+            state_->operand.adjust_size(cols, queue);
+
+            auto handler = impl_detail::make_kernel_handler(expr_);
+            handler.prepare();
+            impl_detail::launch_assign_kernel<acc_type>(queue, state_->operand.getPtr(), handler, idx_type{0}, cols);
+
+            if(rows > 0)
+            {
+                auto* const result = state_->result.getPtr();
+                auto const* const matrix = static_cast<value_type const*>(matrix_.getPtr());
+                auto const* const operand = static_cast<value_type const*>(state_->operand.getPtr());
+                auto const devAcc = alpaka::getDev(queue);
+
+                if constexpr(std::is_same_v<alpaka::Dev<acc_type>, alpaka::DevCpu>)
+                {
+                    constexpr idx_type rowsPerGroup = impl_detail::matvec_cpu_rows_per_group;
+                    idx_type const groups = (rows + rowsPerGroup - 1) / rowsPerGroup;
+                    auto const cores = impl_detail::cpu_reduction_workers<acc_type, idx_type>(devAcc);
+
+                    impl_detail::CpuMatVecKernel<
+                        impl_detail::matvec_cpu_rows_per_group,
+                        impl_detail::matvec_cpu_tile_cols<value_type>,
+                        value_type>
+                        kernel;
+                    alpaka::enqueue(
+                        queue,
+                        alpaka::createTaskKernel<acc_type>(
+                            impl_detail::cpu_work_div<acc_type>(groups < cores ? groups : cores),
+                            kernel,
+                            result,
+                            matrix,
+                            operand,
+                            rows,
+                            cols));
+                }
+                else
+                {
+                    static constexpr uint64_t blockSize = impl_detail::getMaxBlockSize<acc_type, 256>();
+                    auto const maxBlocks
+                        = static_cast<idx_type>(alpaka::getAccDevProps<acc_type>(devAcc).m_multiProcessorCount * 8);
+                    alpaka::WorkDivMembers<dim_type, idx_type> const workDiv{
+                        rows < maxBlocks ? rows : maxBlocks,
+                        static_cast<idx_type>(blockSize),
+                        idx_type{1}};
+
+                    impl_detail::RowMatVecKernel<static_cast<uint32_t>(blockSize), value_type> kernel;
+                    alpaka::enqueue(
+                        queue,
+                        alpaka::createTaskKernel<acc_type>(workDiv, kernel, result, matrix, operand, rows, cols));
+                }
+                alpaka::wait(queue);
+            }
+
+            state_->result.markModified();
+            state_->computed_key = std::move(key);
+        }
+        state_->evaluation = evaluation.id();
+        impl_detail::keep_until_wait(state_);
+    }
+
+    value_type* getPtr() const
+    {
+        return state_->result.getPtr();
+    }
+
+public:
+    MatVecExpression(TMatrix const& matrix, InnerExpr const& expr)
+        : matrix_(matrix)
+        , expr_(expr)
+        , state_(std::make_shared<State>())
+    {
+        if(expr.getExtent()[0] != matrix.getCols())
+            throw std::invalid_argument("Extents of matrix and vector are mismatched");
+
+        this->queue_ = expr.getQueue();
+        this->extent_ = extent_type(matrix.getRows());
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {*this};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        expr_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<MatVecExpression>();
+        matrix_.appendCacheKey(key);
+        impl_detail::append_cache_key(expr_, key);
+    }
+};
+
+template<typename TMatrix, typename InnerExpr>
+struct expr_traits<MatVecExpression<TMatrix, InnerExpr>>
+{
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename TMatrix::value_type;
+    using eval_ret_type = typename TMatrix::data_type;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = false;
+};
+
+namespace impl_detail
+{
+    template<typename TMatrix, typename InnerExpr>
+    struct supports_tiling<MatVecExpression<TMatrix, InnerExpr>> : std::true_type
+    {
+    };
+} // namespace impl_detail
+
+template<typename TBuf, typename TQueue, typename TAcc, typename TDerived>
+inline MatVecExpression<Matrix<TBuf, TQueue, TAcc>, TDerived> matvec(
+    Matrix<TBuf, TQueue, TAcc> const& matrix,
+    ExpressionBase<TDerived> const& expr)
+{
+    return {matrix, expr.derived()};
+}
+
+template<typename TBuf, typename TQueue, typename TAcc, typename TDerived>
+inline MatVecExpression<Matrix<TBuf, TQueue, TAcc>, TDerived> operator*(
+    Matrix<TBuf, TQueue, TAcc> const& matrix,
+    ExpressionBase<TDerived> const& expr)
+{
+    return matvec(matrix, expr);
+}
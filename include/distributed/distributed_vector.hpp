@@ -0,0 +1,764 @@
+#pragma once
+
+#include "../expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+template<typename TBuf, typename TQueue, typename TAcc>
+class DistributedVector;
+
+namespace impl_detail
+{
+    template<typename T>
+    struct mpi_datatype;
+
+    template<>
+    struct mpi_datatype<float>
+    {
+        static MPI_Datatype get()
+        {
+            return MPI_FLOAT;
+        }
+    };
+
+    template<>
+    struct mpi_datatype<double>
+    {
+        static MPI_Datatype get()
+        {
+            return MPI_DOUBLE;
+        }
+    };
+
+    template<>
+    struct mpi_datatype<int>
+    {
+        static MPI_Datatype get()
+        {
+            return MPI_INT;
+        }
+    };
+
+    template<>
+    struct mpi_datatype<std::int64_t>
+    {
+        static MPI_Datatype get()
+        {
+            return MPI_INT64_T;
+        }
+    };
+
+    template<>
+    struct mpi_datatype<std::uint64_t>
+    {
+        static MPI_Datatype get()
+        {
+            return MPI_UINT64_T;
+        }
+    };
+
+    //! Number of elements of mpi_datatype<T> which make up one T.
+    template<typename T>
+    struct mpi_datatype_count : std::integral_constant<int, 1>
+    {
+    };
+
+    //! Sine and cosine are sent as two elements of their component type, so predefined operations
+    //! like MPI_SUM apply to them component wise.
+    template<typename T>
+    struct mpi_datatype<SinCos<T>> : mpi_datatype<T>
+    {
+    };
+
+    template<typename T>
+    struct mpi_datatype_count<SinCos<T>> : std::integral_constant<int, 2 * mpi_datatype_count<T>::value>
+    {
+    };
+
+    //! Maps a reduction functor to the predefined MPI operation, if there is one.
+    template<typename TFunc>
+    struct mpi_reduction_op
+    {
+        static constexpr bool is_predefined = false;
+    };
+
+    template<typename T1, typename T2>
+    struct mpi_reduction_op<AddFunctor<T1, T2>>
+    {
+        static constexpr bool is_predefined = true;
+
+        static MPI_Op get()
+        {
+            return MPI_SUM;
+        }
+    };
+
+    template<typename T1, typename T2>
+    struct mpi_reduction_op<MaxFunctor<T1, T2>>
+    {
+        static constexpr bool is_predefined = true;
+
+        static MPI_Op get()
+        {
+            return MPI_MAX;
+        }
+    };
+
+    template<typename T1, typename T2>
+    struct mpi_reduction_op<MinFunctor<T1, T2>>
+    {
+        static constexpr bool is_predefined = true;
+
+        static MPI_Op get()
+        {
+            return MPI_MIN;
+        }
+    };
+
+    template<typename T>
+    struct is_distributed_vector : std::false_type
+    {
+    };
+
+    template<typename TBuf, typename TQueue, typename TAcc>
+    struct is_distributed_vector<DistributedVector<TBuf, TQueue, TAcc>> : std::true_type
+    {
+    };
+
+    //! Whether the elements of an expression are partitioned across processes, i.e. whether a DistributedVector
+    //! is one of the nodes below it. Every node is a template over its operands, so the template arguments are
+    //! searched instead of specializing the trait for every kind of node (where, indexed, gather, ...).
+    template<typename TExpr>
+    struct is_distributed_expr : is_distributed_vector<TExpr>
+    {
+    };
+
+    template<template<typename...> class TNode, typename... TArgs>
+    struct is_distributed_expr<TNode<TArgs...>>
+        : std::bool_constant<
+              is_distributed_vector<TNode<TArgs...>>::value || (is_distributed_expr<TArgs>::value || ...)>
+    {
+    };
+
+    template<typename InnerExpr, int shift>
+    struct is_distributed_expr<ShiftExpression<InnerExpr, shift>> : is_distributed_expr<InnerExpr>
+    {
+    };
+
+    //! A reduction is finished across the processes, its result is the same on every process.
+    template<typename InnerExpr, typename Op>
+    struct is_distributed_expr<Reduction1DExpression<InnerExpr, Op>> : std::false_type
+    {
+    };
+
+    //! Whether a ShiftExpression in the tree shifts a distributed operand other than a bare DistributedVector.
+    //! Only the leaf has halo cells, a shifted sub-tree would be clamped at the local block and give wrong
+    //! values at the process boundaries, e.g. ShiftExpression<decltype(x.sin()), 1>(x.sin()).
+    template<typename TExpr>
+    struct has_unsupported_distributed_shift : std::false_type
+    {
+    };
+
+    template<template<typename...> class TNode, typename... TArgs>
+    struct has_unsupported_distributed_shift<TNode<TArgs...>>
+        : std::bool_constant<(has_unsupported_distributed_shift<TArgs>::value || ...)>
+    {
+    };
+
+    template<typename InnerExpr, int shift>
+    struct has_unsupported_distributed_shift<ShiftExpression<InnerExpr, shift>>
+        : std::bool_constant<
+              is_distributed_expr<InnerExpr>::value || has_unsupported_distributed_shift<InnerExpr>::value>
+    {
+    };
+
+    template<typename TBuf, typename TQueue, typename TAcc, int shift>
+    struct has_unsupported_distributed_shift<ShiftExpression<DistributedVector<TBuf, TQueue, TAcc>, shift>>
+        : std::false_type
+    {
+    };
+
+    template<typename InnerExpr, typename Op>
+    struct has_unsupported_distributed_shift<Reduction1DExpression<InnerExpr, Op>> : std::false_type
+    {
+    };
+
+    struct CommunicatorFinder
+    {
+        MPI_Comm comm = MPI_COMM_NULL;
+
+        template<typename TNode>
+        void operator()(TNode const& node)
+        {
+            if constexpr(is_distributed_vector<TNode>::value)
+                comm = node.getCommunicator();
+        }
+    };
+
+    //! Combines the partial results of all processes which hold a part of the reduced expression.
+    template<typename TExpr>
+    struct reduction_finalizer<TExpr, std::enable_if_t<is_distributed_expr<TExpr>::value>>
+    {
+        template<typename T, typename TFunc>
+        static T finalize(TExpr const& expr, T value, TFunc const& func)
+        {
+            static_assert(
+                !has_unsupported_distributed_shift<TExpr>::value,
+                "Only a DistributedVector itself can be shifted, materialize shifted distributed sub-trees first");
+
+            CommunicatorFinder finder;
+            expr.visit(finder);
+
+            if constexpr(mpi_reduction_op<TFunc>::is_predefined)
+            {
+                MPI_Allreduce(
+                    MPI_IN_PLACE,
+                    &value,
+                    mpi_datatype_count<T>::value,
+                    mpi_datatype<T>::get(),
+                    mpi_reduction_op<TFunc>::get(),
+                    finder.comm);
+                return value;
+            }
+            else
+            {
+                // arbitrary functors: gather all partial results and fold them in the rank order
+                int size;
+                MPI_Comm_size(finder.comm, &size);
+                std::vector<T> partials(size);
+                MPI_Allgather(&value, sizeof(T), MPI_BYTE, partials.data(), sizeof(T), MPI_BYTE, finder.comm);
+
+                T result = partials[0];
+                for(int i = 1; i < size; ++i)
+                    result = func(result, partials[i]);
+                return result;
+            }
+        }
+    };
+} // namespace impl_detail
+
+//! A vector whose index range is partitioned in contiguous blocks across the processes of a communicator.
+//!
+//! Every process stores its local block surrounded by halo cells of the neighbouring processes.
+//! Cwise expressions are evaluated on the local block only, reductions are finished with an allreduce
+//! and ShiftExpressions over a DistributedVector read the halo cells which are exchanged non-blocking.
+template<typename TBuf, typename TQueue, typename TAcc>
+class DistributedVector : public ExpressionBase<DistributedVector<TBuf, TQueue, TAcc>>
+{
+public:
+    using acc_type = TAcc;
+    using buf_type = TBuf;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TBuf>;
+    using idx_type = alpaka::Idx<TBuf>;
+    using value_type = alpaka::Elem<TBuf>;
+
+public:
+    struct AccExpressionHandler
+    {
+        DistributedVector const& vector_;
+        value_type* ptr_;
+
+        AccExpressionHandler(DistributedVector const& vector) : vector_(vector)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return ptr_[i];
+        }
+
+        void prepare()
+        {
+            ptr_ = vector_.getPtr();
+        }
+    };
+
+private:
+    enum class HaloState
+    {
+        Invalid,
+        InFlight,
+        Valid
+    };
+
+    //! Halo exchange state shared by all copies of the vector.
+    struct HaloExchange
+    {
+        HaloState state = HaloState::Invalid;
+        std::vector<value_type> send_lower, send_upper, recv_lower, recv_upper;
+        std::array<MPI_Request, 4> requests;
+        int num_requests = 0;
+    };
+
+    // tags of messages sent to the lower and to the upper neighbour
+    static constexpr int lower_tag = 0;
+    static constexpr int upper_tag = 1;
+
+    MPI_Comm comm_ = MPI_COMM_NULL;
+    int rank_ = 0;
+    int size_ = 1;
+    idx_type global_size_ = 0;
+    idx_type offset_ = 0;
+    idx_type halo_width_ = 0;
+
+    // Internally this is a shared pointer.
+    mutable std::optional<TBuf> buff_;
+    std::shared_ptr<HaloExchange> halo_;
+
+private:
+    void allocate()
+    {
+        auto const local_size = this->extent_[0];
+        if(local_size == 0 || local_size < halo_width_)
+            throw std::invalid_argument("Local partition is smaller than the halo width");
+
+        auto dev = alpaka::getDev(*this->queue_);
+        alpaka::Vec<dim_type, idx_type> const extent(local_size + 2 * halo_width_);
+        buff_ = alpaka::allocBuf<value_type, idx_type>(dev, extent);
+        halo_ = std::make_shared<HaloExchange>();
+    }
+
+public:
+    DistributedVector() = default;
+
+    DistributedVector(TQueue& queue, idx_type global_size, idx_type halo_width = 1, MPI_Comm comm = MPI_COMM_WORLD)
+        : comm_(comm)
+        , global_size_(global_size)
+        , halo_width_(halo_width)
+    {
+        MPI_Comm_rank(comm_, &rank_);
+        MPI_Comm_size(comm_, &size_);
+
+        auto const rank = static_cast<idx_type>(rank_);
+        auto const base = global_size / static_cast<idx_type>(size_);
+        auto const remainder = global_size % static_cast<idx_type>(size_);
+
+        this->queue_ = queue;
+        this->extent_[0] = base + (rank < remainder ? 1 : 0);
+        offset_ = rank * base + std::min(rank, remainder);
+        allocate();
+    }
+
+    template<typename TOtherDerived>
+    inline DistributedVector& operator=(ExpressionBase<TOtherDerived> const& other)
+    {
+        return ExpressionBase<DistributedVector>::operator=(other.derived());
+    }
+
+    //! Takes over the partitioning of other and allocates own storage for it.
+    void adoptLayout(DistributedVector const& other)
+    {
+        comm_ = other.comm_;
+        rank_ = other.rank_;
+        size_ = other.size_;
+        global_size_ = other.global_size_;
+        offset_ = other.offset_;
+        halo_width_ = other.halo_width_;
+        this->queue_ = other.queue_;
+        this->extent_ = other.extent_;
+        allocate();
+    }
+
+    bool isInitialized() const
+    {
+        return bool(buff_) && bool(this->queue_);
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {*this};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+    }
+
+    //! The whole local storage including the halo cells. The halo is considered stale afterwards.
+    //! Collective: all processes of the communicator have to call it, a process whose halo is still valid
+    //! would skip the next exchange which its neighbours wait for.
+    TBuf& getBuffer() const
+    {
+        invalidateHalo();
+        return *buff_;
+    }
+
+    //! Read only access to the local storage. Not collective, the halo cells may still be in flight.
+    TBuf const& getConstBuffer() const
+    {
+        return *buff_;
+    }
+
+    //! Pointer to the first element of the local block.
+    value_type* getPtr() const
+    {
+        return alpaka::getPtrNative(*buff_) + halo_width_;
+    }
+
+    alpaka::Dev<TBuf> getDevice() const
+    {
+        return alpaka::getDev(*buff_);
+    }
+
+    MPI_Comm getCommunicator() const
+    {
+        return comm_;
+    }
+
+    idx_type getGlobalSize() const
+    {
+        return global_size_;
+    }
+
+    //! Global index of the first element of the local block.
+    idx_type getGlobalOffset() const
+    {
+        return offset_;
+    }
+
+    idx_type getHaloWidth() const
+    {
+        return halo_width_;
+    }
+
+    //! Collective like getBuffer().
+    void invalidateHalo() const
+    {
+        if(!halo_)
+            return;
+        if(halo_->state == HaloState::InFlight)
+            finishHaloExchange();
+        halo_->state = HaloState::Invalid;
+    }
+
+    //! Posts the non-blocking exchange of the halo cells unless they are already valid or in flight.
+    //! The cells beyond the global boundaries are filled with the boundary elements.
+    void beginHaloExchange() const
+    {
+        auto& halo = *halo_;
+        if(halo.state != HaloState::Invalid || halo_width_ == 0)
+            return;
+
+        auto queue = this->getQueue();
+        auto const devAcc = alpaka::getDev(queue);
+        auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+        auto const n = this->extent_[0];
+        auto const w = halo_width_;
+        auto* const local = getPtr();
+
+        halo.send_lower.resize(w);
+        halo.send_upper.resize(w);
+        halo.recv_lower.resize(w);
+        halo.recv_upper.resize(w);
+
+        // download the boundary cells which are the halo of the neighbours
+        alpaka::Vec<dim_type, idx_type> const extent(w);
+        auto sendLowerDev = alpaka::createView(devAcc, local, extent);
+        auto sendUpperDev = alpaka::createView(devAcc, local + n - w, extent);
+        auto sendLowerHost = alpaka::createView(devHost, halo.send_lower.data(), extent);
+        auto sendUpperHost = alpaka::createView(devHost, halo.send_upper.data(), extent);
+        alpaka::memcpy(queue, sendLowerHost, sendLowerDev, extent);
+        alpaka::memcpy(queue, sendUpperHost, sendUpperDev, extent);
+        alpaka::wait(queue);
+
+        auto const type = impl_detail::mpi_datatype<value_type>::get();
+        auto const count = static_cast<int>(w) * impl_detail::mpi_datatype_count<value_type>::value;
+        halo.num_requests = 0;
+
+        if(rank_ > 0)
+        {
+            MPI_Irecv(
+                halo.recv_lower.data(),
+                count,
+                type,
+                rank_ - 1,
+                upper_tag,
+                comm_,
+                &halo.requests[halo.num_requests++]);
+            MPI_Isend(
+                halo.send_lower.data(),
+                count,
+                type,
+                rank_ - 1,
+                lower_tag,
+                comm_,
+                &halo.requests[halo.num_requests++]);
+        }
+        else
+        {
+            std::fill(halo.recv_lower.begin(), halo.recv_lower.end(), halo.send_lower.front());
+        }
+
+        if(rank_ < size_ - 1)
+        {
+            MPI_Irecv(
+                halo.recv_upper.data(),
+                count,
+                type,
+                rank_ + 1,
+                lower_tag,
+                comm_,
+                &halo.requests[halo.num_requests++]);
+            MPI_Isend(
+                halo.send_upper.data(),
+                count,
+                type,
+                rank_ + 1,
+                upper_tag,
+                comm_,
+                &halo.requests[halo.num_requests++]);
+        }
+        else
+        {
+            std::fill(halo.recv_upper.begin(), halo.recv_upper.end(), halo.send_upper.back());
+        }
+
+        halo.state = HaloState::InFlight;
+    }
+
+    //! Waits for a posted halo exchange and uploads the received cells.
+    void finishHaloExchange() const
+    {
+        auto& halo = *halo_;
+        if(halo.state != HaloState::InFlight)
+            return;
+
+        MPI_Waitall(halo.num_requests, halo.requests.data(), MPI_STATUSES_IGNORE);
+
+        auto queue = this->getQueue();
+        auto const devAcc = alpaka::getDev(queue);
+        auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+        auto const w = halo_width_;
+        auto* const local = getPtr();
+
+        alpaka::Vec<dim_type, idx_type> const extent(w);
+        auto recvLowerDev = alpaka::createView(devAcc, local - w, extent);
+        auto recvUpperDev = alpaka::createView(devAcc, local + this->extent_[0], extent);
+        auto recvLowerHost = alpaka::createView(devHost, halo.recv_lower.data(), extent);
+        auto recvUpperHost = alpaka::createView(devHost, halo.recv_upper.data(), extent);
+        alpaka::memcpy(queue, recvLowerDev, recvLowerHost, extent);
+        alpaka::memcpy(queue, recvUpperDev, recvUpperHost, extent);
+        alpaka::wait(queue);
+
+        halo.state = HaloState::Valid;
+    }
+
+    bool isHaloInFlight() const
+    {
+        return halo_ && halo_->state == HaloState::InFlight;
+    }
+};
+
+template<typename TBuf, typename TQueue, typename TAcc>
+struct expr_traits<DistributedVector<TBuf, TQueue, TAcc>>
+{
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TBuf>;
+    using idx_type = alpaka::Idx<TBuf>;
+    using value_type = alpaka::Elem<TBuf>;
+    using eval_ret_type = DistributedVector<TBuf, TQueue, TAcc>;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
+
+//! Shifted read of a DistributedVector: indices beyond the local block are served from the halo cells.
+template<typename TBuf, typename TQueue, typename TAcc, int shift>
+class ShiftExpression<DistributedVector<TBuf, TQueue, TAcc>, shift>
+    : public ExpressionBase<ShiftExpression<DistributedVector<TBuf, TQueue, TAcc>, shift>>
+{
+public:
+    using vector_type = DistributedVector<TBuf, TQueue, TAcc>;
+    using acc_type = TAcc;
+    using idx_type = alpaka::Idx<TBuf>;
+    using dim_type = alpaka::Dim<TBuf>;
+    using queue_type = TQueue;
+    using value_type = alpaka::Elem<TBuf>;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+
+    static constexpr int offset = shift;
+    static constexpr idx_type width = static_cast<idx_type>(shift < 0 ? -shift : shift);
+
+public:
+    struct AccExpressionHandler
+    {
+        vector_type const& vector_;
+        value_type* ptr_;
+
+        AccExpressionHandler(vector_type const& vector) : vector_(vector)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return ptr_[static_cast<std::ptrdiff_t>(i) + shift];
+        }
+
+        void prepare()
+        {
+            // an exchange which has been posted by the evaluator is completed by it after the interior
+            // is computed, otherwise the halo has to be valid before any kernel reads it
+            if(!vector_.isHaloInFlight())
+            {
+                vector_.beginHaloExchange();
+                vector_.finishHaloExchange();
+            }
+            ptr_ = vector_.getPtr();
+        }
+    };
+
+private:
+    vector_type vector_;
+
+public:
+    ShiftExpression(vector_type const& vector) : vector_(vector)
+    {
+        if(width > vector.getHaloWidth())
+            throw std::invalid_argument("Shift exceeds the halo width of the distributed vector");
+
+        this->queue_ = vector.getQueue();
+        this->extent_ = vector.getExtent();
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {vector_};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        vector_.visit(visitor);
+    }
+
+    vector_type const& getVector() const
+    {
+        return vector_;
+    }
+};
+
+namespace impl_detail
+{
+    template<typename T>
+    struct is_distributed_shift : std::false_type
+    {
+    };
+
+    template<typename TBuf, typename TQueue, typename TAcc, int shift>
+    struct is_distributed_shift<ShiftExpression<DistributedVector<TBuf, TQueue, TAcc>, shift>> : std::true_type
+    {
+    };
+
+    //! Posts the halo exchanges of all shifted distributed leaves of a tree.
+    struct HaloExchangeStarter
+    {
+        std::size_t width = 0;
+        std::vector<std::function<void()>> finishers;
+
+        template<typename TNode>
+        void operator()(TNode const& node)
+        {
+            if constexpr(is_distributed_shift<TNode>::value)
+            {
+                auto const& vector = node.getVector();
+                vector.beginHaloExchange();
+                width = std::max<std::size_t>(width, TNode::width);
+                finishers.emplace_back([vector]() { vector.finishHaloExchange(); });
+            }
+        }
+
+        void finish()
+        {
+            for(auto& finisher : finishers)
+                finisher();
+        }
+    };
+
+    template<typename TVector>
+    struct LayoutFinder
+    {
+        std::optional<TVector> layout;
+
+        template<typename TNode>
+        void operator()(TNode const& node)
+        {
+            if constexpr(std::is_same_v<TNode, TVector>)
+            {
+                if(!layout)
+                    layout = node;
+            }
+        }
+    };
+} // namespace impl_detail
+
+//! Evaluates the local block in a fused kernel. If the tree reads halo cells, the interior which does not
+//! depend on them is computed while the halo exchange is in flight and the boundary cells afterwards.
+template<typename TBuf, typename TQueue, typename TAcc, typename TOtherDerived, bool isLazyEvaluatable>
+struct evaluator<DistributedVector<TBuf, TQueue, TAcc>, TOtherDerived, isLazyEvaluatable>
+{
+    using vector_type = DistributedVector<TBuf, TQueue, TAcc>;
+    using idx_type = alpaka::Idx<TBuf>;
+
+    static vector_type& assign(vector_type& dest, TOtherDerived const& src)
+    {
+        static_assert(
+            !impl_detail::has_unsupported_distributed_shift<TOtherDerived>::value,
+            "Only a DistributedVector itself can be shifted, assign shifted distributed sub-trees to a vector first");
+
+        if(!dest.isInitialized())
+        {
+            impl_detail::LayoutFinder<vector_type> finder;
+            src.visit(finder);
+            if(!finder.layout)
+                throw std::invalid_argument("Expression does not contain a distributed vector");
+            dest.adoptLayout(*finder.layout);
+        }
+
+        if(dest.getExtent() != src.getExtent())
+            throw std::invalid_argument("Extents of arguments are mismatched");
+
+        impl_detail::HaloExchangeStarter starter;
+        src.visit(starter);
+
+        impl_detail::EvaluationScope evaluation;
+        auto handler = impl_detail::make_kernel_handler(src);
+        handler.prepare();
+
+        auto queue = dest.getQueue();
+        auto* const res = dest.getPtr();
+        idx_type const n = dest.getExtent()[0];
+        idx_type const w = std::min(static_cast<idx_type>(starter.width), n);
+
+        if(w == 0)
+        {
+            impl_detail::launch_assign_kernel<TAcc>(queue, res, handler, idx_type{0}, n);
+        }
+        else
+        {
+            idx_type const upper = std::max(w, n - w);
+            impl_detail::launch_assign_kernel<TAcc>(queue, res, handler, w, upper);
+            starter.finish();
+            impl_detail::launch_assign_kernel<TAcc>(queue, res, handler, idx_type{0}, w);
+            impl_detail::launch_assign_kernel<TAcc>(queue, res, handler, upper, n);
+        }
+
+        dest.invalidateHalo();
+        impl_detail::finish_evaluation(queue);
+        return dest;
+    }
+};
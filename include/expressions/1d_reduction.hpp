@@ -1,10 +1,18 @@
 #pragma once
 
+#include "flat_handler.hpp"
 #include "functors.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
 
 #include <alpaka/alpaka.hpp>
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
 
 template<typename TDerived>
 class ExpressionBase;
@@ -26,59 +34,86 @@ namespace impl_detail
         return (traits::MaxBlockSize::value > TSize) ? TSize : traits::MaxBlockSize::value;
     }
 
-    // Note: Boost Fibers, OpenMP 2 Threads and TBB Blocks accelerators aren't implented
-#ifdef ALPAKA_ACC_CPU_B_OMP2_T_SEQ_ENABLED
-    //! OpenMP 2 Blocks defines
+    // The block size traits are only needed by the accelerators with shared memory reductions,
+    // CPU accelerators use cpu_reduce() below.
+#ifdef ALPAKA_ACC_ANY_BT_OMP5_ENABLED
+    //! OpenMP 5 defines
     //!
-    //! Defines Host, Device, etc. for the OpenMP 2 Blocks accelerator.
+    //! Defines Host, Device, etc. for the OpenMP 5 accelerator.
     template<typename Dim, typename Idx>
-    struct block_size_traits<alpaka::AccCpuOmp2Blocks<Dim, Idx>>
+    struct block_size_traits<alpaka::AccOmp5<Dim, Idx>>
     {
         using MaxBlockSize = alpaka::DimInt<1u>;
     };
 #endif
 
-#ifdef ALPAKA_ACC_ANY_BT_OMP5_ENABLED
-    //! OpenMP 5 defines
+#ifdef ALPAKA_ACC_GPU_CUDA_ENABLED
+    //! CUDA defines
     //!
-    //! Defines Host, Device, etc. for the OpenMP 5 accelerator.
+    //! Defines Host, Device, etc. for the CUDA accelerator.
     template<typename Dim, typename Idx>
-    struct block_size_traits<alpaka::AccOmp5<Dim, Idx>>
+    struct block_size_traits<alpaka::AccGpuCudaRt<Dim, Idx>>
     {
-        using MaxBlockSize = alpaka::DimInt<1u>;
+        using MaxBlockSize = alpaka::DimInt<1024u>;
     };
 #endif
 
-#ifdef ALPAKA_ACC_CPU_B_SEQ_T_SEQ_ENABLED
-    //! Serial CPU defines
+#ifdef ALPAKA_ACC_GPU_HIP_ENABLED
+    //! HIP defines
     //!
-    //! Defines Host, Device, etc. for the serial CPU accelerator.
+    //! Defines Host, Device, etc. for the HIP accelerator.
     template<typename Dim, typename Idx>
-    struct block_size_traits<alpaka::AccCpuSerial<Dim, Idx>>
+    struct block_size_traits<alpaka::AccGpuHipRt<Dim, Idx>>
     {
-        using MaxBlockSize = alpaka::DimInt<1u>;
+        using MaxBlockSize = alpaka::DimInt<1024u>;
+    };
+#endif
+
+    //! How a CPU accelerator executes a kernel in parallel.
+    enum class CpuParallelism
+    {
+        None, //!< blocks and threads are executed one after another
+        Blocks, //!< blocks run in parallel, one thread per block
+        Threads //!< the threads of a block run in parallel
+    };
+
+    //! Accelerators running their blocks in parallel (OpenMP 2 Blocks, TBB Blocks) use the default.
+    template<typename TAcc>
+    struct cpu_reduction_traits
+    {
+        static constexpr CpuParallelism parallelism = CpuParallelism::Blocks;
+    };
+
+#ifdef ALPAKA_ACC_CPU_B_SEQ_T_SEQ_ENABLED
+    template<typename Dim, typename Idx>
+    struct cpu_reduction_traits<alpaka::AccCpuSerial<Dim, Idx>>
+    {
+        static constexpr CpuParallelism parallelism = CpuParallelism::None;
+    };
+#endif
+
+#ifdef ALPAKA_ACC_CPU_B_SEQ_T_FIBERS_ENABLED
+    //! fibers are scheduled cooperatively on one system thread
+    template<typename Dim, typename Idx>
+    struct cpu_reduction_traits<alpaka::AccCpuFibers<Dim, Idx>>
+    {
+        static constexpr CpuParallelism parallelism = CpuParallelism::None;
     };
 #endif
 
 #ifdef ALPAKA_ACC_CPU_B_SEQ_T_THREADS_ENABLED
-    //! CPU Threads defines
-    //!
-    //! Defines Host, Device, etc. for the CPU Threads accelerator.
     template<typename Dim, typename Idx>
-    struct block_size_traits<alpaka::AccCpuThreads<Dim, Idx>>
+    struct cpu_reduction_traits<alpaka::AccCpuThreads<Dim, Idx>>
     {
-        using MaxBlockSize = alpaka::DimInt<1u>;
+        static constexpr CpuParallelism parallelism = CpuParallelism::Threads;
     };
 #endif
 
-#ifdef ALPAKA_ACC_GPU_CUDA_ENABLED
-    //! CUDA defines
-    //!
-    //! Defines Host, Device, etc. for the CUDA/HIP accelerator.
+#ifdef ALPAKA_ACC_CPU_B_SEQ_T_OMP2_ENABLED
     template<typename Dim, typename Idx>
-    struct block_size_traits<alpaka::AccGpuCudaRt<Dim, Idx>>
+    struct cpu_reduction_traits<alpaka::AccCpuOmp2Threads<Dim, Idx>>
     {
-        using MaxBlockSize = alpaka::DimInt<1024u>;
+        static constexpr CpuParallelism parallelism = CpuParallelism::Threads;
     };
 #endif
 
@@ -231,19 +266,193 @@ namespace impl_detail
         }
     };
 
+    //! Reduces the elements [first, last) with TAccumulators independent accumulators, so consecutive
+    //! elements don't depend on each other and the loop can be vectorized. The accumulators are
+    //! initialized with the first elements, so no neutral element is needed. The range must not be empty.
+    ALPAKA_NO_HOST_ACC_WARNING
+    template<uint32_t TAccumulators, typename T, typename TAccExprHandler, typename TIdx, typename TFunc>
+    ALPAKA_FN_ACC auto reduce_chunk(TAccExprHandler& handler, TIdx first, TIdx last, TFunc const& func) -> T
+    {
+        if(last - first < TAccumulators)
+        {
+            T result = handler.getValue(first);
+            for(TIdx i = first + 1; i < last; ++i)
+                result = func(result, handler.getValue(i));
+            return result;
+        }
+
+        cheapArray<T, TAccumulators> accumulators;
+        ALPAKA_UNROLL()
+        for(uint32_t j = 0; j < TAccumulators; ++j)
+            accumulators[j] = handler.getValue(first + j);
+
+        TIdx i = first + TAccumulators;
+        for(; i + TAccumulators <= last; i += TAccumulators)
+        {
+            ALPAKA_UNROLL()
+            for(uint32_t j = 0; j < TAccumulators; ++j)
+                accumulators[j] = func(accumulators[j], handler.getValue(i + j));
+        }
+        for(; i < last; ++i)
+            accumulators[0] = func(accumulators[0], handler.getValue(i));
+
+        ALPAKA_UNROLL()
+        for(uint32_t width = TAccumulators / 2; width > 0; width /= 2)
+            for(uint32_t j = 0; j < width; ++j)
+                accumulators[j] = func(accumulators[j], accumulators[j + width]);
+
+        return accumulators[0];
+    }
+
+    //! Identity of the reduction functor, which is the result of reducing no elements.
+    //! Functors without an identity member give a value initialized T.
+    template<typename T, typename TFunc, typename = void>
+    struct reduction_identity
+    {
+        static constexpr auto value() -> T
+        {
+            return T{};
+        }
+    };
+
+    template<typename T, typename TFunc>
+    struct reduction_identity<T, TFunc, std::void_t<decltype(TFunc::identity)>>
+    {
+        static constexpr auto value() -> T
+        {
+            return static_cast<T>(TFunc::identity);
+        }
+    };
+
+    //! Reduction kernel for CPU accelerators.
+    //!
+    //! Every worker (a block or a thread, depending on the accelerator) reduces one contiguous chunk
+    //! with reduce_chunk().
+    template<uint32_t TAccumulators, typename T, typename TFunc>
+    struct CpuReduceKernel
+    {
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TAccExprHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TAccExprHandler handler,
+            T* partials,
+            TIdx const& n,
+            TFunc func) const -> void
+        {
+            auto const worker = static_cast<TIdx>(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0]);
+            auto const workers = static_cast<TIdx>(alpaka::getWorkDiv<alpaka::Grid, alpaka::Threads>(acc)[0]);
+
+            // the host makes sure that there are at most n workers, so no chunk is empty
+            TIdx const first = n / workers * worker + (worker < n % workers ? worker : n % workers);
+            TIdx const last = first + n / workers + (worker < n % workers ? 1 : 0);
+
+            partials[worker] = reduce_chunk<TAccumulators, T>(handler, first, last, func);
+        }
+    };
+
+    //! Enqueues the reduction of a prepared handler by workers parallel workers on a CPU accelerator,
+    //! worker w leaves its partial result in partials[w]. workers has to be in [1, n].
     template<
         typename T,
         typename Idx,
         typename Dim,
         typename TAcc,
-        typename DevAcc,
         typename QueueAcc,
         typename TAccExprHandler,
         typename TFunc>
-    auto reduce(DevAcc devAcc, QueueAcc queue, Idx n, TAccExprHandler handler, TFunc func) -> T
+    void enqueue_cpu_reduce(
+        QueueAcc& queue,
+        Idx n,
+        TAccExprHandler const& handler,
+        TFunc func,
+        T* partials,
+        Idx workers)
     {
-        using Extent = uint64_t;
+        static constexpr uint32_t accumulators = 4;
+
+        alpaka::Vec<Dim, Idx> const extent(workers);
+        alpaka::Vec<Dim, Idx> const one(Idx{1});
+        auto const workDiv = cpu_reduction_traits<TAcc>::parallelism == CpuParallelism::Threads
+                                 ? alpaka::WorkDivMembers<Dim, Idx>{one, extent, one}
+                                 : alpaka::WorkDivMembers<Dim, Idx>{extent, one, one};
+
+        CpuReduceKernel<accumulators, T, TFunc> kernel;
+        alpaka::enqueue(queue, alpaka::createTaskKernel<TAcc>(workDiv, kernel, handler, partials, n, func));
+    }
+
+    //! Reduces the expression with workers parallel workers on a CPU accelerator and combines
+    //! their partial results on the host in a tree.
+    template<
+        typename T,
+        typename Idx,
+        typename Dim,
+        typename TAcc,
+        typename QueueAcc,
+        typename TAccExprHandler,
+        typename TFunc>
+    auto cpu_reduce(
+        alpaka::DevCpu const& devAcc,
+        QueueAcc queue,
+        Idx n,
+        TAccExprHandler handler,
+        TFunc func,
+        Idx workers) -> T
+    {
+        if(n == 0)
+            return reduction_identity<T, TFunc>::value();
+
+        workers = std::max(Idx{1}, std::min(workers, n));
+        alpaka::Vec<Dim, Idx> const extent(workers);
+        auto partialsBuf = alpaka::allocBuf<T, Idx>(devAcc, extent);
+        T* partials = alpaka::getPtrNative(partialsBuf);
+
+        handler.prepare();
+
+        enqueue_cpu_reduce<T, Idx, Dim, TAcc>(queue, n, handler, func, partials, workers);
+        alpaka::wait(queue);
+
+        for(Idx width = 1; width < workers; width *= 2)
+            for(Idx i = 0; i + width < workers; i += 2 * width)
+                partials[i] = func(partials[i], partials[i + width]);
+
+        return partials[0];
+    }
+
+    //! Number of parallel workers of a CPU accelerator.
+    template<typename TAcc, typename Idx>
+    auto cpu_reduction_workers(alpaka::DevCpu const& devAcc) -> Idx
+    {
+        auto const props = alpaka::getAccDevProps<TAcc>(devAcc);
+        switch(cpu_reduction_traits<TAcc>::parallelism)
+        {
+        case CpuParallelism::Blocks:
+            return static_cast<Idx>(props.m_multiProcessorCount);
+        case CpuParallelism::Threads:
+            return std::min(
+                static_cast<Idx>(props.m_blockThreadCountMax),
+                static_cast<Idx>(std::max(1u, std::thread::hardware_concurrency())));
+        default:
+            return Idx{1};
+        }
+    }
 
+    //! Work division which runs the given number of workers in parallel on a CPU accelerator, as blocks or as
+    //! threads of one block depending on what the accelerator executes concurrently.
+    template<typename TAcc, typename Idx>
+    auto cpu_work_div(Idx workers) -> alpaka::WorkDivMembers<alpaka::Dim<TAcc>, Idx>
+    {
+        Idx const one{1};
+        if constexpr(cpu_reduction_traits<TAcc>::parallelism == CpuParallelism::Threads)
+            return {one, workers, one};
+        else
+            return {workers, one, one};
+    }
+
+    //! Number of blocks of the first pass of a reduction of n elements on a GPU.
+    template<typename TAcc, typename DevAcc, typename Idx>
+    auto gpu_reduction_blocks(DevAcc const& devAcc, Idx n) -> uint32_t
+    {
         static constexpr uint64_t blockSize = getMaxBlockSize<TAcc, 256>();
 
         // calculate optimal block size (8 times the MP count proved to be
@@ -251,11 +460,30 @@ namespace impl_detail
         auto blockCount = static_cast<uint32_t>(alpaka::getAccDevProps<TAcc>(devAcc).m_multiProcessorCount * 8);
         auto maxBlockCount = static_cast<uint32_t>((((n + 1) / 2) - 1) / blockSize + 1); // ceil(ceil(n/2.0)/blockSize)
 
-        if(blockCount > maxBlockCount)
-            blockCount = maxBlockCount;
+        return (blockCount > maxBlockCount) ? maxBlockCount : blockCount;
+    }
 
-        alpaka::Buf<DevAcc, T, Dim, Extent> destinationDeviceMemory
-            = alpaka::allocBuf<T, Idx>(devAcc, static_cast<Extent>(blockCount));
+    //! Enqueues both passes of the reduction of a prepared handler on a GPU, the result is left in
+    //! partials[0]. partials needs blockCount elements.
+    template<
+        typename T,
+        typename Idx,
+        typename Dim,
+        typename TAcc,
+        typename QueueAcc,
+        typename TAccExprHandler,
+        typename TFunc>
+    void enqueue_gpu_reduce(
+        QueueAcc& queue,
+        Idx n,
+        TAccExprHandler const& handler,
+        TFunc func,
+        T* partials,
+        uint32_t blockCount)
+    {
+        using Extent = uint64_t;
+
+        static constexpr uint64_t blockSize = getMaxBlockSize<TAcc, 256>();
 
         // create kernels with their workdivs
         ReduceKernel<blockSize, T, TFunc> kernel1, kernel2;
@@ -268,31 +496,51 @@ namespace impl_detail
             static_cast<Extent>(blockSize),
             static_cast<Extent>(1)};
 
-        handler.prepare();
-
         // create main reduction kernel execution task
-        auto const taskKernelReduceMain = alpaka::createTaskKernel<TAcc>(
-            workDiv1,
-            kernel1,
-            handler,
-            alpaka::getPtrNative(destinationDeviceMemory),
-            n,
-            func);
+        auto const taskKernelReduceMain
+            = alpaka::createTaskKernel<TAcc>(workDiv1, kernel1, handler, partials, n, func);
 
-        DevicePointerAccExprHandler<T, Idx> ptrHandler{alpaka::getPtrNative(destinationDeviceMemory)};
+        DevicePointerAccExprHandler<T, Idx> ptrHandler{partials};
 
         // create last block reduction kernel execution task
-        auto const taskKernelReduceLastBlock = alpaka::createTaskKernel<TAcc>(
-            workDiv2,
-            kernel2,
-            ptrHandler,
-            alpaka::getPtrNative(destinationDeviceMemory),
-            blockCount,
-            func);
+        auto const taskKernelReduceLastBlock
+            = alpaka::createTaskKernel<TAcc>(workDiv2, kernel2, ptrHandler, partials, blockCount, func);
 
         // enqueue both kernel execution tasks
         alpaka::enqueue(queue, taskKernelReduceMain);
         alpaka::enqueue(queue, taskKernelReduceLastBlock);
+    }
+
+    template<
+        typename T,
+        typename Idx,
+        typename Dim,
+        typename TAcc,
+        typename DevAcc,
+        typename QueueAcc,
+        typename TAccExprHandler,
+        typename TFunc>
+    auto gpu_reduce(DevAcc devAcc, QueueAcc queue, Idx n, TAccExprHandler handler, TFunc func) -> T
+    {
+        using Extent = uint64_t;
+
+        if(n == 0)
+            return reduction_identity<T, TFunc>::value();
+
+        auto const blockCount = gpu_reduction_blocks<TAcc>(devAcc, n);
+
+        alpaka::Buf<DevAcc, T, Dim, Extent> destinationDeviceMemory
+            = alpaka::allocBuf<T, Idx>(devAcc, static_cast<Extent>(blockCount));
+
+        handler.prepare();
+
+        enqueue_gpu_reduce<T, Idx, Dim, TAcc>(
+            queue,
+            n,
+            handler,
+            func,
+            alpaka::getPtrNative(destinationDeviceMemory),
+            blockCount);
 
         //  download result from GPU
         std::array<T, 1> resultGpuHost;
@@ -301,6 +549,92 @@ namespace impl_detail
 
         return resultGpuHost[0];
     }
+
+    template<
+        typename T,
+        typename Idx,
+        typename Dim,
+        typename TAcc,
+        typename DevAcc,
+        typename QueueAcc,
+        typename TAccExprHandler,
+        typename TFunc>
+    auto reduce(DevAcc devAcc, QueueAcc queue, Idx n, TAccExprHandler handler, TFunc func) -> T
+    {
+        if constexpr(std::is_same_v<DevAcc, alpaka::DevCpu>)
+        {
+            auto const workers = cpu_reduction_workers<TAcc, Idx>(devAcc);
+            return cpu_reduce<T, Idx, Dim, TAcc>(devAcc, queue, n, handler, func, workers);
+        }
+        else
+        {
+            return gpu_reduce<T, Idx, Dim, TAcc>(devAcc, queue, n, handler, func);
+        }
+    }
+
+    //! Number of partial results which enqueue_reduce leaves for a reduction of n > 0 elements.
+    template<typename TAcc, typename Idx, typename DevAcc>
+    auto reduction_partials(DevAcc const& devAcc, Idx n) -> Idx
+    {
+        if constexpr(std::is_same_v<DevAcc, alpaka::DevCpu>)
+            return std::max(Idx{1}, std::min(cpu_reduction_workers<TAcc, Idx>(devAcc), n));
+        else
+            return Idx{1};
+    }
+
+    //! Elements of the buffer for the partial results of enqueue_reduce.
+    template<typename TAcc, typename Idx, typename DevAcc>
+    auto reduction_buffer_size(DevAcc const& devAcc, Idx n) -> Idx
+    {
+        if constexpr(std::is_same_v<DevAcc, alpaka::DevCpu>)
+            return reduction_partials<TAcc>(devAcc, n);
+        else
+            return static_cast<Idx>(gpu_reduction_blocks<TAcc>(devAcc, n));
+    }
+
+    //! Enqueues the reduction of a prepared handler without waiting for it, so the result stays on the
+    //! device: the first reduction_partials(devAcc, n) elements of partials have to be combined with func
+    //! by a later kernel. n has to be positive, empty reductions are handled by the caller.
+    template<
+        typename T,
+        typename Idx,
+        typename Dim,
+        typename TAcc,
+        typename DevAcc,
+        typename QueueAcc,
+        typename TAccExprHandler,
+        typename TFunc>
+    void enqueue_reduce(
+        DevAcc const& devAcc,
+        QueueAcc& queue,
+        Idx n,
+        TAccExprHandler const& handler,
+        TFunc func,
+        T* partials)
+    {
+        if constexpr(std::is_same_v<DevAcc, alpaka::DevCpu>)
+        {
+            auto const workers = reduction_partials<TAcc>(devAcc, n);
+            enqueue_cpu_reduce<T, Idx, Dim, TAcc>(queue, n, handler, func, partials, workers);
+        }
+        else
+        {
+            auto const blocks = gpu_reduction_blocks<TAcc>(devAcc, n);
+            enqueue_gpu_reduce<T, Idx, Dim, TAcc>(queue, n, handler, func, partials, blocks);
+        }
+    }
+
+    //! Hook which is applied to the locally reduced value before it is returned,
+    //! e.g. to combine the partial results of several processes.
+    template<typename TExpr, typename = void>
+    struct reduction_finalizer
+    {
+        template<typename T, typename TFunc>
+        static T finalize(TExpr const& /* expr */, T value, TFunc const& /* func */)
+        {
+            return value;
+        }
+    };
 } // namespace impl_detail
 
 template<typename InnerExpr, typename Op>
@@ -332,16 +666,28 @@ public:
 
         void prepare()
         {
+            impl_detail::TilingScope suspend_tiling;
             reduction_res_ = results_.compute();
         }
     };
 
 private:
+    // shared by all copies of the expression
+    struct State
+    {
+        std::optional<value_type> result;
+        std::uint64_t evaluation = 0;
+    };
+
     InnerExpr expr_;
     Op op_;
+    std::shared_ptr<State> state_;
 
 public:
-    Reduction1DExpression(InnerExpr const& expr, Op const& op) : expr_(expr), op_(op)
+    Reduction1DExpression(InnerExpr const& expr, Op const& op)
+        : expr_(expr)
+        , op_(op)
+        , state_(std::make_shared<State>())
     {
         this->queue_ = expr_.getQueue();
         this->extent_ = 1;
@@ -352,14 +698,53 @@ public:
         return {*this};
     }
 
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        expr_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<Reduction1DExpression>();
+        key.appendFunctor(op_);
+        impl_detail::append_cache_key(expr_, key);
+    }
+
     value_type compute() const
     {
+        // a copy of this expression was already reduced in the current evaluation
+        impl_detail::EvaluationScope evaluation;
+        if(state_->result && state_->evaluation == evaluation.id())
+            return *state_->result;
+
+        // results are remembered across evaluations and reused while no leaf of the tree is modified
+        auto& cache = impl_detail::ExpressionCache<value_type>::instance();
+        auto key = impl_detail::make_cache_key(*this);
+        if(auto const cached = cache.find(key))
+        {
+            state_->result = cached;
+            state_->evaluation = evaluation.id();
+            return *cached;
+        }
+
         auto queue = expr_.getQueue();
         auto dev = alpaka::getDev(queue);
         auto const N = expr_.getExtent()[0];
 
-        return impl_detail::reduce<value_type, idx_type, dim_type, acc_type>(dev, queue, N, expr_.getHandler(), op_);
-        // return impl_detail::reduce<value_type>(dev);
+        auto const local
+            = impl_detail::reduce<value_type, idx_type, dim_type, acc_type>(
+                dev,
+                queue,
+                N,
+                impl_detail::make_kernel_handler(expr_),
+                op_);
+        auto const result = impl_detail::reduction_finalizer<InnerExpr>::finalize(expr_, local, op_);
+        cache.insert(std::move(key), result);
+        state_->result = result;
+        state_->evaluation = evaluation.id();
+        return result;
     }
 };
 
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "memoization.hpp"
+#include "tiling.hpp"
+
 #include <alpaka/alpaka.hpp>
 
 #include <memory>
@@ -48,6 +51,12 @@ public:
             lhs_.prepare();
             rhs_.prepare();
         }
+
+        ALPAKA_FN_ACC void beginTile(idx_type slot, idx_type first, idx_type last)
+        {
+            impl_detail::begin_tile(lhs_, slot, first, last);
+            impl_detail::begin_tile(rhs_, slot, first, last);
+        }
     };
 
 private:
@@ -76,6 +85,37 @@ public:
     {
         return {lhs_.getHandler(), rhs_.getHandler(), functor_};
     }
+
+    Lhs const& getLhs() const
+    {
+        return lhs_;
+    }
+
+    Rhs const& getRhs() const
+    {
+        return rhs_;
+    }
+
+    Functor const& getFunctor() const
+    {
+        return functor_;
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        lhs_.visit(visitor);
+        rhs_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<BinaryCwiseExpression>();
+        key.appendFunctor(functor_);
+        impl_detail::append_cache_key(lhs_, key);
+        impl_detail::append_cache_key(rhs_, key);
+    }
 };
 
 template<typename Lhs, typename Rhs, typename Functor>
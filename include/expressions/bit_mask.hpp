@@ -0,0 +1,177 @@
+#pragma once
+
+#include "expression_base.hpp"
+#include "flat_handler.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+#include "vector.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstdint>
+
+namespace impl_detail
+{
+    //! Packs 32 mask elements into every word. A thread writes whole words, so no atomics are needed.
+    class PackBitMaskKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TAccExprHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            std::uint32_t* const words,
+            TAccExprHandler expr,
+            TIdx const& numElements,
+            TIdx const& numWords) const -> void
+        {
+            TIdx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const threadElemExtent(alpaka::getWorkDiv<alpaka::Thread, alpaka::Elems>(acc)[0u]);
+            TIdx const threadFirstWord(gridThreadIdx * threadElemExtent);
+            TIdx const threadLastWord(
+                (numWords > threadFirstWord + threadElemExtent) ? threadFirstWord + threadElemExtent : numWords);
+
+            for(TIdx w(threadFirstWord); w < threadLastWord; ++w)
+            {
+                TIdx const first = w * 32u;
+                TIdx const bits = (numElements - first < 32u) ? numElements - first : TIdx{32u};
+
+                std::uint32_t word = 0;
+                for(TIdx b = 0; b < bits; ++b)
+                    word |= static_cast<std::uint32_t>(static_cast<bool>(expr.getValue(first + b))) << b;
+                words[w] = word;
+            }
+        }
+    };
+} // namespace impl_detail
+
+//! Mask stored with one bit per element, e.g. to keep the result of a comparison for several steps
+//! with 1/64 of the memory traffic of a Vector<double>. Assigning a bool expression packs it in one kernel,
+//! reading it yields bool, so it can be used as the mask of where() or in && and ||.
+template<typename TQueue, typename TAcc>
+class BitMask : public ExpressionBase<BitMask<TQueue, TAcc>>
+{
+public:
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using value_type = bool;
+    using word_type = std::uint32_t;
+    using buf_type = alpaka::Buf<TAcc, word_type, dim_type, idx_type>;
+    using words_type = Vector<buf_type, TQueue, TAcc>;
+
+    static constexpr idx_type bits_per_word = 32u;
+
+public:
+    struct AccExpressionHandler
+    {
+        BitMask const& mask_;
+        word_type const* words_;
+
+        AccExpressionHandler(BitMask const& mask) : mask_(mask)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return (words_[i / bits_per_word] >> (i % bits_per_word)) & 1u;
+        }
+
+        void prepare()
+        {
+            words_ = mask_.getPtr();
+        }
+    };
+
+private:
+    words_type words_;
+
+public:
+    BitMask(TQueue& queue, idx_type size = 1) : words_(queue, (size + bits_per_word - 1) / bits_per_word)
+    {
+        this->queue_ = queue;
+        this->extent_[0] = size;
+    }
+
+    //! Evaluates the expression and packs its elements.
+    template<typename TOtherDerived>
+    BitMask& operator=(ExpressionBase<TOtherDerived> const& other)
+    {
+        auto queue = other.getQueue();
+        idx_type const n = other.getExtent()[0];
+        idx_type const numWords = (n + bits_per_word - 1) / bits_per_word;
+        words_.adjust_size(numWords > 0 ? numWords : 1, queue);
+        this->queue_ = queue;
+        this->extent_[0] = n;
+
+        impl_detail::EvaluationScope evaluation;
+        auto handler = impl_detail::make_kernel_handler(other.derived());
+        {
+            impl_detail::TilingScope suspend_tiling;
+            handler.prepare();
+        }
+
+        if(numWords > 0)
+        {
+            alpaka::Vec<dim_type, idx_type> const extent(numWords);
+            alpaka::WorkDivMembers<dim_type, idx_type> const workDiv(alpaka::getValidWorkDiv<TAcc>(
+                alpaka::getDev(queue),
+                extent,
+                idx_type{8u},
+                false,
+                alpaka::GridBlockExtentSubDivRestrictions::Unrestricted));
+
+            impl_detail::PackBitMaskKernel kernel;
+            alpaka::enqueue(
+                queue,
+                alpaka::createTaskKernel<TAcc>(workDiv, kernel, words_.getPtr(), handler, n, numWords));
+        }
+        words_.markModified();
+
+        impl_detail::finish_evaluation(queue);
+        return *this;
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {*this};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<BitMask>();
+        key.append(this->extent_[0]);
+        words_.appendCacheKey(key);
+    }
+
+    //! The packed words, bit i % 32 of word i / 32 is element i.
+    words_type const& getWords() const
+    {
+        return words_;
+    }
+
+    word_type* getPtr() const
+    {
+        return words_.getPtr();
+    }
+};
+
+template<typename TQueue, typename TAcc>
+struct expr_traits<BitMask<TQueue, TAcc>>
+{
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using value_type = bool;
+    using eval_ret_type = BitMask<TQueue, TAcc>;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
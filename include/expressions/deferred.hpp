@@ -0,0 +1,500 @@
+#pragma once
+
+#include "evaluator.hpp"
+#include "flat_handler.hpp"
+#include "fusion_planner.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template<typename TBuf, typename TQueue, typename TAcc>
+class Vector;
+
+template<typename InnerExpr, typename Functor>
+class UnaryCwiseExpression;
+
+template<typename Lhs, typename Rhs, typename Functor>
+class BinaryCwiseExpression;
+
+template<typename InnerExpr>
+class MaterializeExpression;
+
+template<typename InnerExpr, int shift>
+class ShiftExpression;
+
+template<typename InnerExpr, typename Op>
+class Reduction1DExpression;
+
+template<typename InnerExpr, typename Op>
+class ScanExpression;
+
+template<typename Source, typename Indices>
+class GatherExpression;
+
+template<typename Mask, typename TrueExpr, typename FalseExpr>
+class WhereExpression;
+
+template<typename TQueue, typename TAcc, typename TDistribution>
+class RandomExpression;
+
+template<typename TQueue, typename TAcc, typename TGenerator>
+class GeneratorExpression;
+
+namespace impl_detail
+{
+    // Deferred statements: consecutive assignments are collected and evaluated together when they are
+    // flushed. Statements over the same extent whose dependencies are point wise (statement j reads
+    // element i of a vector which statement k < j wrote at element i) run in one kernel, in which every
+    // thread evaluates all statements of the group for its elements in order. A statement starts a new
+    // kernel when it reads a vector which was written in the current group at other indices (e.g.
+    // through a shift or a reduction), writes a vector which an earlier statement of the group reads at
+    // other indices, or has another extent. Vectors are identified by their buffers.
+
+    //! Nodes whose operands are read at the index which is computed.
+    template<typename TNode>
+    struct is_pointwise_node : std::false_type
+    {
+    };
+
+    template<typename TBuf, typename TQueue, typename TAcc>
+    struct is_pointwise_node<Vector<TBuf, TQueue, TAcc>> : std::true_type
+    {
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct is_pointwise_node<UnaryCwiseExpression<InnerExpr, Functor>> : std::true_type
+    {
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct is_pointwise_node<BinaryCwiseExpression<Lhs, Rhs, Functor>> : std::true_type
+    {
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr>
+    struct is_pointwise_node<WhereExpression<Mask, TrueExpr, FalseExpr>> : std::true_type
+    {
+    };
+
+    template<typename TQueue, typename TAcc, typename TDistribution>
+    struct is_pointwise_node<RandomExpression<TQueue, TAcc, TDistribution>> : std::true_type
+    {
+    };
+
+    template<typename TQueue, typename TAcc, typename TGenerator>
+    struct is_pointwise_node<GeneratorExpression<TQueue, TAcc, TGenerator>> : std::true_type
+    {
+    };
+
+    template<typename TNode>
+    struct is_vector_leaf : std::false_type
+    {
+    };
+
+    template<typename TBuf, typename TQueue, typename TAcc>
+    struct is_vector_leaf<Vector<TBuf, TQueue, TAcc>> : std::true_type
+    {
+    };
+
+    //! Nodes which read their operands at other indices, but visit all of them.
+    template<typename TNode>
+    struct is_transparent_node : is_pointwise_node<TNode>
+    {
+    };
+
+    template<typename InnerExpr, int shift>
+    struct is_transparent_node<ShiftExpression<InnerExpr, shift>> : std::true_type
+    {
+    };
+
+    template<typename InnerExpr>
+    struct is_transparent_node<MaterializeExpression<InnerExpr>> : std::true_type
+    {
+    };
+
+    template<typename InnerExpr, typename Op>
+    struct is_transparent_node<Reduction1DExpression<InnerExpr, Op>> : std::true_type
+    {
+    };
+
+    template<typename InnerExpr, typename Op>
+    struct is_transparent_node<ScanExpression<InnerExpr, Op>> : std::true_type
+    {
+    };
+
+    template<typename Source, typename Indices>
+    struct is_transparent_node<GatherExpression<Source, Indices>> : std::true_type
+    {
+    };
+
+    //! Bytes [first, last) of a buffer.
+    struct MemoryRange
+    {
+        std::uintptr_t first;
+        std::uintptr_t last;
+
+        bool overlaps(MemoryRange const& other) const
+        {
+            return first < other.last && other.first < last;
+        }
+    };
+
+    inline bool overlaps_any(MemoryRange const& range, std::vector<MemoryRange> const& ranges)
+    {
+        for(auto const& other : ranges)
+        {
+            if(range.overlaps(other))
+                return true;
+        }
+        return false;
+    }
+
+    template<typename TVector>
+    MemoryRange memory_range(TVector const& vector)
+    {
+        auto const first = reinterpret_cast<std::uintptr_t>(vector.getPtr());
+        return {first, first + vector.getExtent()[0] * sizeof(typename TVector::value_type)};
+    }
+
+    //! Vectors read by a tree. If a node reads at other indices, all vectors of the tree count as read
+    //! at other indices; nodes which may read buffers without visiting them make the tree opaque.
+    struct StatementReads
+    {
+        std::vector<MemoryRange> vectors;
+        bool pointwise = true;
+        bool opaque = false;
+
+        template<typename TNode>
+        void operator()(TNode const& node)
+        {
+            if constexpr(!is_transparent_node<TNode>::value)
+                opaque = true;
+            else if constexpr(!is_pointwise_node<TNode>::value)
+                pointwise = false;
+
+            if constexpr(is_vector_leaf<TNode>::value)
+            {
+                if(node.hasBuffer())
+                    vectors.push_back(memory_range(node));
+            }
+        }
+    };
+
+    //! Ranges of statements which are evaluated in one kernel.
+    class StatementGrouping
+    {
+    private:
+        std::vector<MemoryRange> written_;
+        std::vector<MemoryRange> read_elsewhere_;
+        bool opaque_ = false;
+        std::size_t extent_ = 0;
+
+    public:
+        //! Whether the statement can join the current group, starts a new group otherwise.
+        bool join(std::size_t extent, MemoryRange dest, StatementReads const& reads)
+        {
+            bool conflict = written_.empty() ? false : (extent != extent_);
+            conflict = conflict || (opaque_ && !written_.empty());
+            conflict = conflict || (reads.opaque && !written_.empty());
+            conflict = conflict || overlaps_any(dest, read_elsewhere_);
+            if(!reads.pointwise)
+            {
+                for(auto const& range : reads.vectors)
+                    conflict = conflict || overlaps_any(range, written_);
+            }
+
+            if(conflict)
+            {
+                written_.clear();
+                read_elsewhere_.clear();
+                opaque_ = false;
+            }
+
+            extent_ = extent;
+            written_.push_back(dest);
+            opaque_ = opaque_ || reads.opaque;
+            if(!reads.pointwise)
+                read_elsewhere_.insert(read_elsewhere_.end(), reads.vectors.begin(), reads.vectors.end());
+            return !conflict;
+        }
+    };
+
+    //! Destination and prepared handler of one statement.
+    template<typename TElem, typename THandler>
+    struct StatementHandler
+    {
+        TElem* res;
+        THandler handler;
+    };
+
+    //! Handlers of all statements, stored recursively because kernel arguments have to be trivially
+    //! copyable. Only the statements [first, last) are prepared and evaluated.
+    template<typename... THandlers>
+    struct StatementHandlers
+    {
+        void prepare(std::size_t, std::size_t, std::size_t)
+        {
+        }
+
+        template<typename TIdx>
+        ALPAKA_FN_ACC void assign(TIdx, std::size_t, std::size_t, std::size_t) const
+        {
+        }
+    };
+
+    template<typename THead, typename... TTail>
+    struct StatementHandlers<THead, TTail...>
+    {
+        THead head;
+        StatementHandlers<TTail...> tail;
+
+        void prepare(std::size_t s, std::size_t first, std::size_t last)
+        {
+            if(s >= first && s < last)
+                head.handler.prepare();
+            tail.prepare(s + 1, first, last);
+        }
+
+        template<typename TIdx>
+        ALPAKA_FN_ACC void assign(TIdx i, std::size_t s, std::size_t first, std::size_t last) const
+        {
+            if(s >= first && s < last)
+                head.res[i] = head.handler.getValue(i);
+            tail.assign(i, s + 1, first, last);
+        }
+    };
+
+    //! Evaluates the statements [first, last) for every element.
+    class StatementsKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename THandlers, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            THandlers handlers,
+            std::size_t first,
+            std::size_t last,
+            TIdx const& numElements) const -> void
+        {
+            static_assert(alpaka::Dim<TAcc>::value == 1, "The StatementsKernel expects 1-dimensional indices!");
+
+            TIdx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const threadElemExtent(alpaka::getWorkDiv<alpaka::Thread, alpaka::Elems>(acc)[0u]);
+            TIdx const threadFirstElemIdx(gridThreadIdx * threadElemExtent);
+
+            if(threadFirstElemIdx < numElements)
+            {
+                TIdx const threadLastElemIdx(threadFirstElemIdx + threadElemExtent);
+                TIdx const threadLastElemIdxClipped(
+                    (numElements > threadLastElemIdx) ? threadLastElemIdx : numElements);
+
+                for(TIdx i(threadFirstElemIdx); i < threadLastElemIdxClipped; ++i)
+                {
+                    handlers.assign(i, 0, first, last);
+                }
+            }
+        }
+    };
+
+    //! dest = expr, recorded but not evaluated. The destination has to live until the statement is flushed.
+    //! It is resized when the statement is recorded, so the expressions of later statements read its new buffer.
+    template<typename TDest, typename TExpr>
+    class Statement
+    {
+    public:
+        using expr_type = std::conditional_t<use_fusion_planner<TExpr>, planned_t<TExpr, TExpr>, TExpr>;
+
+    private:
+        TDest* dest_;
+        expr_type expr_;
+
+        static expr_type plan(TExpr const& expr)
+        {
+            if constexpr(use_fusion_planner<TExpr>)
+                return plan_fusion(expr);
+            else
+                return expr;
+        }
+
+        static TDest& resized(TDest& dest, TExpr const& expr)
+        {
+            auto queue = expr.getQueue();
+            dest.adjust_size(expr.getExtent()[0], queue);
+            return dest;
+        }
+
+    public:
+        Statement(TDest& dest, TExpr const& expr) : dest_(&resized(dest, expr)), expr_(plan(expr))
+        {
+        }
+
+        TDest& dest() const
+        {
+            return *dest_;
+        }
+
+        expr_type const& expr() const
+        {
+            return expr_;
+        }
+
+        auto makeHandler() const
+        {
+            using handler_type = decltype(make_kernel_handler(expr_));
+            using value_type = typename TDest::value_type;
+            return StatementHandler<value_type, handler_type>{dest_->getPtr(), make_kernel_handler(expr_)};
+        }
+    };
+} // namespace impl_detail
+
+//! Assignments which are evaluated together by flush() or at the latest when the object is destroyed:
+//!
+//!     defer(k, dt * f).then(x, x + 0.5 * k).then(y, ShiftExpression<state_type, 1>(x) - x).flush();
+//!
+//! The first two statements are evaluated by one kernel, the third reads x at other indices and gets its own.
+template<typename... TStatements>
+class DeferredStatements
+{
+private:
+    std::tuple<TStatements...> statements_;
+    bool pending_ = true;
+
+    template<typename... TOthers>
+    friend class DeferredStatements;
+
+    template<std::size_t... Is>
+    void flush(std::index_sequence<Is...>)
+    {
+        using first_expr = typename std::tuple_element_t<0, std::tuple<TStatements...>>::expr_type;
+        using acc_type = typename first_expr::acc_type;
+        using idx_type = typename first_expr::idx_type;
+        constexpr std::size_t count = sizeof...(TStatements);
+
+        impl_detail::StatementGrouping grouping;
+        std::size_t starts[count + 1] = {};
+        idx_type extents[count] = {};
+        std::size_t groups = 0;
+        auto group = [&](auto const& statement, std::size_t s)
+        {
+            impl_detail::StatementReads reads;
+            statement.expr().visit(reads);
+            extents[s] = statement.expr().getExtent()[0];
+            if(!grouping.join(extents[s], impl_detail::memory_range(statement.dest()), reads) || s == 0)
+                starts[groups++] = s;
+        };
+        (group(std::get<Is>(statements_), Is), ...);
+        starts[groups] = count;
+
+        auto queue = std::get<0>(statements_).dest().getQueue();
+        impl_detail::EvaluationScope evaluation;
+        auto handlers = make_handlers(std::get<Is>(statements_)...);
+
+        for(std::size_t g = 0; g < groups; ++g)
+        {
+            std::size_t const first = starts[g];
+            std::size_t const last = starts[g + 1];
+            {
+                impl_detail::TilingScope suspend_tiling;
+                handlers.prepare(0, first, last);
+            }
+
+            idx_type const n = extents[first];
+            if(n == 0)
+                continue;
+
+            alpaka::Vec<alpaka::Dim<acc_type>, idx_type> const extent(n);
+            alpaka::WorkDivMembers<alpaka::Dim<acc_type>, idx_type> const workDiv(alpaka::getValidWorkDiv<acc_type>(
+                alpaka::getDev(queue),
+                extent,
+                idx_type{8u},
+                false,
+                alpaka::GridBlockExtentSubDivRestrictions::Unrestricted));
+
+            impl_detail::StatementsKernel kernel;
+            alpaka::enqueue(queue, alpaka::createTaskKernel<acc_type>(workDiv, kernel, handlers, first, last, n));
+
+            // later groups may reduce or memoize the destinations of this one when they are prepared
+            ((Is >= first && Is < last ? std::get<Is>(statements_).dest().markModified() : void()), ...);
+        }
+
+        impl_detail::finish_evaluation(queue);
+    }
+
+    template<typename THead, typename... TTail>
+    static auto make_handlers(THead const& head, TTail const&... tail)
+    {
+        return impl_detail::StatementHandlers<decltype(head.makeHandler()), decltype(tail.makeHandler())...>{
+            head.makeHandler(),
+            make_handlers(tail...)};
+    }
+
+    static impl_detail::StatementHandlers<> make_handlers()
+    {
+        return {};
+    }
+
+public:
+    explicit DeferredStatements(std::tuple<TStatements...> statements) : statements_(std::move(statements))
+    {
+    }
+
+    DeferredStatements(DeferredStatements const&) = delete;
+    DeferredStatements& operator=(DeferredStatements const&) = delete;
+
+    DeferredStatements(DeferredStatements&& other)
+        : statements_(std::move(other.statements_))
+        , pending_(other.pending_)
+    {
+        other.pending_ = false;
+    }
+
+    //! Errors of the evaluation at the end of the scope can't be reported, call flush() to see them.
+    ~DeferredStatements() noexcept
+    {
+        try
+        {
+            flush();
+        }
+        catch(...)
+        {
+        }
+    }
+
+    //! Appends dest = expr, the statements recorded so far are moved into the returned object.
+    template<typename TDest, typename TDerived>
+    DeferredStatements<TStatements..., impl_detail::Statement<TDest, TDerived>> then(
+        TDest& dest,
+        ExpressionBase<TDerived> const& expr)
+    {
+        pending_ = false;
+        return DeferredStatements<TStatements..., impl_detail::Statement<TDest, TDerived>>(std::tuple_cat(
+            std::move(statements_),
+            std::make_tuple(impl_detail::Statement<TDest, TDerived>(dest, expr.derived()))));
+    }
+
+    //! Evaluates all statements, later calls do nothing.
+    void flush()
+    {
+        if(!pending_)
+            return;
+        pending_ = false;
+        flush(std::index_sequence_for<TStatements...>{});
+    }
+};
+
+//! Starts a list of deferred statements with dest = expr, see DeferredStatements.
+template<typename TDest, typename TDerived>
+DeferredStatements<impl_detail::Statement<TDest, TDerived>> defer(TDest& dest, ExpressionBase<TDerived> const& expr)
+{
+    return DeferredStatements<impl_detail::Statement<TDest, TDerived>>(
+        std::make_tuple(impl_detail::Statement<TDest, TDerived>(dest, expr.derived())));
+}
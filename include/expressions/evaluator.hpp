@@ -1,5 +1,11 @@
 #pragma once
 
+#include "1d_reduction.hpp"
+#include "flat_handler.hpp"
+#include "fusion_planner.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+
 #include <alpaka/alpaka.hpp>
 
 #include <type_traits>
@@ -12,13 +18,52 @@ class Vector;
 
 namespace impl_detail
 {
+    //! Evaluations started during the lifetime of the scope only enqueue their kernels. Their temporaries
+    //! are kept until release_temporaries() is called after waiting for the queue, or until the next
+    //! evaluation outside of the scope waited.
+    class AsyncEvaluationScope
+    {
+        bool saved_;
+
+    public:
+        AsyncEvaluationScope() : saved_(evaluation_waits_suspended())
+        {
+            evaluation_waits_suspended() = true;
+        }
+
+        AsyncEvaluationScope(AsyncEvaluationScope const&) = delete;
+        AsyncEvaluationScope& operator=(AsyncEvaluationScope const&) = delete;
+
+        ~AsyncEvaluationScope()
+        {
+            evaluation_waits_suspended() = saved_;
+        }
+    };
+
+    //! Called at the end of every evaluation.
+    template<typename TQueue>
+    void finish_evaluation(TQueue& queue)
+    {
+#ifndef NOT_WAIT_FOR_EXPR_EVAL
+        if(!evaluation_waits_suspended())
+        {
+            alpaka::wait(queue);
+            release_temporaries();
+        }
+#endif
+    }
+
     class AccExpressionHandlerKernel
     {
     public:
         ALPAKA_NO_HOST_ACC_WARNING
         template<typename TAcc, typename TElem, typename TAccExprHandler, typename TIdx>
-        ALPAKA_FN_ACC auto operator()(TAcc const& acc, TElem* const res, TAccExprHandler expr, TIdx const& numElements)
-            const -> void
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TElem* const res,
+            TAccExprHandler expr,
+            TIdx const& firstElemIdx,
+            TIdx const& lastElemIdx) const -> void
         {
             static_assert(
                 alpaka::Dim<TAcc>::value == 1,
@@ -26,13 +71,13 @@ namespace impl_detail
 
             TIdx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
             TIdx const threadElemExtent(alpaka::getWorkDiv<alpaka::Thread, alpaka::Elems>(acc)[0u]);
-            TIdx const threadFirstElemIdx(gridThreadIdx * threadElemExtent);
+            TIdx const threadFirstElemIdx(firstElemIdx + gridThreadIdx * threadElemExtent);
 
-            if(threadFirstElemIdx < numElements)
+            if(threadFirstElemIdx < lastElemIdx)
             {
                 TIdx const threadLastElemIdx(threadFirstElemIdx + threadElemExtent);
                 TIdx const threadLastElemIdxClipped(
-                    (numElements > threadLastElemIdx) ? threadLastElemIdx : numElements);
+                    (lastElemIdx > threadLastElemIdx) ? threadLastElemIdx : lastElemIdx);
 
                 for(TIdx i(threadFirstElemIdx); i < threadLastElemIdxClipped; ++i)
                 {
@@ -42,21 +87,88 @@ namespace impl_detail
         }
     };
 
-    template<typename TBuf, typename TQueue, typename TAcc, typename TExpr>
-    void run_asign_kernel(Vector<TBuf, TQueue, TAcc>& res, TExpr& expr)
+    //! Evaluates the expression tile by tile, every grid thread owns a slot of the tile scratch.
+    class TiledAccExpressionHandlerKernel
     {
-        using Acc = TAcc;
-        auto queue = res.getQueue();
-        auto const devAcc = res.getDevice();
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TElem, typename TAccExprHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TElem* const res,
+            TAccExprHandler expr,
+            TIdx const& numElements,
+            TIdx const& tileSize) const -> void
+        {
+            static_assert(
+                alpaka::Dim<TAcc>::value == 1,
+                "The TiledAccExpressionHandlerKernel expects 1-dimensional indices!");
+
+            TIdx const slot(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const numSlots(alpaka::getWorkDiv<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+
+            for(TIdx first = slot * tileSize; first < numElements; first += numSlots * tileSize)
+            {
+                TIdx const last((numElements > first + tileSize) ? first + tileSize : numElements);
+
+                begin_tile(expr, slot, first, last);
+                for(TIdx i(first); i < last; ++i)
+                {
+                    res[i] = expr.getValue(i);
+                }
+            }
+        }
+    };
+
+    template<typename TAcc, typename TQueue, typename TElem, typename TExpr, typename TIdx>
+    void launch_tiled_assign_kernel(TQueue& queue, TElem* const res, TExpr const& expr, TIdx numElements)
+    {
+        using value_type = typename TExpr::value_type;
+
+        if(numElements == 0)
+            return;
+
+        // the tile of the result and of every materialized sub-tree should fit into the cache together
+        constexpr std::size_t buffers = 1 + tiled_materializations<TExpr>::value;
+        TIdx tileSize = static_cast<TIdx>(EXPR_EVAL_TILE_BYTES / (buffers * sizeof(value_type)));
+        tileSize = (tileSize == 0) ? 1 : (tileSize > numElements ? numElements : tileSize);
+
+        // one slot per CPU worker, the slots are blocks or threads of one block depending on the accelerator
+        auto slots = cpu_reduction_workers<TAcc, TIdx>(alpaka::getDev(queue));
+        TIdx const numTiles = (numElements + tileSize - 1) / tileSize;
+        slots = (slots > numTiles) ? numTiles : slots;
+
+        auto handler = make_kernel_handler(expr);
+        {
+            TilingScope tiling(true, slots, tileSize);
+            handler.prepare();
+        }
+
+        auto const workDiv = cpu_work_div<TAcc>(slots);
+
+        TiledAccExpressionHandlerKernel kernel;
+        auto const taskKernel
+            = alpaka::createTaskKernel<TAcc>(workDiv, kernel, res, handler, numElements, tileSize);
+
+        alpaka::enqueue(queue, taskKernel);
+    }
+
+    //! Enqueues the assignment of the elements [first, last) of an already prepared handler to res.
+    template<typename TAcc, typename TQueue, typename TElem, typename TAccExprHandler, typename TIdx>
+    void launch_assign_kernel(TQueue& queue, TElem* const res, TAccExprHandler const& handler, TIdx first, TIdx last)
+    {
+        if(first >= last)
+            return;
+
+        auto const devAcc = alpaka::getDev(queue);
 
         // Define the work division
-        using Dim = alpaka::Dim<TBuf>;
-        using Idx = alpaka::Idx<TBuf>;
-        Idx const elementsPerThread(8u);
-        alpaka::Vec<Dim, Idx> const extent = alpaka::getExtentVec(res.getBuffer());
+        using Dim = alpaka::Dim<TAcc>;
+        TIdx const elementsPerThread(8u);
+        alpaka::Vec<Dim, TIdx> const extent(last - first);
 
         // Let alpaka calculate good block and grid sizes given our full problem extent
-        alpaka::WorkDivMembers<Dim, Idx> const workDiv(alpaka::getValidWorkDiv<Acc>(
+        alpaka::WorkDivMembers<Dim, TIdx> const workDiv(alpaka::getValidWorkDiv<TAcc>(
             devAcc,
             extent,
             elementsPerThread,
@@ -64,19 +176,47 @@ namespace impl_detail
             alpaka::GridBlockExtentSubDivRestrictions::Unrestricted));
 
         AccExpressionHandlerKernel kernel;
-        auto handler = expr.getHandler();
-        handler.prepare();
-        auto const taskKernel = alpaka::createTaskKernel<Acc>(
-            workDiv,
-            kernel,
-            alpaka::getPtrNative(res.getBuffer()),
-            handler,
-            extent[0]);
+        auto const taskKernel = alpaka::createTaskKernel<TAcc>(workDiv, kernel, res, handler, first, last);
 
         alpaka::enqueue(queue, taskKernel);
-#ifndef NOT_WAIT_FOR_EXPR_EVAL
-        alpaka::wait(queue);
-#endif
+    }
+
+    //! Evaluates a tree which was already rewritten by the fusion planner.
+    template<typename TBuf, typename TQueue, typename TAcc, typename TExpr>
+    void run_planned_asign_kernel(Vector<TBuf, TQueue, TAcc>& res, TExpr& expr)
+    {
+        using Idx = alpaka::Idx<TBuf>;
+        auto queue = res.getQueue();
+        EvaluationScope evaluation;
+
+        if constexpr(use_tiled_evaluation<TAcc, std::remove_const_t<TExpr>>)
+        {
+            launch_tiled_assign_kernel<TAcc>(queue, res.getPtr(), expr, res.getExtent()[0]);
+        }
+        else
+        {
+            auto handler = make_kernel_handler(expr);
+            {
+                TilingScope suspend_tiling;
+                handler.prepare();
+            }
+            launch_assign_kernel<TAcc>(queue, res.getPtr(), handler, Idx{0}, res.getExtent()[0]);
+        }
+        res.markModified();
+
+        impl_detail::finish_evaluation(queue);
+    }
+
+    template<typename TBuf, typename TQueue, typename TAcc, typename TExpr>
+    void run_asign_kernel(Vector<TBuf, TQueue, TAcc>& res, TExpr& expr)
+    {
+        if constexpr(use_fusion_planner<std::remove_const_t<TExpr>>)
+        {
+            auto const planned = plan_fusion(expr);
+            run_planned_asign_kernel(res, planned);
+        }
+        else
+            run_planned_asign_kernel(res, expr);
     }
 } // namespace impl_detail
 
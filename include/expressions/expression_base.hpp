@@ -4,8 +4,12 @@
 #include "binary_cwise_expression.hpp"
 #include "evaluator.hpp"
 #include "functors.hpp"
+#include "gather_expression.hpp"
 #include "materialize_expression.hpp"
+#include "scan_expression.hpp"
+#include "shift_expression.hpp"
 #include "unary_cwise_expression.hpp"
+#include "where_expression.hpp"
 
 #include <alpaka/alpaka.hpp>
 
@@ -33,6 +37,8 @@ protected:
 public:
     // every derived should implement
     // auto getHandler() const;
+    // template<typename TVisitor> void visit(TVisitor& visitor) const;
+    // where visit calls the visitor for the expression itself and then for all its operands
 
     TDerived const& derived() const
     {
@@ -90,6 +96,81 @@ public:
         return reduce(op);
     }
 
+    inline Reduction1DExpression<TDerived, MinFunctor<value_type, value_type>> min() const
+    {
+        MinFunctor<value_type, value_type> op;
+        return reduce(op);
+    }
+
+    // Cwise minimum and maximum are members like in Eigen: free min(x, y) would lose against std::min,
+    // which is found by ADL through the template arguments of the alpaka types.
+
+    template<typename TOtherDerived>
+    inline BinaryCwiseExpression<
+        TDerived,
+        TOtherDerived,
+        MinFunctor<value_type, typename expr_traits<TOtherDerived>::value_type>>
+    min(ExpressionBase<TOtherDerived> const& other) const
+    {
+        return {derived(), other.derived(), {}};
+    }
+
+    template<typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+    inline UnaryCwiseExpression<TDerived, ScalarRhsFunctor<MinFunctor<value_type, TScalar>, TScalar, value_type>> min(
+        TScalar const& scalar) const
+    {
+        return {derived(), {scalar}};
+    }
+
+    template<typename TOtherDerived>
+    inline BinaryCwiseExpression<
+        TDerived,
+        TOtherDerived,
+        MaxFunctor<value_type, typename expr_traits<TOtherDerived>::value_type>>
+    max(ExpressionBase<TOtherDerived> const& other) const
+    {
+        return {derived(), other.derived(), {}};
+    }
+
+    template<typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+    inline UnaryCwiseExpression<TDerived, ScalarRhsFunctor<MaxFunctor<value_type, TScalar>, TScalar, value_type>> max(
+        TScalar const& scalar) const
+    {
+        return {derived(), {scalar}};
+    }
+
+    //! Number of elements which are true, for masks.
+    inline Reduction1DExpression<
+        UnaryCwiseExpression<TDerived, CastFunctor<idx_type, value_type>>,
+        AddFunctor<idx_type, idx_type>>
+    count() const
+    {
+        AddFunctor<idx_type, idx_type> op;
+        return apply(CastFunctor<idx_type, value_type>{}).reduce(op);
+    }
+
+    //! y_i = x_0 op x_1 op ... op x_i
+    template<typename Functor>
+    inline ScanExpression<TDerived, Functor> inclusive_scan(Functor const& op) const
+    {
+        return {derived(), op};
+    }
+
+    //! y_0 = init, y_i = init op x_0 op ... op x_(i-1)
+    template<typename Functor>
+    inline ScanExpression<TDerived, Functor> exclusive_scan(
+        Functor const& op,
+        typename Functor::return_type const& init) const
+    {
+        return {derived(), op, true, init};
+    }
+
+    inline ScanExpression<TDerived, AddFunctor<value_type, value_type>> cumsum() const
+    {
+        AddFunctor<value_type, value_type> op;
+        return inclusive_scan(op);
+    }
+
     inline UnaryCwiseExpression<TDerived, NegationFunctor<value_type>> operator-() const
     {
         return {derived(), NegationFunctor<value_type>{}};
@@ -105,6 +186,12 @@ public:
         return {derived(), SinFunctor<value_type>{}};
     }
 
+    //! Sine and cosine of every element as a SinCos pair, evaluated with one sincos call.
+    inline UnaryCwiseExpression<TDerived, SinCosFunctor<value_type>> sincos() const
+    {
+        return {derived(), SinCosFunctor<value_type>{}};
+    }
+
     inline UnaryCwiseExpression<TDerived, AbsFunctor<value_type>> abs() const
     {
         return {derived(), AbsFunctor<value_type>{}};
@@ -210,9 +297,246 @@ inline UnaryCwiseExpression<TDerived, SinFunctor<typename expr_traits<TDerived>:
     return expr.sin();
 }
 
+template<typename TDerived>
+inline UnaryCwiseExpression<TDerived, SinCosFunctor<typename expr_traits<TDerived>::value_type>> sincos(
+    ExpressionBase<TDerived> const& expr)
+{
+    return expr.sincos();
+}
+
 template<typename TDerived>
 inline UnaryCwiseExpression<TDerived, AbsFunctor<typename expr_traits<TDerived>::value_type>> abs(
     ExpressionBase<TDerived> const& expr)
 {
     return expr.abs();
 }
+
+// Comparisons, logical operators and where()
+
+template<template<typename, typename> class TFunctor, typename TDerived, typename TOtherDerived>
+using cwise_binary_expression_t = BinaryCwiseExpression<
+    TDerived,
+    TOtherDerived,
+    TFunctor<typename expr_traits<TDerived>::value_type, typename expr_traits<TOtherDerived>::value_type>>;
+
+template<template<typename, typename> class TFunctor, typename TDerived, typename TScalar>
+using cwise_scalar_rhs_expression_t = UnaryCwiseExpression<
+    TDerived,
+    ScalarRhsFunctor<
+        TFunctor<typename expr_traits<TDerived>::value_type, TScalar>,
+        TScalar,
+        typename expr_traits<TDerived>::value_type>>;
+
+template<template<typename, typename> class TFunctor, typename TDerived, typename TScalar>
+using cwise_scalar_lhs_expression_t = UnaryCwiseExpression<
+    TDerived,
+    ScalarLhsFunctor<
+        TFunctor<TScalar, typename expr_traits<TDerived>::value_type>,
+        TScalar,
+        typename expr_traits<TDerived>::value_type>>;
+
+template<typename TDerived, typename TOtherDerived>
+inline cwise_binary_expression_t<LessFunctor, TDerived, TOtherDerived> operator<(
+    ExpressionBase<TDerived> const& lhs,
+    ExpressionBase<TOtherDerived> const& rhs)
+{
+    return {lhs.derived(), rhs.derived(), {}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_rhs_expression_t<LessFunctor, TDerived, TScalar> operator<(
+    ExpressionBase<TDerived> const& expr,
+    TScalar const& scalar)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_lhs_expression_t<LessFunctor, TDerived, TScalar> operator<(
+    TScalar const& scalar,
+    ExpressionBase<TDerived> const& expr)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TOtherDerived>
+inline cwise_binary_expression_t<LessEqualFunctor, TDerived, TOtherDerived> operator<=(
+    ExpressionBase<TDerived> const& lhs,
+    ExpressionBase<TOtherDerived> const& rhs)
+{
+    return {lhs.derived(), rhs.derived(), {}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_rhs_expression_t<LessEqualFunctor, TDerived, TScalar> operator<=(
+    ExpressionBase<TDerived> const& expr,
+    TScalar const& scalar)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_lhs_expression_t<LessEqualFunctor, TDerived, TScalar> operator<=(
+    TScalar const& scalar,
+    ExpressionBase<TDerived> const& expr)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TOtherDerived>
+inline cwise_binary_expression_t<GreaterFunctor, TDerived, TOtherDerived> operator>(
+    ExpressionBase<TDerived> const& lhs,
+    ExpressionBase<TOtherDerived> const& rhs)
+{
+    return {lhs.derived(), rhs.derived(), {}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_rhs_expression_t<GreaterFunctor, TDerived, TScalar> operator>(
+    ExpressionBase<TDerived> const& expr,
+    TScalar const& scalar)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_lhs_expression_t<GreaterFunctor, TDerived, TScalar> operator>(
+    TScalar const& scalar,
+    ExpressionBase<TDerived> const& expr)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TOtherDerived>
+inline cwise_binary_expression_t<GreaterEqualFunctor, TDerived, TOtherDerived> operator>=(
+    ExpressionBase<TDerived> const& lhs,
+    ExpressionBase<TOtherDerived> const& rhs)
+{
+    return {lhs.derived(), rhs.derived(), {}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_rhs_expression_t<GreaterEqualFunctor, TDerived, TScalar> operator>=(
+    ExpressionBase<TDerived> const& expr,
+    TScalar const& scalar)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_lhs_expression_t<GreaterEqualFunctor, TDerived, TScalar> operator>=(
+    TScalar const& scalar,
+    ExpressionBase<TDerived> const& expr)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TOtherDerived>
+inline cwise_binary_expression_t<EqualFunctor, TDerived, TOtherDerived> operator==(
+    ExpressionBase<TDerived> const& lhs,
+    ExpressionBase<TOtherDerived> const& rhs)
+{
+    return {lhs.derived(), rhs.derived(), {}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_rhs_expression_t<EqualFunctor, TDerived, TScalar> operator==(
+    ExpressionBase<TDerived> const& expr,
+    TScalar const& scalar)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_lhs_expression_t<EqualFunctor, TDerived, TScalar> operator==(
+    TScalar const& scalar,
+    ExpressionBase<TDerived> const& expr)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TOtherDerived>
+inline cwise_binary_expression_t<NotEqualFunctor, TDerived, TOtherDerived> operator!=(
+    ExpressionBase<TDerived> const& lhs,
+    ExpressionBase<TOtherDerived> const& rhs)
+{
+    return {lhs.derived(), rhs.derived(), {}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_rhs_expression_t<NotEqualFunctor, TDerived, TScalar> operator!=(
+    ExpressionBase<TDerived> const& expr,
+    TScalar const& scalar)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline cwise_scalar_lhs_expression_t<NotEqualFunctor, TDerived, TScalar> operator!=(
+    TScalar const& scalar,
+    ExpressionBase<TDerived> const& expr)
+{
+    return {expr.derived(), {scalar}};
+}
+
+template<typename TDerived, typename TOtherDerived>
+inline cwise_binary_expression_t<LogicalAndFunctor, TDerived, TOtherDerived> operator&&(
+    ExpressionBase<TDerived> const& lhs,
+    ExpressionBase<TOtherDerived> const& rhs)
+{
+    return {lhs.derived(), rhs.derived(), {}};
+}
+
+template<typename TDerived, typename TOtherDerived>
+inline cwise_binary_expression_t<LogicalOrFunctor, TDerived, TOtherDerived> operator||(
+    ExpressionBase<TDerived> const& lhs,
+    ExpressionBase<TOtherDerived> const& rhs)
+{
+    return {lhs.derived(), rhs.derived(), {}};
+}
+
+template<typename TDerived>
+inline UnaryCwiseExpression<TDerived, LogicalNotFunctor<typename expr_traits<TDerived>::value_type>> operator!(
+    ExpressionBase<TDerived> const& expr)
+{
+    return {expr.derived(), {}};
+}
+
+//! x.max(lo).min(hi)
+template<typename TDerived, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline auto clamp(ExpressionBase<TDerived> const& expr, TScalar const& lo, TScalar const& hi)
+{
+    return expr.max(lo).min(hi);
+}
+
+//! y_i = mask_i ? a_i : b_i, see WhereExpression.
+template<typename TMask, typename TTrue, typename TFalse>
+inline WhereExpression<TMask, TTrue, TFalse> where(
+    ExpressionBase<TMask> const& mask,
+    ExpressionBase<TTrue> const& onTrue,
+    ExpressionBase<TFalse> const& onFalse)
+{
+    return {mask.derived(), onTrue.derived(), onFalse.derived()};
+}
+
+//! y_i = mask_i ? a_i : scalar, e.g. where(x > 0, x, 0).sum() is a masked reduction.
+template<typename TMask, typename TTrue, typename TScalar, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline BinaryCwiseExpression<
+    TTrue,
+    TMask,
+    SelectOrScalarFunctor<typename expr_traits<TTrue>::value_type, typename expr_traits<TMask>::value_type, TScalar>>
+where(ExpressionBase<TMask> const& mask, ExpressionBase<TTrue> const& onTrue, TScalar const& scalar)
+{
+    return {onTrue.derived(), mask.derived(), {scalar}};
+}
+
+//! y_i = mask_i ? scalar : b_i
+template<typename TMask, typename TScalar, typename TFalse, typename = std::enable_if_t<std::is_arithmetic_v<TScalar>>>
+inline BinaryCwiseExpression<
+    TFalse,
+    TMask,
+    ScalarOrSelectFunctor<typename expr_traits<TFalse>::value_type, typename expr_traits<TMask>::value_type, TScalar>>
+where(ExpressionBase<TMask> const& mask, TScalar const& scalar, ExpressionBase<TFalse> const& onFalse)
+{
+    return {onFalse.derived(), mask.derived(), {scalar}};
+}
@@ -1,3 +1,13 @@
 #pragma once
 
-#include "vector.hpp"
\ No newline at end of file
+#include "bit_mask.hpp"
+#include "deferred.hpp"
+#include "fixed_vector.hpp"
+#include "generator_expression.hpp"
+#include "indexed_expression.hpp"
+#include "random_expression.hpp"
+#include "scatter.hpp"
+#include "segmented_reduction.hpp"
+#include "state_bundle.hpp"
+#include "temporal_blocking.hpp"
+#include "vector.hpp"
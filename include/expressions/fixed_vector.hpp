@@ -0,0 +1,232 @@
+#pragma once
+
+#include "1d_reduction.hpp"
+#include "expression_base.hpp"
+#include "flat_handler.hpp"
+#include "fusion_planner.hpp"
+#include "memoization.hpp"
+#include "state_bundle.hpp"
+#include "tiling.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Threads per block of the kernels which evaluate FixedVectors on GPUs, one system per thread
+#ifndef EXPR_FIXED_BLOCK_THREADS
+#    define EXPR_FIXED_BLOCK_THREADS 128u
+#endif
+
+namespace impl_detail
+{
+    //! Writes all N elements of system b, element k is at k * batch + b. All elements are evaluated before
+    //! the first one is stored, so an expression may read other elements of the destination, e.g. a swap.
+    template<typename TElem, typename THandler, typename TIdx, std::size_t... Ks>
+    ALPAKA_FN_ACC void assign_fixed_system(
+        TElem* const res,
+        THandler const& expr,
+        TIdx batch,
+        TIdx b,
+        std::index_sequence<Ks...>)
+    {
+        TElem const values[] = {static_cast<TElem>(expr.getValue(static_cast<TIdx>(Ks) * batch + b))...};
+        ((res[static_cast<TIdx>(Ks) * batch + b] = values[Ks]), ...);
+    }
+
+    //! Every thread evaluates whole systems of N elements with a fully unrolled loop.
+    template<std::size_t N>
+    class FixedAssignKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TElem, typename TAccExprHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(TAcc const& acc, TElem* const res, TAccExprHandler expr, TIdx const& batch) const
+            -> void
+        {
+            static_assert(alpaka::Dim<TAcc>::value == 1, "The FixedAssignKernel expects 1-dimensional indices!");
+
+            TIdx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const numThreads(alpaka::getWorkDiv<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+
+            for(TIdx b = gridThreadIdx; b < batch; b += numThreads)
+                assign_fixed_system(res, expr, batch, b, std::make_index_sequence<N>{});
+        }
+    };
+
+    //! Like FixedAssignKernel, but with one expression per element.
+    class FixedComponentAssignKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TElem, typename THandlers, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(TAcc const& acc, TElem* const res, THandlers handlers, TIdx const& batch) const
+            -> void
+        {
+            static_assert(
+                alpaka::Dim<TAcc>::value == 1,
+                "The FixedComponentAssignKernel expects 1-dimensional indices!");
+
+            TIdx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const numThreads(alpaka::getWorkDiv<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+
+            for(TIdx b = gridThreadIdx; b < batch; b += numThreads)
+                handlers.assign(res, batch, b);
+        }
+    };
+
+    //! One thread per system without asking alpaka: blocks of EXPR_FIXED_BLOCK_THREADS threads on GPUs,
+    //! one worker per core on CPUs, split into blocks or threads like the workers of a CPU reduction.
+    template<typename TAcc, typename TQueue, typename TIdx>
+    alpaka::WorkDivMembers<alpaka::Dim<TAcc>, TIdx> fixed_work_div(TQueue& queue, TIdx batch)
+    {
+        if constexpr(std::is_same_v<alpaka::Dev<TAcc>, alpaka::DevCpu>)
+        {
+            auto const cores = cpu_reduction_workers<TAcc, TIdx>(alpaka::getDev(queue));
+            return cpu_work_div<TAcc>((batch < cores) ? batch : cores);
+        }
+        else
+        {
+            auto const threads = static_cast<TIdx>(EXPR_FIXED_BLOCK_THREADS);
+            return {(batch + threads - 1) / threads, threads, static_cast<TIdx>(1)};
+        }
+    }
+} // namespace impl_detail
+
+//! Batch of independent systems with N elements each, where N is known at compile time, e.g. millions
+//! of harmonic oscillators. Like a StateBundle with N components, element k of system b is stored at
+//! k * batch + b, so neighbouring threads access neighbouring addresses. For odeint and in expressions
+//! it is one Vector of size N * batch. Assignments are evaluated with one system per thread, the loop
+//! over the elements is unrolled and the work division doesn't depend on the extent:
+//!
+//!     dxdt.assign(x.element(1), -x.element(0) - 0.15 * x.element(1));
+template<typename TBuf, typename TQueue, typename TAcc, std::size_t N>
+class FixedVector : public StateBundle<TBuf, TQueue, TAcc, N>
+{
+public:
+    using bundle_type = StateBundle<TBuf, TQueue, TAcc, N>;
+    using vector_type = typename bundle_type::vector_type;
+    using idx_type = typename bundle_type::idx_type;
+    using value_type = typename bundle_type::value_type;
+    using element_type = typename bundle_type::component_type;
+
+    static constexpr std::size_t system_size = N;
+
+public:
+    FixedVector() = default;
+
+    //! A batch of batch systems.
+    FixedVector(TQueue& queue, idx_type batch = 1) : bundle_type(queue, batch)
+    {
+    }
+
+    template<typename TOtherDerived>
+    FixedVector& operator=(ExpressionBase<TOtherDerived> const& other)
+    {
+        return evaluator<FixedVector, TOtherDerived>::assign(*this, other.derived());
+    }
+
+    //! Number of systems.
+    idx_type batch() const
+    {
+        return this->componentSize();
+    }
+
+    //! Element k of all systems.
+    element_type element(std::size_t k) const
+    {
+        return this->component(k);
+    }
+
+    //! Evaluates the expressions of all N elements in one kernel, every thread computes whole systems.
+    template<typename... TDerived>
+    FixedVector& assign(ExpressionBase<TDerived> const&... exprs)
+    {
+        static_assert(sizeof...(TDerived) == N, "An expression is needed for every element");
+
+        idx_type const batch = this->batch();
+        if(((exprs.getExtent()[0] != batch) || ...))
+            throw std::invalid_argument("Extents of arguments are mismatched");
+
+        auto queue = this->getQueue();
+        impl_detail::EvaluationScope evaluation;
+        auto handlers = impl_detail::make_component_handlers(impl_detail::make_kernel_handler(exprs.derived())...);
+        {
+            impl_detail::TilingScope suspend_tiling;
+            handlers.prepare();
+        }
+
+        if(batch > 0)
+        {
+            impl_detail::FixedComponentAssignKernel kernel;
+            alpaka::enqueue(
+                queue,
+                alpaka::createTaskKernel<TAcc>(
+                    impl_detail::fixed_work_div<TAcc>(queue, batch),
+                    kernel,
+                    this->getPtr(),
+                    handlers,
+                    batch));
+        }
+        this->markModified();
+
+        impl_detail::finish_evaluation(queue);
+        return *this;
+    }
+};
+
+namespace impl_detail
+{
+    template<typename TBuf, typename TQueue, typename TAcc, std::size_t N, typename TExpr>
+    void run_fixed_assign_kernel(FixedVector<TBuf, TQueue, TAcc, N>& res, TExpr const& expr)
+    {
+        using idx_type = alpaka::Idx<TBuf>;
+
+        auto queue = res.getQueue();
+        idx_type const batch = res.batch();
+        EvaluationScope evaluation;
+
+        auto handler = make_kernel_handler(expr);
+        {
+            TilingScope suspend_tiling;
+            handler.prepare();
+        }
+
+        if(batch > 0)
+        {
+            FixedAssignKernel<N> kernel;
+            auto const workDiv = fixed_work_div<TAcc>(queue, batch);
+            alpaka::enqueue(queue, alpaka::createTaskKernel<TAcc>(workDiv, kernel, res.getPtr(), handler, batch));
+        }
+        res.markModified();
+
+        impl_detail::finish_evaluation(queue);
+    }
+} // namespace impl_detail
+
+template<typename TBuf, typename TQueue, typename TAcc, std::size_t N, typename TOtherDerived, bool isLazyEvaluatable>
+struct evaluator<FixedVector<TBuf, TQueue, TAcc, N>, TOtherDerived, isLazyEvaluatable>
+{
+    static FixedVector<TBuf, TQueue, TAcc, N>& assign(
+        FixedVector<TBuf, TQueue, TAcc, N>& dest,
+        TOtherDerived const& src)
+    {
+        auto const extent = src.getExtent()[0];
+        if(extent % static_cast<decltype(extent)>(N) != 0)
+            throw std::invalid_argument("The extent is not a multiple of the size of the systems");
+
+        auto queue = src.getQueue();
+        dest.adjust_size(extent, queue);
+
+        if constexpr(impl_detail::use_fusion_planner<TOtherDerived>)
+        {
+            auto const planned = impl_detail::plan_fusion(src);
+            impl_detail::run_fixed_assign_kernel(dest, planned);
+        }
+        else
+            impl_detail::run_fixed_assign_kernel(dest, src);
+        return dest;
+    }
+};
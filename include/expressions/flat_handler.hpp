@@ -0,0 +1,417 @@
+#pragma once
+
+#include "tiling.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Trees with at least this many cwise nodes are evaluated by a flat program instead of recursive handlers
+#ifndef EXPR_FLATTEN_MIN_NODES
+#    define EXPR_FLATTEN_MIN_NODES 16u
+#endif
+
+template<typename InnerExpr, typename Functor>
+class UnaryCwiseExpression;
+
+template<typename Lhs, typename Rhs, typename Functor>
+class BinaryCwiseExpression;
+
+namespace impl_detail
+{
+    // Flattened evaluation: the handler of a cwise tree is a tree of nested handlers whose getValue calls
+    // recurse down to the leaves. Deep trees (e.g. generated right-hand sides with hundreds of nodes)
+    // depend on the device compiler inlining all of them and pass every intermediate handler to the kernel.
+    // Above EXPR_FLATTEN_MIN_NODES cwise nodes the tree is linearized at compile time into a postorder
+    // program instead: the handlers of the leaves (every node which is not a UnaryCwiseExpression or a
+    // BinaryCwiseExpression) and the functors with state are kept in two flat tuples, the operand
+    // positions are template arguments of the instructions. getValue evaluates the instructions one
+    // after another into a register file, so there is no recursion at all.
+
+    //! Element I of a FlatTuple. Empty default constructible types are not stored when elide is set.
+    template<std::size_t I, typename T, bool elide = false>
+    struct FlatElement
+    {
+        T value;
+
+        FlatElement(T const& v) : value(v)
+        {
+        }
+    };
+
+    template<std::size_t I, typename T>
+    struct FlatElement<I, T, true>
+    {
+        FlatElement(T const&)
+        {
+        }
+    };
+
+    template<std::size_t I, typename T>
+    ALPAKA_FN_HOST_ACC auto flat_get(FlatElement<I, T, false>& element) -> T&
+    {
+        return element.value;
+    }
+
+    template<std::size_t I, typename T>
+    ALPAKA_FN_HOST_ACC auto flat_get(FlatElement<I, T, false> const& element) -> T const&
+    {
+        return element.value;
+    }
+
+    template<std::size_t I, typename T>
+    ALPAKA_FN_HOST_ACC auto flat_get(FlatElement<I, T, true> const&) -> T
+    {
+        return T{};
+    }
+
+    template<typename T>
+    constexpr bool is_elidable_v = std::is_empty_v<T> && std::is_default_constructible_v<T>;
+
+    //! Tuple without recursion: all elements are direct bases, so access is a single cast and the
+    //! instantiation depth doesn't grow with the number of elements.
+    template<bool elideEmpty, typename TSeq, typename... Ts>
+    struct FlatTupleImpl;
+
+    template<bool elideEmpty, std::size_t... Is, typename... Ts>
+    struct FlatTupleImpl<elideEmpty, std::index_sequence<Is...>, Ts...>
+        : FlatElement<Is, Ts, elideEmpty && is_elidable_v<Ts>>...
+    {
+        FlatTupleImpl(std::tuple<Ts...> const& values)
+            : FlatElement<Is, Ts, elideEmpty && is_elidable_v<Ts>>(std::get<Is>(values))...
+        {
+        }
+    };
+
+    template<bool elideEmpty, typename... Ts>
+    using FlatTuple = FlatTupleImpl<elideEmpty, std::index_sequence_for<Ts...>, Ts...>;
+
+    template<std::size_t I, typename T>
+    struct Register
+    {
+        T value{};
+    };
+
+    template<typename TSeq, typename... Ts>
+    struct RegisterFileImpl;
+
+    template<std::size_t... Is, typename... Ts>
+    struct RegisterFileImpl<std::index_sequence<Is...>, Ts...> : Register<Is, Ts>...
+    {
+    };
+
+    template<std::size_t I, typename T>
+    ALPAKA_FN_HOST_ACC auto reg(Register<I, T>& r) -> T&
+    {
+        return r.value;
+    }
+
+    template<std::size_t I, typename T>
+    ALPAKA_FN_HOST_ACC auto reg(Register<I, T> const& r) -> T const&
+    {
+        return r.value;
+    }
+
+    template<typename... Ts>
+    struct type_list
+    {
+    };
+
+    template<typename... TLists>
+    struct concat;
+
+    template<typename... As>
+    struct concat<type_list<As...>>
+    {
+        using type = type_list<As...>;
+    };
+
+    template<typename... As, typename... Bs>
+    struct concat<type_list<As...>, type_list<Bs...>>
+    {
+        using type = type_list<As..., Bs...>;
+    };
+
+    template<typename... As, typename... Bs, typename... Cs>
+    struct concat<type_list<As...>, type_list<Bs...>, type_list<Cs...>>
+    {
+        using type = type_list<As..., Bs..., Cs...>;
+    };
+
+    template<typename... TLists>
+    using concat_t = typename concat<TLists...>::type;
+
+    //! Reads leaf L.
+    template<std::size_t L>
+    struct LeafInstruction
+    {
+        template<typename TProgram, typename TRegisters, typename TIdx>
+        ALPAKA_FN_ACC static auto exec(TProgram const& program, TRegisters const&, TIdx i)
+        {
+            return flat_get<L>(program.leaves_).getValue(i);
+        }
+    };
+
+    //! Applies functor F to register A.
+    template<std::size_t F, std::size_t A>
+    struct UnaryInstruction
+    {
+        template<typename TProgram, typename TRegisters, typename TIdx>
+        ALPAKA_FN_ACC static auto exec(TProgram const& program, TRegisters const& registers, TIdx)
+        {
+            return flat_get<F>(program.functors_)(reg<A>(registers));
+        }
+    };
+
+    //! Applies functor F to the registers A and B.
+    template<std::size_t F, std::size_t A, std::size_t B>
+    struct BinaryInstruction
+    {
+        template<typename TProgram, typename TRegisters, typename TIdx>
+        ALPAKA_FN_ACC static auto exec(TProgram const& program, TRegisters const& registers, TIdx)
+        {
+            return flat_get<F>(program.functors_)(reg<A>(registers), reg<B>(registers));
+        }
+    };
+
+    //! Postorder linearization of a tree whose registers, leaves and functors start at the given offsets.
+    //! Every node computes one register, the result of the tree is in register root.
+    template<typename TExpr, std::size_t regBase, std::size_t leafBase, std::size_t functorBase>
+    struct Linearize
+    {
+        using instructions = type_list<LeafInstruction<leafBase>>;
+        using values = type_list<typename TExpr::value_type>;
+        using leaves = type_list<TExpr>;
+        using functors = type_list<>;
+        static constexpr std::size_t num_registers = 1;
+        static constexpr std::size_t num_leaves = 1;
+        static constexpr std::size_t num_functors = 0;
+        static constexpr std::size_t root = regBase;
+    };
+
+    template<
+        typename InnerExpr,
+        typename Functor,
+        std::size_t regBase,
+        std::size_t leafBase,
+        std::size_t functorBase>
+    struct Linearize<UnaryCwiseExpression<InnerExpr, Functor>, regBase, leafBase, functorBase>
+    {
+        using inner = Linearize<InnerExpr, regBase, leafBase, functorBase>;
+
+        using instructions = concat_t<
+            typename inner::instructions,
+            type_list<UnaryInstruction<functorBase + inner::num_functors, inner::root>>>;
+        using values = concat_t<typename inner::values, type_list<typename Functor::return_type>>;
+        using leaves = typename inner::leaves;
+        using functors = concat_t<typename inner::functors, type_list<Functor>>;
+        static constexpr std::size_t num_registers = inner::num_registers + 1;
+        static constexpr std::size_t num_leaves = inner::num_leaves;
+        static constexpr std::size_t num_functors = inner::num_functors + 1;
+        static constexpr std::size_t root = regBase + num_registers - 1;
+    };
+
+    template<
+        typename Lhs,
+        typename Rhs,
+        typename Functor,
+        std::size_t regBase,
+        std::size_t leafBase,
+        std::size_t functorBase>
+    struct Linearize<BinaryCwiseExpression<Lhs, Rhs, Functor>, regBase, leafBase, functorBase>
+    {
+        using lhs = Linearize<Lhs, regBase, leafBase, functorBase>;
+        using rhs = Linearize<
+            Rhs,
+            regBase + lhs::num_registers,
+            leafBase + lhs::num_leaves,
+            functorBase + lhs::num_functors>;
+
+        using instructions = concat_t<
+            typename lhs::instructions,
+            typename rhs::instructions,
+            type_list<BinaryInstruction<functorBase + lhs::num_functors + rhs::num_functors, lhs::root, rhs::root>>>;
+        using values
+            = concat_t<typename lhs::values, typename rhs::values, type_list<typename Functor::return_type>>;
+        using leaves = concat_t<typename lhs::leaves, typename rhs::leaves>;
+        using functors = concat_t<typename lhs::functors, typename rhs::functors, type_list<Functor>>;
+        static constexpr std::size_t num_registers = lhs::num_registers + rhs::num_registers + 1;
+        static constexpr std::size_t num_leaves = lhs::num_leaves + rhs::num_leaves;
+        static constexpr std::size_t num_functors = lhs::num_functors + rhs::num_functors + 1;
+        static constexpr std::size_t root = regBase + num_registers - 1;
+    };
+
+    //! Handlers of the leaves and the functors of the cwise nodes in postorder, collected on the host.
+    template<typename TExpr>
+    struct FlatCollector
+    {
+        static auto leafHandlers(TExpr const& expr)
+        {
+            return std::make_tuple(expr.getHandler());
+        }
+
+        static auto functors(TExpr const&)
+        {
+            return std::tuple<>{};
+        }
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct FlatCollector<UnaryCwiseExpression<InnerExpr, Functor>>
+    {
+        static auto leafHandlers(UnaryCwiseExpression<InnerExpr, Functor> const& expr)
+        {
+            return FlatCollector<InnerExpr>::leafHandlers(expr.getInner());
+        }
+
+        static auto functors(UnaryCwiseExpression<InnerExpr, Functor> const& expr)
+        {
+            return std::tuple_cat(
+                FlatCollector<InnerExpr>::functors(expr.getInner()),
+                std::make_tuple(expr.getFunctor()));
+        }
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct FlatCollector<BinaryCwiseExpression<Lhs, Rhs, Functor>>
+    {
+        static auto leafHandlers(BinaryCwiseExpression<Lhs, Rhs, Functor> const& expr)
+        {
+            return std::tuple_cat(
+                FlatCollector<Lhs>::leafHandlers(expr.getLhs()),
+                FlatCollector<Rhs>::leafHandlers(expr.getRhs()));
+        }
+
+        static auto functors(BinaryCwiseExpression<Lhs, Rhs, Functor> const& expr)
+        {
+            return std::tuple_cat(
+                FlatCollector<Lhs>::functors(expr.getLhs()),
+                FlatCollector<Rhs>::functors(expr.getRhs()),
+                std::make_tuple(expr.getFunctor()));
+        }
+    };
+
+    template<typename TList>
+    struct flat_program_types;
+
+    template<typename... TLeaves>
+    struct flat_program_types<type_list<TLeaves...>>
+    {
+        using leaf_handlers = FlatTuple<false, typename TLeaves::AccExpressionHandler...>;
+    };
+
+    template<typename TInstructions, typename TValues, typename TFunctors>
+    struct flat_program_layout;
+
+    template<typename... TInstructions, typename... TValues, typename... TFunctors>
+    struct flat_program_layout<type_list<TInstructions...>, type_list<TValues...>, type_list<TFunctors...>>
+    {
+        using instructions = std::tuple<TInstructions...>;
+        using registers = RegisterFileImpl<std::index_sequence_for<TValues...>, TValues...>;
+        using functors = FlatTuple<true, TFunctors...>;
+        static constexpr bool default_constructible_values = (std::is_default_constructible_v<TValues> && ...);
+    };
+
+    //! Handler of a cwise tree evaluated as a flat program, used in place of the handler of the root.
+    template<typename TExpr>
+    struct FlatHandler
+    {
+        using program = Linearize<TExpr, 0, 0, 0>;
+        using layout = flat_program_layout<
+            typename program::instructions,
+            typename program::values,
+            typename program::functors>;
+        using idx_type = typename TExpr::idx_type;
+        using value_type = typename TExpr::value_type;
+
+        typename flat_program_types<typename program::leaves>::leaf_handlers leaves_;
+        typename layout::functors functors_;
+
+        FlatHandler(TExpr const& expr)
+            : leaves_(FlatCollector<TExpr>::leafHandlers(expr))
+            , functors_(FlatCollector<TExpr>::functors(expr))
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            typename layout::registers registers;
+            run(registers, i, std::make_index_sequence<program::num_registers>{});
+            return reg<program::root>(registers);
+        }
+
+        void prepare()
+        {
+            prepareLeaves(std::make_index_sequence<program::num_leaves>{});
+        }
+
+        ALPAKA_FN_ACC void beginTile(idx_type slot, idx_type first, idx_type last)
+        {
+            beginTileLeaves(slot, first, last, std::make_index_sequence<program::num_leaves>{});
+        }
+
+    private:
+        template<std::size_t... Rs>
+        ALPAKA_FN_ACC void run(typename layout::registers& registers, idx_type i, std::index_sequence<Rs...>) const
+        {
+            ((reg<Rs>(registers) = std::tuple_element_t<Rs, typename layout::instructions>::exec(*this, registers, i)),
+             ...);
+        }
+
+        template<std::size_t... Ls>
+        void prepareLeaves(std::index_sequence<Ls...>)
+        {
+            (flat_get<Ls>(leaves_).prepare(), ...);
+        }
+
+        template<std::size_t... Ls>
+        ALPAKA_FN_ACC void beginTileLeaves(idx_type slot, idx_type first, idx_type last, std::index_sequence<Ls...>)
+        {
+            (begin_tile(flat_get<Ls>(leaves_), slot, first, last), ...);
+        }
+    };
+
+    template<typename TExpr>
+    struct num_cwise_nodes
+        : std::integral_constant<
+              std::size_t,
+              Linearize<TExpr, 0, 0, 0>::num_registers - Linearize<TExpr, 0, 0, 0>::num_leaves>
+    {
+    };
+
+    template<typename TExpr, bool = (num_cwise_nodes<TExpr>::value >= EXPR_FLATTEN_MIN_NODES)>
+    struct is_flattened : std::false_type
+    {
+    };
+
+    //! The registers are default constructed before the program runs.
+    template<typename TExpr>
+    struct is_flattened<TExpr, true> : std::bool_constant<FlatHandler<TExpr>::layout::default_constructible_values>
+    {
+    };
+
+    template<typename TExpr>
+    constexpr bool use_flat_handler =
+#ifndef NOT_FLATTEN_EXPR_EVAL
+        is_flattened<TExpr>::value;
+#else
+        false;
+#endif
+
+    //! The handler which is passed to a kernel evaluating expr: the flat program for large cwise trees,
+    //! the handler of the root otherwise.
+    template<typename TExpr>
+    auto make_kernel_handler(TExpr const& expr)
+    {
+        if constexpr(use_flat_handler<TExpr>)
+            return FlatHandler<TExpr>(expr);
+        else
+            return expr.getHandler();
+    }
+
+    template<typename TExpr>
+    using kernel_handler_t = decltype(make_kernel_handler(std::declval<TExpr const&>()));
+} // namespace impl_detail
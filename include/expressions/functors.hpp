@@ -52,7 +52,7 @@ struct MaxFunctor
     using return_type
         = std::remove_cv_t<std::remove_reference_t<decltype(std::max(std::declval<T1>(), std::declval<T2>()))>>;
 
-    static constexpr T1 identity = std::numeric_limits<T1>::min();
+    static constexpr T1 identity = std::numeric_limits<T1>::lowest();
 
     ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
     {
@@ -60,6 +60,209 @@ struct MaxFunctor
     }
 };
 
+template<typename T1, typename T2>
+struct MinFunctor
+{
+    using return_type
+        = std::remove_cv_t<std::remove_reference_t<decltype(std::min(std::declval<T1>(), std::declval<T2>()))>>;
+
+    static constexpr T1 identity = std::numeric_limits<T1>::max();
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        return std::min(a, b);
+    }
+};
+
+// Comparisons yield masks (bool expressions), which select with where() or are combined with &&, || and !.
+
+template<typename T1, typename T2>
+struct LessFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        return a < b;
+    }
+};
+
+template<typename T1, typename T2>
+struct LessEqualFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        return a <= b;
+    }
+};
+
+template<typename T1, typename T2>
+struct GreaterFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        return a > b;
+    }
+};
+
+template<typename T1, typename T2>
+struct GreaterEqualFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        return a >= b;
+    }
+};
+
+template<typename T1, typename T2>
+struct EqualFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        return a == b;
+    }
+};
+
+template<typename T1, typename T2>
+struct NotEqualFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        return a != b;
+    }
+};
+
+template<typename T1, typename T2>
+struct LogicalAndFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        // no short circuit, both operands are evaluated anyway
+        return static_cast<bool>(a) & static_cast<bool>(b);
+    }
+};
+
+template<typename T1, typename T2>
+struct LogicalOrFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(T1 a, T2 b) const -> return_type
+    {
+        return static_cast<bool>(a) | static_cast<bool>(b);
+    }
+};
+
+template<typename TExpr>
+struct LogicalNotFunctor
+{
+    using return_type = bool;
+
+    ALPAKA_FN_ACC auto operator()(TExpr x) const -> return_type
+    {
+        return !static_cast<bool>(x);
+    }
+};
+
+//! Applies a binary functor with a fixed right operand: f(x, scalar), e.g. x < 0.5 or max(x, 0.0).
+template<typename TFunctor, typename TScalar, typename TExpr>
+struct ScalarRhsFunctor
+{
+    using return_type = typename TFunctor::return_type;
+
+    TFunctor functor;
+    TScalar scalar;
+
+    ScalarRhsFunctor(TScalar scalar) : scalar(scalar)
+    {
+    }
+
+    ALPAKA_FN_ACC auto operator()(TExpr x) const -> return_type
+    {
+        return functor(x, scalar);
+    }
+};
+
+//! Applies a binary functor with a fixed left operand: f(scalar, x), e.g. 0.5 < x.
+template<typename TFunctor, typename TScalar, typename TExpr>
+struct ScalarLhsFunctor
+{
+    using return_type = typename TFunctor::return_type;
+
+    TFunctor functor;
+    TScalar scalar;
+
+    ScalarLhsFunctor(TScalar scalar) : scalar(scalar)
+    {
+    }
+
+    ALPAKA_FN_ACC auto operator()(TExpr x) const -> return_type
+    {
+        return functor(scalar, x);
+    }
+};
+
+//! where(mask, x, scalar): both values are computed and one of them is selected, so there is no divergent
+//! branch. The value comes first, so the node evaluates to the type of the value operand.
+template<typename TExpr, typename TMask, typename TScalar>
+struct SelectOrScalarFunctor
+{
+    using return_type = std::common_type_t<TExpr, TScalar>;
+
+    TScalar scalar;
+
+    SelectOrScalarFunctor(TScalar scalar) : scalar(scalar)
+    {
+    }
+
+    ALPAKA_FN_ACC auto operator()(TExpr x, TMask mask) const -> return_type
+    {
+        return static_cast<bool>(mask) ? static_cast<return_type>(x) : static_cast<return_type>(scalar);
+    }
+};
+
+//! where(mask, scalar, x)
+template<typename TExpr, typename TMask, typename TScalar>
+struct ScalarOrSelectFunctor
+{
+    using return_type = std::common_type_t<TExpr, TScalar>;
+
+    TScalar scalar;
+
+    ScalarOrSelectFunctor(TScalar scalar) : scalar(scalar)
+    {
+    }
+
+    ALPAKA_FN_ACC auto operator()(TExpr x, TMask mask) const -> return_type
+    {
+        return static_cast<bool>(mask) ? static_cast<return_type>(scalar) : static_cast<return_type>(x);
+    }
+};
+
+//! Converts the elements, e.g. masks to counts.
+template<typename TTo, typename TExpr>
+struct CastFunctor
+{
+    using return_type = TTo;
+
+    ALPAKA_FN_ACC auto operator()(TExpr x) const -> return_type
+    {
+        return static_cast<TTo>(x);
+    }
+};
+
 template<typename TScalar, typename TExpr>
 struct ScaleFunctor
 {
@@ -80,7 +283,7 @@ struct ScaleFunctor
 template<typename TExpr>
 struct NegationFunctor
 {
-    using return_type = decltype(std::declval<TExpr>());
+    using return_type = decltype(-std::declval<TExpr>());
 
     ALPAKA_FN_ACC auto operator()(TExpr x) const -> return_type
     {
@@ -146,6 +349,69 @@ struct SinFunctor
     }
 };
 
+//! Sine and cosine of the same argument. Sums of it are reduced component wise, so the mean field of an
+//! ensemble is computed in one pass: x.sincos().sum().
+template<typename T>
+struct SinCos
+{
+    T sin;
+    T cos;
+
+    //! Both components are set to the value, e.g. the identity 0 of a summation.
+    ALPAKA_FN_HOST_ACC constexpr SinCos(T value = 0) : sin(value), cos(value)
+    {
+    }
+
+    ALPAKA_FN_HOST_ACC constexpr SinCos(T sin, T cos) : sin(sin), cos(cos)
+    {
+    }
+
+    ALPAKA_FN_HOST_ACC constexpr auto operator+(SinCos const& other) const -> SinCos
+    {
+        return {sin + other.sin, cos + other.cos};
+    }
+};
+
+//! Evaluates sine and cosine of the argument once. Both are computed from the same value within one
+//! function, which compilers lower to a single sincos call (glibc's sincos, CUDA's sincos/sincosf).
+template<typename TExpr>
+struct SinCosFunctor
+{
+    using value_type = decltype(std::sin(std::declval<TExpr>()));
+    using return_type = SinCos<value_type>;
+
+    ALPAKA_FN_ACC auto operator()(TExpr x) const -> return_type
+    {
+        using std::cos;
+        using std::sin;
+        return {sin(x), cos(x)};
+    }
+};
+
+//! Sine of a SinCos pair, the fusion planner reads sin(x) from a pair when cos(x) is needed as well.
+template<typename TExpr>
+struct SinComponentFunctor
+{
+    using return_type = decltype(std::declval<TExpr>().sin);
+
+    ALPAKA_FN_ACC auto operator()(TExpr x) const -> return_type
+    {
+        return x.sin;
+    }
+};
+
+//! Cosine of a SinCos pair.
+template<typename TExpr>
+struct CosComponentFunctor
+{
+    using return_type = decltype(std::declval<TExpr>().cos);
+
+    ALPAKA_FN_ACC auto operator()(TExpr x) const -> return_type
+    {
+        return x.cos;
+    }
+};
+
 template<typename TExpr>
 struct AbsFunctor
 {
@@ -0,0 +1,823 @@
+#pragma once
+
+#include "functors.hpp"
+#include "memoization.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Cost of a transcendental function (sin, cos, ...) in simple arithmetic operations
+#ifndef EXPR_COST_TRANSCENDENTAL
+#    define EXPR_COST_TRANSCENDENTAL 20u
+#endif
+
+// Cost of loading or storing one element of global memory in simple arithmetic operations
+#ifndef EXPR_COST_MEMORY
+#    define EXPR_COST_MEMORY 4u
+#endif
+
+// 32 bit registers a fused kernel may need per element before a sub-tree is evaluated by its own kernel
+#ifndef EXPR_PLAN_MAX_REGISTERS
+#    define EXPR_PLAN_MAX_REGISTERS 64u
+#endif
+
+template<typename TDerived>
+struct expr_traits;
+
+template<typename InnerExpr, typename Functor>
+class UnaryCwiseExpression;
+
+template<typename Lhs, typename Rhs, typename Functor>
+class BinaryCwiseExpression;
+
+template<typename InnerExpr>
+class MaterializeExpression;
+
+template<typename InnerExpr, int shift>
+class ShiftExpression;
+
+template<typename InnerExpr, typename Op>
+class Reduction1DExpression;
+
+template<typename Mask, typename TrueExpr, typename FalseExpr>
+class WhereExpression;
+
+template<typename TQueue, typename TAcc, typename TDistribution>
+class RandomExpression;
+
+template<typename TQueue, typename TAcc, typename TGenerator>
+class GeneratorExpression;
+
+namespace impl_detail
+{
+    template<typename TContainer, typename T>
+    struct rebind_elem;
+
+    // Fusion planning: a lazy sub-tree below a ShiftExpression is recomputed for every shift which reads
+    // it, e.g. sin(x) is evaluated three times per element in sin(x).shift<-1>() - 2 * sin(x) + ...
+    // The compile time cost model below estimates the work of every node per element. Before a tree
+    // is assigned, the planner rewrites it bottom up:
+    // - a cwise sub-tree which is read by several shifts is materialized when recomputing it costs more
+    //   than storing it once and loading it for every shift; equal sub-trees share the materialization.
+    //   The type of the node is chosen from the shifts of sub-trees of the same type, the decision from
+    //   the shifts of equal sub-trees: a shifted sin(y) next to sin(x) is read once and stays fused,
+    // - sin and cos of equal operands, e.g. in a * cos(x) - b * sin(x), are evaluated with one sincos
+    //   call into a temporary of SinCos pairs which both nodes read, when that is cheaper than calling
+    //   both functions. Like shifts, the type of the nodes is chosen from the sin and cos nodes of
+    //   operands of the same type and the decision from the identity keys of the operands,
+    // - the operand of a binary node is evaluated by its own kernel when the fused kernel would need
+    //   more than EXPR_PLAN_MAX_REGISTERS registers.
+    // Sub-trees which are already materialized are planned when they are evaluated themselves.
+
+    template<typename T>
+    constexpr std::size_t register_words_v = (sizeof(T) + 3) / 4;
+
+    //! Work of a functor per call.
+    template<typename TFunctor>
+    struct functor_cost
+    {
+        static constexpr std::size_t flops = 1;
+        static constexpr std::size_t transcendentals = 0;
+    };
+
+    template<typename TFunctor, typename TScalar, typename TExpr>
+    struct functor_cost<ScalarRhsFunctor<TFunctor, TScalar, TExpr>> : functor_cost<TFunctor>
+    {
+    };
+
+    template<typename TFunctor, typename TScalar, typename TExpr>
+    struct functor_cost<ScalarLhsFunctor<TFunctor, TScalar, TExpr>> : functor_cost<TFunctor>
+    {
+    };
+
+    template<typename TTo, typename TExpr>
+    struct functor_cost<CastFunctor<TTo, TExpr>>
+    {
+        static constexpr std::size_t flops = 0;
+        static constexpr std::size_t transcendentals = 0;
+    };
+
+    template<typename TExpr>
+    struct transcendental_functor_cost
+    {
+        static constexpr std::size_t flops = 0;
+        static constexpr std::size_t transcendentals = 1;
+    };
+
+    template<typename TExpr>
+    struct functor_cost<SinFunctor<TExpr>> : transcendental_functor_cost<TExpr>
+    {
+    };
+
+    template<typename TExpr>
+    struct functor_cost<CosFunctor<TExpr>> : transcendental_functor_cost<TExpr>
+    {
+    };
+
+    template<typename TExpr>
+    struct functor_cost<SinCosFunctor<TExpr>> : transcendental_functor_cost<TExpr>
+    {
+    };
+
+    //! Reads a component of a SinCos pair which is already in registers.
+    template<typename TExpr>
+    struct component_functor_cost
+    {
+        static constexpr std::size_t flops = 0;
+        static constexpr std::size_t transcendentals = 0;
+    };
+
+    template<typename TExpr>
+    struct functor_cost<SinComponentFunctor<TExpr>> : component_functor_cost<TExpr>
+    {
+    };
+
+    template<typename TExpr>
+    struct functor_cost<CosComponentFunctor<TExpr>> : component_functor_cost<TExpr>
+    {
+    };
+
+    //! Estimated work of a tree per element. Registers are counted in 32 bit words, operands are
+    //! evaluated from left to right, so the result of the left one is live while the right one is computed.
+    template<typename TExpr>
+    struct expr_cost
+    {
+        static constexpr std::size_t nodes = 1;
+        static constexpr std::size_t flops = 0;
+        static constexpr std::size_t transcendentals = 0;
+        static constexpr std::size_t loads = 1;
+        static constexpr std::size_t registers = register_words_v<typename TExpr::value_type>;
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct expr_cost<UnaryCwiseExpression<InnerExpr, Functor>>
+    {
+        using inner = expr_cost<InnerExpr>;
+        static constexpr std::size_t words = register_words_v<typename Functor::return_type>;
+
+        static constexpr std::size_t nodes = inner::nodes + 1;
+        static constexpr std::size_t flops = inner::flops + functor_cost<Functor>::flops;
+        static constexpr std::size_t transcendentals = inner::transcendentals + functor_cost<Functor>::transcendentals;
+        static constexpr std::size_t loads = inner::loads;
+        static constexpr std::size_t registers = inner::registers > words ? inner::registers : words;
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct expr_cost<BinaryCwiseExpression<Lhs, Rhs, Functor>>
+    {
+        using lhs = expr_cost<Lhs>;
+        using rhs = expr_cost<Rhs>;
+        static constexpr std::size_t words = register_words_v<typename Functor::return_type>;
+        static constexpr std::size_t held = register_words_v<typename Lhs::value_type> + rhs::registers;
+        static constexpr std::size_t operands = lhs::registers > held ? lhs::registers : held;
+
+        static constexpr std::size_t nodes = lhs::nodes + rhs::nodes + 1;
+        static constexpr std::size_t flops = lhs::flops + rhs::flops + functor_cost<Functor>::flops;
+        static constexpr std::size_t transcendentals
+            = lhs::transcendentals + rhs::transcendentals + functor_cost<Functor>::transcendentals;
+        static constexpr std::size_t loads = lhs::loads + rhs::loads;
+        static constexpr std::size_t registers = operands > words ? operands : words;
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr>
+    struct expr_cost<WhereExpression<Mask, TrueExpr, FalseExpr>>
+    {
+        using mask = expr_cost<Mask>;
+        using on_true = expr_cost<TrueExpr>;
+        using on_false = expr_cost<FalseExpr>;
+        // both branches are evaluated before the mask
+        static constexpr std::size_t true_words = register_words_v<typename TrueExpr::value_type>;
+        static constexpr std::size_t false_held = true_words + on_false::registers;
+        static constexpr std::size_t mask_held
+            = true_words + register_words_v<typename FalseExpr::value_type> + mask::registers;
+        static constexpr std::size_t first = on_true::registers > false_held ? on_true::registers : false_held;
+
+        static constexpr std::size_t nodes = mask::nodes + on_true::nodes + on_false::nodes + 1;
+        static constexpr std::size_t flops = mask::flops + on_true::flops + on_false::flops + 1;
+        static constexpr std::size_t transcendentals
+            = mask::transcendentals + on_true::transcendentals + on_false::transcendentals;
+        static constexpr std::size_t loads = mask::loads + on_true::loads + on_false::loads;
+        static constexpr std::size_t registers = first > mask_held ? first : mask_held;
+    };
+
+    //! The index is clamped to the boundary.
+    template<typename InnerExpr, int shift>
+    struct expr_cost<ShiftExpression<InnerExpr, shift>> : expr_cost<InnerExpr>
+    {
+        static constexpr std::size_t nodes = expr_cost<InnerExpr>::nodes + 1;
+        static constexpr std::size_t flops = expr_cost<InnerExpr>::flops + 2;
+    };
+
+    //! The result is computed before the kernel runs and broadcast.
+    template<typename InnerExpr, typename Op>
+    struct expr_cost<Reduction1DExpression<InnerExpr, Op>>
+    {
+        static constexpr std::size_t nodes = 1;
+        static constexpr std::size_t flops = 0;
+        static constexpr std::size_t transcendentals = 0;
+        static constexpr std::size_t loads = 0;
+        static constexpr std::size_t registers = register_words_v<typename Op::return_type>;
+    };
+
+    template<typename TQueue, typename TAcc, typename TGenerator>
+    struct expr_cost<GeneratorExpression<TQueue, TAcc, TGenerator>>
+    {
+        static constexpr std::size_t nodes = 1;
+        static constexpr std::size_t flops = 2;
+        static constexpr std::size_t transcendentals = 0;
+        static constexpr std::size_t loads = 0;
+        static constexpr std::size_t registers
+            = register_words_v<typename GeneratorExpression<TQueue, TAcc, TGenerator>::value_type>;
+    };
+
+    //! Ten Philox rounds and the transformation of the distribution.
+    template<typename TQueue, typename TAcc, typename TDistribution>
+    struct expr_cost<RandomExpression<TQueue, TAcc, TDistribution>>
+    {
+        static constexpr std::size_t nodes = 1;
+        static constexpr std::size_t flops = 60;
+        static constexpr std::size_t transcendentals = 0;
+        static constexpr std::size_t loads = 0;
+        static constexpr std::size_t registers = 8;
+    };
+
+    //! Estimated cost of a tree per element in simple arithmetic operations.
+    template<typename TExpr>
+    constexpr std::size_t expr_cost_v = expr_cost<TExpr>::flops
+                                        + EXPR_COST_TRANSCENDENTAL * expr_cost<TExpr>::transcendentals
+                                        + EXPR_COST_MEMORY * expr_cost<TExpr>::loads;
+
+    //! Sub-trees which the planner may evaluate in a kernel of their own.
+    template<typename TExpr>
+    struct is_plannable_subtree : std::false_type
+    {
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct is_plannable_subtree<UnaryCwiseExpression<InnerExpr, Functor>> : std::true_type
+    {
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct is_plannable_subtree<BinaryCwiseExpression<Lhs, Rhs, Functor>> : std::true_type
+    {
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr>
+    struct is_plannable_subtree<WhereExpression<Mask, TrueExpr, FalseExpr>> : std::true_type
+    {
+    };
+
+    //! Number of ShiftExpressions in the kernel of TExpr which read TInner.
+    template<typename TExpr, typename TInner>
+    struct shift_uses : std::integral_constant<std::size_t, 0>
+    {
+    };
+
+    template<typename InnerExpr, typename Functor, typename TInner>
+    struct shift_uses<UnaryCwiseExpression<InnerExpr, Functor>, TInner> : shift_uses<InnerExpr, TInner>
+    {
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor, typename TInner>
+    struct shift_uses<BinaryCwiseExpression<Lhs, Rhs, Functor>, TInner>
+        : std::integral_constant<std::size_t, shift_uses<Lhs, TInner>::value + shift_uses<Rhs, TInner>::value>
+    {
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr, typename TInner>
+    struct shift_uses<WhereExpression<Mask, TrueExpr, FalseExpr>, TInner>
+        : std::integral_constant<
+              std::size_t,
+              shift_uses<Mask, TInner>::value + shift_uses<TrueExpr, TInner>::value
+                  + shift_uses<FalseExpr, TInner>::value>
+    {
+    };
+
+    template<typename InnerExpr, int shift, typename TInner>
+    struct shift_uses<ShiftExpression<InnerExpr, shift>, TInner>
+        : std::integral_constant<
+              std::size_t,
+              (std::is_same_v<InnerExpr, TInner> ? 1 : 0) + shift_uses<InnerExpr, TInner>::value>
+    {
+    };
+
+    //! Whether a sub-tree read by uses shifts is cheaper to store once and load for every shift.
+    template<typename TInner>
+    constexpr bool worth_materializing(std::size_t uses)
+    {
+        return is_plannable_subtree<TInner>::value && (uses > 1)
+               && (uses * expr_cost_v<TInner> > expr_cost_v<TInner> + EXPR_COST_MEMORY * (uses + 1));
+    }
+
+    //! Whether a sub-tree of type TInner, of which the tree reads uses through shifts, may be materialized.
+    //! Equal sub-trees are read at most as often, so the type is an upper bound of every runtime decision.
+    template<typename TInner, std::size_t uses>
+    constexpr bool materialize_shifted_v = worth_materializing<TInner>(uses);
+
+    //! Number of nodes of type TNode in the kernel of TExpr.
+    template<typename TExpr, typename TNode>
+    struct node_uses : std::integral_constant<std::size_t, std::is_same_v<TExpr, TNode> ? 1 : 0>
+    {
+    };
+
+    template<typename InnerExpr, typename Functor, typename TNode>
+    struct node_uses<UnaryCwiseExpression<InnerExpr, Functor>, TNode>
+        : std::integral_constant<
+              std::size_t,
+              (std::is_same_v<UnaryCwiseExpression<InnerExpr, Functor>, TNode> ? 1 : 0)
+                  + node_uses<InnerExpr, TNode>::value>
+    {
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor, typename TNode>
+    struct node_uses<BinaryCwiseExpression<Lhs, Rhs, Functor>, TNode>
+        : std::integral_constant<std::size_t, node_uses<Lhs, TNode>::value + node_uses<Rhs, TNode>::value>
+    {
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr, typename TNode>
+    struct node_uses<WhereExpression<Mask, TrueExpr, FalseExpr>, TNode>
+        : std::integral_constant<
+              std::size_t,
+              node_uses<Mask, TNode>::value + node_uses<TrueExpr, TNode>::value
+                  + node_uses<FalseExpr, TNode>::value>
+    {
+    };
+
+    template<typename InnerExpr, int shift, typename TNode>
+    struct node_uses<ShiftExpression<InnerExpr, shift>, TNode> : node_uses<InnerExpr, TNode>
+    {
+    };
+
+    //! Whether reads sin and cos nodes of an operand TInner are cheaper as one sincos call per element
+    //! whose pair is stored once and loaded by every node.
+    template<typename TInner>
+    constexpr bool worth_pairing(std::size_t reads)
+    {
+        constexpr std::size_t call = expr_cost_v<TInner> + EXPR_COST_TRANSCENDENTAL;
+        return reads > 1 && reads * call > call + EXPR_COST_MEMORY * (reads + 1);
+    }
+
+    //! Whether the sin and cos nodes of operands of type InnerExpr in the kernel of TRoot may be paired.
+    //! The pairs are stored in a Vector, so the operand has to be evaluated into one.
+    template<typename TRoot, typename InnerExpr>
+    struct sincos_pairing
+    {
+        using value_type = typename InnerExpr::value_type;
+        using eval_type = typename expr_traits<InnerExpr>::eval_ret_type;
+
+        static constexpr std::size_t sines
+            = node_uses<TRoot, UnaryCwiseExpression<InnerExpr, SinFunctor<value_type>>>::value;
+        static constexpr std::size_t cosines
+            = node_uses<TRoot, UnaryCwiseExpression<InnerExpr, CosFunctor<value_type>>>::value;
+
+        static constexpr bool value = sines > 0 && cosines > 0
+                                      && !std::is_same_v<
+                                          typename rebind_elem<eval_type, SinCos<value_type>>::type,
+                                          eval_type>
+                                      && worth_pairing<InnerExpr>(sines + cosines);
+    };
+
+    //! Materializations and decisions of one planning pass.
+    class FusionPlan
+    {
+    private:
+        struct Shared
+        {
+            ExpressionKey key;
+            std::shared_ptr<void> node;
+        };
+
+        struct Uses
+        {
+            ExpressionKey key;
+            std::size_t count;
+        };
+
+        std::vector<Shared> shared_;
+        std::vector<Uses> uses_;
+        std::vector<Uses> sines_;
+        std::vector<Uses> cosines_;
+        std::ostringstream* report_;
+
+    public:
+        explicit FusionPlan(std::ostringstream* report = nullptr) : report_(report)
+        {
+        }
+
+        //! Counts a shift which reads inner.
+        template<typename TInner>
+        void countShift(TInner const& inner)
+        {
+            auto key = make_identity_key(inner);
+            for(auto& uses : uses_)
+            {
+                if(uses.key.isSameTree(key))
+                {
+                    ++uses.count;
+                    return;
+                }
+            }
+            uses_.push_back({std::move(key), 1});
+        }
+
+        //! Counts a sin (or cos) node which reads inner.
+        template<typename TInner>
+        void countTrig(TInner const& inner, bool sine)
+        {
+            auto& counts = sine ? sines_ : cosines_;
+            auto key = make_identity_key(inner);
+            for(auto& uses : counts)
+            {
+                if(uses.key.isSameTree(key))
+                {
+                    ++uses.count;
+                    return;
+                }
+            }
+            counts.push_back({std::move(key), 1});
+        }
+
+        //! Number of sin (or cos) nodes which read inner or an equal sub-tree, zero for an operand without
+        //! identity and for the function which was not counted for inner.
+        template<typename TInner>
+        std::size_t trigUses(TInner const& inner, bool sine) const
+        {
+            auto const key = make_identity_key(inner);
+            for(auto const& uses : sine ? sines_ : cosines_)
+            {
+                if(uses.key.isSameTree(key))
+                    return uses.count;
+            }
+            return 0;
+        }
+
+        //! Number of shifts which read inner or an equal sub-tree, sub-trees without identity are read once.
+        template<typename TInner>
+        std::size_t shiftUses(TInner const& inner) const
+        {
+            auto const key = make_identity_key(inner);
+            for(auto const& uses : uses_)
+            {
+                if(uses.key.isSameTree(key))
+                    return uses.count;
+            }
+            return 1;
+        }
+
+        //! Materialization of inner, shared with an equal sub-tree which was materialized before.
+        template<typename TInner>
+        MaterializeExpression<TInner> materialize(TInner const& inner, bool& reused)
+        {
+            auto key = make_identity_key(inner);
+            for(auto const& shared : shared_)
+            {
+                if(shared.key.isSameTree(key))
+                {
+                    reused = true;
+                    return *std::static_pointer_cast<MaterializeExpression<TInner>>(shared.node);
+                }
+            }
+
+            reused = false;
+            auto node = std::make_shared<MaterializeExpression<TInner>>(inner);
+            shared_.push_back({std::move(key), node});
+            return *node;
+        }
+
+        bool reporting() const
+        {
+            return report_ != nullptr;
+        }
+
+        std::ostream& report()
+        {
+            return *report_;
+        }
+    };
+
+    template<typename TExpr>
+    void report_cost(std::ostream& out)
+    {
+        using cost = expr_cost<TExpr>;
+        out << cost::nodes << " nodes, " << cost::flops << " flops, " << cost::transcendentals << " transcendentals, "
+            << cost::loads << " loads, " << cost::registers << " registers";
+    }
+
+    //! Counts the shifts and the sin and cos nodes in the kernel of TExpr per sub-tree which they read, like
+    //! shift_uses and node_uses per type.
+    template<typename TExpr>
+    struct use_counter
+    {
+        static void count(TExpr const&, FusionPlan&)
+        {
+        }
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct use_counter<UnaryCwiseExpression<InnerExpr, Functor>>
+    {
+        static void count(UnaryCwiseExpression<InnerExpr, Functor> const& expr, FusionPlan& plan)
+        {
+            use_counter<InnerExpr>::count(expr.getInner(), plan);
+        }
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct use_counter<BinaryCwiseExpression<Lhs, Rhs, Functor>>
+    {
+        static void count(BinaryCwiseExpression<Lhs, Rhs, Functor> const& expr, FusionPlan& plan)
+        {
+            use_counter<Lhs>::count(expr.getLhs(), plan);
+            use_counter<Rhs>::count(expr.getRhs(), plan);
+        }
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr>
+    struct use_counter<WhereExpression<Mask, TrueExpr, FalseExpr>>
+    {
+        static void count(WhereExpression<Mask, TrueExpr, FalseExpr> const& expr, FusionPlan& plan)
+        {
+            use_counter<Mask>::count(expr.getMask(), plan);
+            use_counter<TrueExpr>::count(expr.getTrue(), plan);
+            use_counter<FalseExpr>::count(expr.getFalse(), plan);
+        }
+    };
+
+    template<typename InnerExpr, typename T>
+    struct use_counter<UnaryCwiseExpression<InnerExpr, SinFunctor<T>>>
+    {
+        static void count(UnaryCwiseExpression<InnerExpr, SinFunctor<T>> const& expr, FusionPlan& plan)
+        {
+            plan.countTrig(expr.getInner(), true);
+            use_counter<InnerExpr>::count(expr.getInner(), plan);
+        }
+    };
+
+    template<typename InnerExpr, typename T>
+    struct use_counter<UnaryCwiseExpression<InnerExpr, CosFunctor<T>>>
+    {
+        static void count(UnaryCwiseExpression<InnerExpr, CosFunctor<T>> const& expr, FusionPlan& plan)
+        {
+            plan.countTrig(expr.getInner(), false);
+            use_counter<InnerExpr>::count(expr.getInner(), plan);
+        }
+    };
+
+    template<typename InnerExpr, int shift>
+    struct use_counter<ShiftExpression<InnerExpr, shift>>
+    {
+        static void count(ShiftExpression<InnerExpr, shift> const& expr, FusionPlan& plan)
+        {
+            if constexpr(is_plannable_subtree<InnerExpr>::value)
+                plan.countShift(expr.getInner());
+            use_counter<InnerExpr>::count(expr.getInner(), plan);
+        }
+    };
+
+    //! Rewrites TExpr, a node of the kernel of TRoot. Nodes without a specialization are kept as they are.
+    template<typename TRoot, typename TExpr>
+    struct fusion_planner
+    {
+        using type = TExpr;
+
+        static type apply(TExpr const& expr, FusionPlan&)
+        {
+            return expr;
+        }
+    };
+
+    template<typename TRoot, typename TExpr>
+    using planned_t = typename fusion_planner<TRoot, TExpr>::type;
+
+    template<typename TRoot, typename InnerExpr, typename Functor>
+    struct fusion_planner<TRoot, UnaryCwiseExpression<InnerExpr, Functor>>
+    {
+        using type = UnaryCwiseExpression<planned_t<TRoot, InnerExpr>, Functor>;
+
+        static type apply(UnaryCwiseExpression<InnerExpr, Functor> const& expr, FusionPlan& plan)
+        {
+            return {fusion_planner<TRoot, InnerExpr>::apply(expr.getInner(), plan), expr.getFunctor()};
+        }
+    };
+
+    //! sin (or cos) node which reads its component from a SinCos pair shared with the cos (or sin) nodes of
+    //! equal operands.
+    template<typename TRoot, typename InnerExpr, typename Functor, typename TComponent, bool sine>
+    struct sincos_planner
+    {
+        using inner = planned_t<TRoot, InnerExpr>;
+        using value_type = typename InnerExpr::value_type;
+        using pair_expr = UnaryCwiseExpression<inner, SinCosFunctor<value_type>>;
+
+        static constexpr bool pair = sincos_pairing<TRoot, InnerExpr>::value;
+
+        using type = std::conditional_t<
+            pair,
+            UnaryCwiseExpression<MaterializeExpression<pair_expr>, TComponent>,
+            UnaryCwiseExpression<inner, Functor>>;
+
+        static type apply(UnaryCwiseExpression<InnerExpr, Functor> const& expr, FusionPlan& plan)
+        {
+            auto planned_inner = fusion_planner<TRoot, InnerExpr>::apply(expr.getInner(), plan);
+            if constexpr(pair)
+            {
+                std::size_t const sines = plan.trigUses(expr.getInner(), true);
+                std::size_t const cosines = plan.trigUses(expr.getInner(), false);
+                std::size_t const reads = sines + cosines;
+                bool const paired = sines > 0 && cosines > 0 && worth_pairing<inner>(reads);
+                if(plan.reporting())
+                {
+                    plan.report() << (sine ? "sin" : "cos") << ": operand (";
+                    report_cost<inner>(plan.report());
+                    plan.report() << ") read by " << sines << " sin and " << cosines << " cos nodes";
+                }
+
+                pair_expr pairs(planned_inner, SinCosFunctor<value_type>{});
+                if(paired)
+                {
+                    bool reused = false;
+                    auto materialized = plan.materialize(pairs, reused);
+                    if(plan.reporting())
+                        plan.report() << " -> " << (reused ? "reads the shared sincos pair\n" : "sincos pair\n");
+                    return {materialized, TComponent{}};
+                }
+
+                // the other function of the type reads another operand, the pair is computed in the kernel
+                MaterializeExpression<pair_expr> fused(pairs);
+                fused.fuse();
+                if(plan.reporting())
+                    plan.report() << " -> fused\n";
+                return {fused, TComponent{}};
+            }
+            else
+                return {planned_inner, expr.getFunctor()};
+        }
+    };
+
+    template<typename TRoot, typename InnerExpr, typename T>
+    struct fusion_planner<TRoot, UnaryCwiseExpression<InnerExpr, SinFunctor<T>>>
+        : sincos_planner<
+              TRoot,
+              InnerExpr,
+              SinFunctor<T>,
+              SinComponentFunctor<typename SinCosFunctor<typename InnerExpr::value_type>::return_type>,
+              true>
+    {
+    };
+
+    template<typename TRoot, typename InnerExpr, typename T>
+    struct fusion_planner<TRoot, UnaryCwiseExpression<InnerExpr, CosFunctor<T>>>
+        : sincos_planner<
+              TRoot,
+              InnerExpr,
+              CosFunctor<T>,
+              CosComponentFunctor<typename SinCosFunctor<typename InnerExpr::value_type>::return_type>,
+              false>
+    {
+    };
+
+    template<typename TRoot, typename Lhs, typename Rhs, typename Functor>
+    struct fusion_planner<TRoot, BinaryCwiseExpression<Lhs, Rhs, Functor>>
+    {
+        using lhs = planned_t<TRoot, Lhs>;
+        using rhs = planned_t<TRoot, Rhs>;
+        using fused = BinaryCwiseExpression<lhs, rhs, Functor>;
+
+        static constexpr bool split
+            = is_plannable_subtree<rhs>::value && (expr_cost<fused>::registers > EXPR_PLAN_MAX_REGISTERS);
+
+        using type = std::conditional_t<split, BinaryCwiseExpression<lhs, MaterializeExpression<rhs>, Functor>, fused>;
+
+        static type apply(BinaryCwiseExpression<Lhs, Rhs, Functor> const& expr, FusionPlan& plan)
+        {
+            auto planned_lhs = fusion_planner<TRoot, Lhs>::apply(expr.getLhs(), plan);
+            auto planned_rhs = fusion_planner<TRoot, Rhs>::apply(expr.getRhs(), plan);
+            if constexpr(split)
+            {
+                if(plan.reporting())
+                {
+                    plan.report() << "split: the right operand (";
+                    report_cost<rhs>(plan.report());
+                    plan.report() << ") needs " << expr_cost<fused>::registers << " > " << EXPR_PLAN_MAX_REGISTERS
+                                  << " registers together with the left one -> evaluated by its own kernel\n";
+                }
+                return {planned_lhs, MaterializeExpression<rhs>(planned_rhs), expr.getFunctor()};
+            }
+            else
+                return {planned_lhs, planned_rhs, expr.getFunctor()};
+        }
+    };
+
+    template<typename TRoot, typename Mask, typename TrueExpr, typename FalseExpr>
+    struct fusion_planner<TRoot, WhereExpression<Mask, TrueExpr, FalseExpr>>
+    {
+        using type = WhereExpression<planned_t<TRoot, Mask>, planned_t<TRoot, TrueExpr>, planned_t<TRoot, FalseExpr>>;
+
+        static type apply(WhereExpression<Mask, TrueExpr, FalseExpr> const& expr, FusionPlan& plan)
+        {
+            return {
+                fusion_planner<TRoot, Mask>::apply(expr.getMask(), plan),
+                fusion_planner<TRoot, TrueExpr>::apply(expr.getTrue(), plan),
+                fusion_planner<TRoot, FalseExpr>::apply(expr.getFalse(), plan)};
+        }
+    };
+
+    template<typename TRoot, typename InnerExpr, int shift>
+    struct fusion_planner<TRoot, ShiftExpression<InnerExpr, shift>>
+    {
+        using inner = planned_t<TRoot, InnerExpr>;
+
+        static constexpr std::size_t uses = shift_uses<TRoot, InnerExpr>::value;
+        static constexpr bool materialize = materialize_shifted_v<inner, uses>;
+
+        using type = ShiftExpression<std::conditional_t<materialize, MaterializeExpression<inner>, inner>, shift>;
+
+        static type apply(ShiftExpression<InnerExpr, shift> const& expr, FusionPlan& plan)
+        {
+            auto planned_inner = fusion_planner<TRoot, InnerExpr>::apply(expr.getInner(), plan);
+            if constexpr(is_plannable_subtree<inner>::value)
+            {
+                std::size_t const reads = plan.shiftUses(expr.getInner());
+                if(plan.reporting())
+                {
+                    plan.report() << "shift<" << shift << ">: sub-tree (";
+                    report_cost<inner>(plan.report());
+                    plan.report() << ") read by " << reads << " shifts, recomputing costs "
+                                  << reads * expr_cost_v<inner> << ", materializing costs "
+                                  << expr_cost_v<inner> + EXPR_COST_MEMORY * (reads + 1) << " -> ";
+                }
+
+                if constexpr(materialize)
+                {
+                    if(worth_materializing<inner>(reads))
+                    {
+                        bool reused = false;
+                        auto materialized = plan.materialize(planned_inner, reused);
+                        if(plan.reporting())
+                            plan.report()
+                                << (reused ? "materialized, shared with an equal shift\n" : "materialized\n");
+                        return {materialized};
+                    }
+
+                    // the other shifts counted for the type read sub-trees with other operands
+                    MaterializeExpression<inner> fused(planned_inner);
+                    fused.fuse();
+                    if(plan.reporting())
+                        plan.report() << "fused\n";
+                    return {fused};
+                }
+                else
+                {
+                    if(plan.reporting())
+                        plan.report() << "fused\n";
+                    return {planned_inner};
+                }
+            }
+            else
+                return {planned_inner};
+        }
+    };
+
+    //! The tree which is evaluated instead of expr.
+    template<typename TExpr>
+    planned_t<TExpr, TExpr> plan_fusion(TExpr const& expr)
+    {
+        FusionPlan plan;
+        use_counter<TExpr>::count(expr, plan);
+        return fusion_planner<TExpr, TExpr>::apply(expr, plan);
+    }
+
+    template<typename TExpr>
+    constexpr bool use_fusion_planner =
+#ifndef NOT_PLAN_EXPR_EVAL
+        !std::is_same_v<planned_t<TExpr, TExpr>, TExpr>;
+#else
+        false;
+#endif
+} // namespace impl_detail
+
+//! Explains for every shifted sub-tree and every split kernel of expr what the planner decided and why.
+template<typename TExpr>
+std::string fusion_report(TExpr const& expr)
+{
+    std::ostringstream report;
+    report << "tree (";
+    impl_detail::report_cost<TExpr>(report);
+    report << ")\n";
+
+    impl_detail::FusionPlan plan(&report);
+    impl_detail::use_counter<TExpr>::count(expr, plan);
+    impl_detail::fusion_planner<TExpr, TExpr>::apply(expr, plan);
+#ifdef NOT_PLAN_EXPR_EVAL
+    report << "planning is disabled by NOT_PLAN_EXPR_EVAL, the tree is evaluated as it is\n";
+#endif
+    return report.str();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "memoization.hpp"
+#include "tiling.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+template<typename TDerived>
+class ExpressionBase;
+
+template<typename TDerived>
+struct expr_traits;
+
+//! Reads the source expression at the indices given by the index expression: y_i = x[idx_i].
+//! The extent is the one of the index expression, the indices have to be valid indices of the source.
+template<typename Source, typename Indices>
+class GatherExpression : public ExpressionBase<GatherExpression<Source, Indices>>
+{
+public:
+    using acc_type = typename Source::acc_type;
+    using idx_type = typename Source::idx_type;
+    using dim_type = typename Source::dim_type;
+    using queue_type = typename Source::queue_type;
+    using value_type = typename Source::value_type;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+
+public:
+    struct AccExpressionHandler
+    {
+        using source_handler = typename Source::AccExpressionHandler;
+        using indices_handler = typename Indices::AccExpressionHandler;
+
+        source_handler source_;
+        indices_handler indices_;
+
+        AccExpressionHandler(source_handler source, indices_handler indices) : source_{source}, indices_{indices}
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return source_.getValue(static_cast<idx_type>(indices_.getValue(i)));
+        }
+
+        void prepare()
+        {
+            // the source is read at arbitrary indices, so it can't be evaluated tile by tile
+            impl_detail::TilingScope suspend_tiling;
+            source_.prepare();
+            indices_.prepare();
+        }
+    };
+
+private:
+    Source source_;
+    Indices indices_;
+
+public:
+    GatherExpression(Source const& source, Indices const& indices) : source_(source), indices_(indices)
+    {
+        this->queue_ = source.getQueue();
+        this->extent_ = indices.getExtent();
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {source_.getHandler(), indices_.getHandler()};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        source_.visit(visitor);
+        indices_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<GatherExpression>();
+        impl_detail::append_cache_key(source_, key);
+        impl_detail::append_cache_key(indices_, key);
+    }
+};
+
+template<typename Source, typename Indices>
+struct expr_traits<GatherExpression<Source, Indices>>
+{
+    using acc_type = typename expr_traits<Source>::acc_type;
+    using idx_type = typename expr_traits<Source>::idx_type;
+    using dim_type = typename expr_traits<Source>::dim_type;
+    using queue_type = typename expr_traits<Source>::queue_type;
+    using value_type = typename expr_traits<Source>::value_type;
+    using eval_ret_type = typename expr_traits<Source>::eval_ret_type;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
+
+template<typename TSource, typename TIndices>
+inline GatherExpression<TSource, TIndices> gather(
+    ExpressionBase<TSource> const& source,
+    ExpressionBase<TIndices> const& indices)
+{
+    return {source.derived(), indices.derived()};
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "expression_base.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+#include "vector.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <type_traits>
+
+//! y_i = value
+template<typename T>
+struct ConstantGenerator
+{
+    T value;
+
+    template<typename TIdx>
+    ALPAKA_FN_HOST_ACC auto operator()(TIdx) const -> T
+    {
+        return value;
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.append(value);
+    }
+};
+
+//! y_i = start + i * step
+template<typename T>
+struct AffineGenerator
+{
+    T start;
+    T step;
+
+    template<typename TIdx>
+    ALPAKA_FN_HOST_ACC auto operator()(TIdx i) const -> T
+    {
+        return start + static_cast<T>(i) * step;
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.append(start);
+        key.append(step);
+    }
+};
+
+//! n evenly spaced values from a to b, the last one is exactly b.
+template<typename T, typename TIdx>
+struct LinspaceGenerator
+{
+    T a;
+    T b;
+    T step;
+    TIdx last;
+
+    ALPAKA_FN_HOST_ACC auto operator()(TIdx i) const -> T
+    {
+        return (i == last) ? b : a + static_cast<T>(i) * step;
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.append(a);
+        key.append(b);
+        key.append(step);
+        key.append(last);
+    }
+};
+
+namespace impl_detail
+{
+    template<typename TAcc, typename TGenerator>
+    using generated_value_t
+        = std::decay_t<decltype(std::declval<TGenerator const&>()(std::declval<alpaka::Idx<TAcc>>()))>;
+} // namespace impl_detail
+
+//! Leaf whose elements are computed from their index by the generator, so it takes no memory and
+//! needs no host data: constants, ramps and tabulated functions are evaluated inside the kernel
+//! which reads them.
+template<typename TQueue, typename TAcc, typename TGenerator>
+class GeneratorExpression : public ExpressionBase<GeneratorExpression<TQueue, TAcc, TGenerator>>
+{
+public:
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using value_type = impl_detail::generated_value_t<TAcc, TGenerator>;
+
+public:
+    struct AccExpressionHandler
+    {
+        TGenerator generator_;
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return generator_(i);
+        }
+
+        void prepare()
+        {
+        }
+    };
+
+private:
+    TGenerator generator_;
+
+public:
+    GeneratorExpression(TQueue const& queue, idx_type size, TGenerator const& generator) : generator_(generator)
+    {
+        this->queue_ = queue;
+        this->extent_[0] = size;
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {generator_};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<GeneratorExpression>();
+        impl_detail::append_user_functor(generator_, key);
+        key.append(this->extent_[0]);
+    }
+};
+
+template<typename TQueue, typename TAcc, typename TGenerator>
+struct expr_traits<GeneratorExpression<TQueue, TAcc, TGenerator>>
+{
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using value_type = impl_detail::generated_value_t<TAcc, TGenerator>;
+    using eval_ret_type = Vector<alpaka::Buf<TAcc, value_type, dim_type, idx_type>, TQueue, TAcc>;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
+
+//! y_i = f(i), e.g. generate<Acc>(queue, n, [] ALPAKA_FN_ACC(std::size_t i) { return i % 2 ? 1.0 : -1.0; })
+//! Results of trees with a generator which has state are only memoized if it provides
+//! appendCacheKey(impl_detail::ExpressionKey&), see impl_detail::append_user_functor().
+template<typename TAcc, typename TQueue, typename TGenerator>
+inline GeneratorExpression<TQueue, TAcc, TGenerator> generate(
+    TQueue const& queue,
+    alpaka::Idx<TAcc> size,
+    TGenerator const& generator)
+{
+    return {queue, size, generator};
+}
+
+//! y_i = value, with size 1 the constant is broadcast in binary expressions.
+template<typename TAcc, typename TQueue, typename T>
+inline GeneratorExpression<TQueue, TAcc, ConstantGenerator<T>> fill(
+    TQueue const& queue,
+    T const& value,
+    alpaka::Idx<TAcc> size = 1)
+{
+    return {queue, size, ConstantGenerator<T>{value}};
+}
+
+//! y_i = start + i
+template<typename TAcc, typename T = alpaka::Idx<TAcc>, typename TQueue>
+inline GeneratorExpression<TQueue, TAcc, AffineGenerator<T>> iota(
+    TQueue const& queue,
+    alpaka::Idx<TAcc> size,
+    T const& start = T(0))
+{
+    return {queue, size, AffineGenerator<T>{start, T(1)}};
+}
+
+//! size values evenly spaced from a to b (both included), a single value is a
+template<typename TAcc, typename TQueue, typename T>
+inline GeneratorExpression<TQueue, TAcc, LinspaceGenerator<T, alpaka::Idx<TAcc>>> linspace(
+    TQueue const& queue,
+    T const& a,
+    T const& b,
+    alpaka::Idx<TAcc> size)
+{
+    using idx_type = alpaka::Idx<TAcc>;
+    T const step = (size > 1) ? (b - a) / static_cast<T>(size - 1) : T(0);
+    idx_type const last = (size > 0) ? size - 1 : 0;
+    // the generator returns b at the last index, which is also the first one for a single value
+    return {queue, size, LinspaceGenerator<T, idx_type>{a, (size > 1) ? b : a, step, last}};
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "expression_base.hpp"
+#include "flat_handler.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+#include "vector.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace impl_detail
+{
+    //! Read access to an input of an IndexedExpression at arbitrary indices.
+    template<typename THandler, typename TIdx>
+    struct ReadAccessor
+    {
+        THandler const& handler;
+        TIdx n;
+
+        ALPAKA_FN_ACC auto operator[](TIdx j) const
+        {
+            return handler.getValue(j);
+        }
+
+        //! Indices outside of [0, n) are clamped to the boundary elements, like in a ShiftExpression.
+        //! An empty input has no boundary elements, it reads as value initialized elements.
+        ALPAKA_FN_ACC auto at(std::ptrdiff_t j) const
+        {
+            using value_type = std::decay_t<decltype(handler.getValue(TIdx{0}))>;
+            if(n == 0)
+                return value_type{};
+            TIdx const clamped = (j < 0) ? TIdx{0} : (static_cast<TIdx>(j) >= n ? n - 1 : static_cast<TIdx>(j));
+            return static_cast<value_type>(handler.getValue(clamped));
+        }
+
+        ALPAKA_FN_ACC auto size() const -> TIdx
+        {
+            return n;
+        }
+    };
+
+    //! Handlers and sizes of the inputs of an IndexedExpression, stored recursively because kernel
+    //! arguments have to be trivially copyable.
+    template<typename TIdx, typename... THandlers>
+    struct IndexedInputs
+    {
+        void prepare()
+        {
+        }
+
+        template<typename TFunctor, typename... TAccessors>
+        ALPAKA_FN_ACC auto call(TFunctor const& functor, TIdx i, TAccessors const&... accessors) const
+        {
+            return functor(i, accessors...);
+        }
+    };
+
+    template<typename TIdx, typename THead, typename... TTail>
+    struct IndexedInputs<TIdx, THead, TTail...>
+    {
+        THead head;
+        TIdx size;
+        IndexedInputs<TIdx, TTail...> tail;
+
+        void prepare()
+        {
+            head.prepare();
+            tail.prepare();
+        }
+
+        template<typename TFunctor, typename... TAccessors>
+        ALPAKA_FN_ACC auto call(TFunctor const& functor, TIdx i, TAccessors const&... accessors) const
+        {
+            return tail.call(functor, i, accessors..., ReadAccessor<THead, TIdx>{head, size});
+        }
+    };
+
+    template<typename TIdx>
+    IndexedInputs<TIdx> make_indexed_inputs()
+    {
+        return {};
+    }
+
+    template<typename TIdx, typename THead, typename... TTail>
+    auto make_indexed_inputs(THead const& head, TTail const&... tail)
+        -> IndexedInputs<TIdx, kernel_handler_t<THead>, kernel_handler_t<TTail>...>
+    {
+        return {make_kernel_handler(head), head.getExtent()[0], make_indexed_inputs<TIdx>(tail...)};
+    }
+
+    template<typename TFunctor, typename TIdx, typename... TExprs>
+    using indexed_value_t = std::decay_t<decltype(std::declval<TFunctor const&>()(
+        std::declval<TIdx>(),
+        std::declval<ReadAccessor<kernel_handler_t<TExprs>, TIdx> const&>()...))>;
+} // namespace impl_detail
+
+//! Node whose elements are computed by a user callable from the index and read accessors to the inputs,
+//! y_i = f(i, a, b, ...) where a[j] reads the first input at any index j. Local couplings which are not
+//! expressible as cwise operations and shifts can be written as a lambda and still fuse into the
+//! surrounding assignment or reduction, e.g. a chain with open boundaries:
+//!
+//!     dxdt = omega + indexed([] ALPAKA_FN_ACC(std::size_t i, auto x) {
+//!         return (i > 0 ? sin(x[i] - x[i - 1]) : 0.0) + (i + 1 < x.size() ? sin(x[i + 1] - x[i]) : 0.0);
+//!     }, x);
+//!
+//! The extent is the one of the first input. Like generators, functors with state are only memoized if
+//! they provide appendCacheKey(impl_detail::ExpressionKey&).
+template<typename TFunctor, typename TFirst, typename... TRest>
+class IndexedExpression : public ExpressionBase<IndexedExpression<TFunctor, TFirst, TRest...>>
+{
+public:
+    using acc_type = typename TFirst::acc_type;
+    using idx_type = typename TFirst::idx_type;
+    using dim_type = typename TFirst::dim_type;
+    using queue_type = typename TFirst::queue_type;
+    using value_type = impl_detail::indexed_value_t<TFunctor, idx_type, TFirst, TRest...>;
+
+public:
+    struct AccExpressionHandler
+    {
+        using inputs_type = impl_detail::
+            IndexedInputs<idx_type, impl_detail::kernel_handler_t<TFirst>, impl_detail::kernel_handler_t<TRest>...>;
+
+        TFunctor functor_;
+        inputs_type inputs_;
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return inputs_.call(functor_, i);
+        }
+
+        void prepare()
+        {
+            // the inputs are read at arbitrary indices, so they can't be evaluated tile by tile
+            impl_detail::TilingScope suspend_tiling;
+            inputs_.prepare();
+        }
+    };
+
+private:
+    TFunctor functor_;
+    std::tuple<TFirst, TRest...> inputs_;
+
+public:
+    IndexedExpression(TFunctor const& functor, TFirst const& first, TRest const&... rest)
+        : functor_(functor)
+        , inputs_(first, rest...)
+    {
+        this->queue_ = first.getQueue();
+        this->extent_ = first.getExtent();
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {
+            functor_,
+            std::apply(
+                [](auto const&... inputs) { return impl_detail::make_indexed_inputs<idx_type>(inputs...); },
+                inputs_)};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        std::apply([&visitor](auto const&... inputs) { (inputs.visit(visitor), ...); }, inputs_);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<IndexedExpression>();
+        impl_detail::append_user_functor(functor_, key);
+        std::apply([&key](auto const&... inputs) { (impl_detail::append_cache_key(inputs, key), ...); }, inputs_);
+    }
+};
+
+template<typename TFunctor, typename TFirst, typename... TRest>
+struct expr_traits<IndexedExpression<TFunctor, TFirst, TRest...>>
+{
+    using acc_type = typename expr_traits<TFirst>::acc_type;
+    using idx_type = typename expr_traits<TFirst>::idx_type;
+    using dim_type = typename expr_traits<TFirst>::dim_type;
+    using queue_type = typename expr_traits<TFirst>::queue_type;
+    using value_type = impl_detail::indexed_value_t<TFunctor, idx_type, TFirst, TRest...>;
+    using eval_ret_type = Vector<alpaka::Buf<acc_type, value_type, dim_type, idx_type>, queue_type, acc_type>;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable
+        = expr_traits<TFirst>::is_lazy_evaluatable && (expr_traits<TRest>::is_lazy_evaluatable && ...);
+};
+
+//! y_i = f(i, inputs...), the callable receives the index and a read accessor for every input.
+template<typename TFunctor, typename TFirst, typename... TRest>
+inline IndexedExpression<TFunctor, TFirst, TRest...> indexed(
+    TFunctor const& functor,
+    ExpressionBase<TFirst> const& first,
+    ExpressionBase<TRest> const&... rest)
+{
+    return {functor, first.derived(), rest.derived()...};
+}
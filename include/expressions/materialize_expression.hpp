@@ -1,8 +1,13 @@
 #pragma once
 
+#include "memoization.hpp"
+#include "tiling.hpp"
+
 #include <alpaka/alpaka.hpp>
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 
 template<typename TDerived>
 class ExpressionBase;
@@ -25,50 +30,170 @@ public:
 public:
     struct AccExpressionHandler
     {
+        using inner_handler = typename InnerExpr::AccExpressionHandler;
+
         MaterializeExpression const& results_;
-        value_type* ptr_;
+        inner_handler inner_;
+        value_type* ptr_ = nullptr;
+        bool fused_;
+
+        // tiled evaluation: the sub-tree is evaluated into the per-thread scratch for the current tile
+        bool tiled_ = false;
+        bool fill_ = false;
+        idx_type tile_size_ = 0;
+        idx_type tile_first_ = 0;
+        value_type* scratch_ = nullptr;
 
-        AccExpressionHandler(MaterializeExpression const& results) : results_(results)
+        AccExpressionHandler(MaterializeExpression const& results, inner_handler inner)
+            : results_(results)
+            , inner_(inner)
+            , fused_(results.state_->fused)
         {
         }
 
         ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
         {
-            return ptr_[i];
+            if(fused_)
+                return inner_.getValue(i);
+            return tiled_ ? ptr_[i - tile_first_] : ptr_[i];
         }
 
         void prepare()
         {
-            results_.compute();
-            ptr_ = results_.getPtr();
+            if(fused_)
+            {
+                inner_.prepare();
+                return;
+            }
+
+            auto const& tiling = impl_detail::tiling_context();
+            if(tiling.active)
+            {
+                tiled_ = true;
+                tile_size_ = static_cast<idx_type>(tiling.tile_size);
+                scratch_ = results_.getScratch(static_cast<idx_type>(tiling.slots) * tile_size_);
+                // copies of the node share the scratch, the first one prepared fills the tiles for all of them
+                fill_ = results_.claimTiles(tiling.pass);
+                if(fill_)
+                    inner_.prepare();
+            }
+            else
+            {
+                results_.compute();
+                ptr_ = results_.getPtr();
+            }
+        }
+
+        ALPAKA_FN_ACC void beginTile(idx_type slot, idx_type first, idx_type last)
+        {
+            if(fused_)
+                impl_detail::begin_tile(inner_, slot, first, last);
+            if(!tiled_)
+                return;
+
+            ptr_ = scratch_ + slot * tile_size_;
+            tile_first_ = first;
+            if(!fill_)
+                return;
+
+            impl_detail::begin_tile(inner_, slot, first, last);
+            for(idx_type i = first; i < last; ++i)
+                ptr_[i - first] = inner_.getValue(i);
         }
     };
 
 private:
+    using scratch_type = alpaka::Buf<acc_type, value_type, dim_type, idx_type>;
+
+    // shared by all copies of the expression, so a sub-tree which is used several times is computed once
+    struct State
+    {
+        eval_ret_type result;
+        std::optional<scratch_type> scratch;
+        // key of the tree when result was computed, the result is reused as long as no leaf was modified
+        std::optional<impl_detail::ExpressionKey> computed_key;
+        std::uint64_t evaluation = 0;
+        // tiled kernel whose tiles are filled by a handler already
+        std::uint64_t tiled_pass = 0;
+        bool fused = false;
+    };
+
     InnerExpr expr_;
-    mutable eval_ret_type result_;
+    std::shared_ptr<State> state_;
 
 private:
     void compute() const
     {
-        result_ = expr_;
+        impl_detail::EvaluationScope evaluation;
+        if(state_->evaluation == evaluation.id())
+            return;
+
+        auto key = impl_detail::make_cache_key(expr_);
+        if(!state_->computed_key || *state_->computed_key != key)
+        {
+            state_->result = expr_;
+            state_->computed_key = std::move(key);
+        }
+        state_->evaluation = evaluation.id();
+        // kernels which read the result may still run when the tree is destroyed
+        impl_detail::keep_until_wait(state_);
     }
 
     auto getPtr() const
     {
-        return alpaka::getPtrNative(result_.getBuffer());
+        return state_->result.getPtr();
+    }
+
+    bool claimTiles(std::uint64_t pass) const
+    {
+        if(state_->tiled_pass == pass)
+            return false;
+        state_->tiled_pass = pass;
+        return true;
+    }
+
+    value_type* getScratch(idx_type size) const
+    {
+        auto& scratch = state_->scratch;
+        if(!scratch || alpaka::getExtentVec(*scratch)[0] < size)
+        {
+            alpaka::Vec<dim_type, idx_type> const extent(size);
+            scratch = alpaka::allocBuf<value_type, idx_type>(alpaka::getDev(expr_.getQueue()), extent);
+        }
+        impl_detail::keep_until_wait(state_);
+        return alpaka::getPtrNative(*scratch);
     }
 
 public:
-    MaterializeExpression(InnerExpr const& expr) : expr_(expr)
+    MaterializeExpression(InnerExpr const& expr) : expr_(expr), state_(std::make_shared<State>())
     {
         this->queue_ = expr.getQueue();
         this->extent_ = expr.getExtent();
     }
 
+    //! Evaluates the sub-tree in the kernel which reads it instead of storing it, used by the fusion planner
+    //! for sub-trees whose type may be worth materializing although this instance is read only once.
+    void fuse()
+    {
+        state_->fused = true;
+    }
+
     AccExpressionHandler getHandler() const
     {
-        return {*this};
+        return {*this, expr_.getHandler()};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        expr_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<MaterializeExpression>();
+        impl_detail::append_cache_key(expr_, key);
     }
 };
 
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Number of reduction results which are remembered across evaluations
+#ifndef EXPR_EVAL_CACHE_SIZE
+#    define EXPR_EVAL_CACHE_SIZE 32u
+#endif
+
+namespace impl_detail
+{
+    // Memoization: every Vector carries a write version which is drawn from a global counter whenever
+    // the vector is (potentially) modified, i.e. when it is assigned by the evaluator or its buffer is
+    // handed out by getBuffer(). An expression key is the structure of a tree (node types, functor
+    // states) together with the pointer, size and version of all its leaves, so two trees with equal
+    // keys evaluate to the same values and the result of the first one can be reused.
+    // Nodes provide void appendCacheKey(ExpressionKey& key) const; trees containing a node without it
+    // (or a vector without a version) are never cached.
+
+    inline std::uint64_t next_write_version()
+    {
+        static std::atomic<std::uint64_t> counter{0};
+        return ++counter;
+    }
+
+    template<typename T>
+    struct type_tag
+    {
+        static constexpr char id = 0;
+    };
+
+    class ExpressionKey
+    {
+    private:
+        std::vector<std::uint64_t> words_;
+        bool cacheable_ = true;
+        // whether equal words imply the same nodes over the same data at the time the key is built
+        bool identifying_ = true;
+
+    public:
+        template<typename T>
+        void append(T const& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable values can be part of a key");
+            std::uint64_t words[(sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t)] = {};
+            std::memcpy(words, &value, sizeof(T));
+            words_.insert(words_.end(), std::begin(words), std::end(words));
+        }
+
+        //! Identifies the node type, the address of a per type variable is unique within the program.
+        template<typename TNode>
+        void appendType()
+        {
+            append(reinterpret_cast<std::uintptr_t>(&type_tag<TNode>::id));
+        }
+
+        //! Functors are compared bytewise, functors which can't be copied that way disable caching.
+        //! The byte of an empty functor is indeterminate, so it is identified by its type alone.
+        template<typename TFunctor>
+        void appendFunctor(TFunctor const& functor)
+        {
+            appendType<TFunctor>();
+            if constexpr(std::is_empty_v<TFunctor>)
+                return;
+            else if constexpr(std::is_trivially_copyable_v<TFunctor>)
+                append(functor);
+            else
+                invalidateIdentity();
+        }
+
+        //! The values may change without the key noticing, e.g. for a vector without a write version.
+        void invalidate()
+        {
+            cacheable_ = false;
+        }
+
+        //! The words don't determine the nodes, e.g. for a node without appendCacheKey.
+        void invalidateIdentity()
+        {
+            cacheable_ = false;
+            identifying_ = false;
+        }
+
+        bool isCacheable() const
+        {
+            return cacheable_;
+        }
+
+        bool operator==(ExpressionKey const& other) const
+        {
+            return cacheable_ && other.cacheable_ && words_ == other.words_;
+        }
+
+        bool operator!=(ExpressionKey const& other) const
+        {
+            return !(*this == other);
+        }
+
+        //! Whether both keys were built from the same tree over the same data, though maybe not cacheable.
+        bool isSameTree(ExpressionKey const& other) const
+        {
+            return identifying_ && other.identifying_ && words_ == other.words_;
+        }
+    };
+
+    template<typename TExpr, typename = void>
+    struct has_cache_key : std::false_type
+    {
+    };
+
+    template<typename TExpr>
+    struct has_cache_key<
+        TExpr,
+        std::void_t<decltype(std::declval<TExpr const&>().appendCacheKey(std::declval<ExpressionKey&>()))>>
+        : std::true_type
+    {
+    };
+
+    template<typename TExpr>
+    void append_cache_key(TExpr const& expr, ExpressionKey& key)
+    {
+        if constexpr(has_cache_key<TExpr>::value)
+            expr.appendCacheKey(key);
+        else
+            key.invalidateIdentity();
+    }
+
+    //! User callables (e.g. the generator of generate()) are compared bytewise like functors, but their bytes
+    //! don't show whether captured pointers or references point to modified data. So only callables without
+    //! state or with their own appendCacheKey(ExpressionKey&) are cacheable, the others still identify the
+    //! node within one evaluation.
+    template<typename TFunctor>
+    void append_user_functor(TFunctor const& functor, ExpressionKey& key)
+    {
+        if constexpr(has_cache_key<TFunctor>::value)
+        {
+            key.appendType<TFunctor>();
+            functor.appendCacheKey(key);
+        }
+        else
+        {
+            key.appendFunctor(functor);
+            if constexpr(!std::is_empty_v<TFunctor>)
+                key.invalidate();
+        }
+    }
+
+    template<typename TExpr>
+    ExpressionKey make_cache_key(TExpr const& expr)
+    {
+        ExpressionKey key;
+#ifndef NOT_MEMOIZE_EXPR_EVAL
+        append_cache_key(expr, key);
+#else
+        key.invalidate();
+#endif
+        return key;
+    }
+
+    //! Key which identifies the tree within the current evaluation, independent of NOT_MEMOIZE_EXPR_EVAL.
+    template<typename TExpr>
+    ExpressionKey make_identity_key(TExpr const& expr)
+    {
+        ExpressionKey key;
+        append_cache_key(expr, key);
+        return key;
+    }
+
+    // Sharing within one evaluation: copies of a MaterializeExpression or Reduction1DExpression share
+    // their state, so a node which is used in several branches of a tree is computed only once. The
+    // outermost EvaluationScope (opened by the evaluator or a direct compute()) draws a new id and nodes
+    // stamp their state with it, nested scopes (e.g. the evaluation of a materialized sub-tree) reuse it.
+
+    inline std::uint64_t& current_evaluation()
+    {
+        thread_local std::uint64_t evaluation = 0;
+        return evaluation;
+    }
+
+    class EvaluationScope
+    {
+        bool outermost_;
+
+    public:
+        EvaluationScope() : outermost_(current_evaluation() == 0)
+        {
+            static std::atomic<std::uint64_t> counter{0};
+            if(outermost_)
+                current_evaluation() = ++counter;
+        }
+
+        EvaluationScope(EvaluationScope const&) = delete;
+        EvaluationScope& operator=(EvaluationScope const&) = delete;
+
+        ~EvaluationScope()
+        {
+            if(outermost_)
+                current_evaluation() = 0;
+        }
+
+        std::uint64_t id() const
+        {
+            return current_evaluation();
+        }
+    };
+
+    // Asynchronous evaluation: inside an AsyncEvaluationScope evaluations return without waiting for their
+    // kernels, but the temporaries of a tree (materialized sub-trees, scans, ...) are destroyed with the
+    // tree when the evaluation returns. Nodes hand the state which owns their temporaries to
+    // keep_until_wait, it is released after the next wait of an evaluation or of the driver.
+
+    //! Set while evaluations don't wait for their kernels, e.g. inside drivers which synchronize
+    //! with the host themselves.
+    inline bool& evaluation_waits_suspended()
+    {
+        thread_local bool suspended = false;
+        return suspended;
+    }
+
+    inline std::vector<std::shared_ptr<void>>& pending_temporaries()
+    {
+        thread_local std::vector<std::shared_ptr<void>> temporaries;
+        return temporaries;
+    }
+
+    //! Keeps temporary alive until the kernels which were enqueued so far are waited for.
+    inline void keep_until_wait(std::shared_ptr<void> temporary)
+    {
+        if(evaluation_waits_suspended())
+            pending_temporaries().push_back(std::move(temporary));
+    }
+
+    //! Releases the temporaries of asynchronous evaluations, their queues have to be waited for.
+    inline void release_temporaries()
+    {
+        pending_temporaries().clear();
+    }
+
+    //! Bounded least recently used cache of evaluation results, one per result type.
+    template<typename T>
+    class ExpressionCache
+    {
+    private:
+        std::mutex mutex_;
+        std::list<std::pair<ExpressionKey, T>> entries_;
+
+    public:
+        static ExpressionCache& instance()
+        {
+            static ExpressionCache cache;
+            return cache;
+        }
+
+        std::optional<T> find(ExpressionKey const& key)
+        {
+            if(!key.isCacheable())
+                return std::nullopt;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            for(auto it = entries_.begin(); it != entries_.end(); ++it)
+            {
+                if(it->first == key)
+                {
+                    entries_.splice(entries_.begin(), entries_, it);
+                    return entries_.front().second;
+                }
+            }
+            return std::nullopt;
+        }
+
+        void insert(ExpressionKey key, T const& value)
+        {
+            if(!key.isCacheable())
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_.emplace_front(std::move(key), value);
+            if(entries_.size() > EXPR_EVAL_CACHE_SIZE)
+                entries_.pop_back();
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries_.clear();
+        }
+    };
+} // namespace impl_detail
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "expression_base.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+#include "vector.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cmath>
+#include <cstdint>
+
+namespace impl_detail
+{
+    //! Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"): a bijection of the
+    //! 128 bit counter keyed by 64 bits. Consecutive counters give statistically independent outputs,
+    //! so every element can compute its random numbers from its own index without any state.
+    struct Philox4x32
+    {
+        std::uint32_t v[4];
+
+        ALPAKA_FN_HOST_ACC static auto mulhilo(std::uint32_t a, std::uint32_t b, std::uint32_t& hi) -> std::uint32_t
+        {
+            std::uint64_t const product = static_cast<std::uint64_t>(a) * b;
+            hi = static_cast<std::uint32_t>(product >> 32);
+            return static_cast<std::uint32_t>(product);
+        }
+
+        ALPAKA_FN_HOST_ACC Philox4x32(std::uint64_t counter, std::uint64_t stream, std::uint64_t seed)
+            : v{static_cast<std::uint32_t>(counter),
+                static_cast<std::uint32_t>(counter >> 32),
+                static_cast<std::uint32_t>(stream),
+                static_cast<std::uint32_t>(stream >> 32)}
+        {
+            std::uint32_t k0 = static_cast<std::uint32_t>(seed);
+            std::uint32_t k1 = static_cast<std::uint32_t>(seed >> 32);
+
+            for(int round = 0; round < 10; ++round)
+            {
+                std::uint32_t hi0;
+                std::uint32_t hi1;
+                std::uint32_t const lo0 = mulhilo(0xD2511F53u, v[0], hi0);
+                std::uint32_t const lo1 = mulhilo(0xCD9E8D57u, v[2], hi1);
+                v[0] = hi1 ^ v[1] ^ k0;
+                v[1] = lo1;
+                v[2] = hi0 ^ v[3] ^ k1;
+                v[3] = lo0;
+                k0 += 0x9E3779B9u;
+                k1 += 0xBB67AE85u;
+            }
+        }
+
+        //! Uniform in (0, 1), never 0, so it can be passed to log, and never 1.
+        //! One bit less than the mantissa is drawn, so (bits + 0.5) is exact and stays below 2^bits.
+        template<typename T>
+        ALPAKA_FN_HOST_ACC auto uniform(int word) const -> T
+        {
+            if constexpr(sizeof(T) > sizeof(std::uint32_t))
+            {
+                // 52 random bits from two words
+                std::uint64_t const bits
+                    = (static_cast<std::uint64_t>(v[word]) << 20) | (static_cast<std::uint64_t>(v[word + 1]) >> 12);
+                return (static_cast<T>(bits) + T(0.5)) * T(1.0 / 4503599627370496.0);
+            }
+            else
+                return (static_cast<T>(v[word] >> 9) + T(0.5)) * T(1.0 / 8388608.0);
+        }
+    };
+} // namespace impl_detail
+
+//! Uniform in [a, b)
+template<typename T>
+struct UniformDistribution
+{
+    using value_type = T;
+
+    T a = 0;
+    T b = 1;
+
+    ALPAKA_FN_HOST_ACC auto operator()(impl_detail::Philox4x32 const& bits) const -> T
+    {
+        using std::nextafter;
+        // the uniform is below 1, but a + (b - a) * u can still round up to b
+        T const x = a + (b - a) * bits.template uniform<T>(0);
+        return x < b ? x : nextafter(b, a);
+    }
+};
+
+//! Normal distribution, Box-Muller transform of two uniforms of the same counter.
+template<typename T>
+struct NormalDistribution
+{
+    using value_type = T;
+
+    T mean = 0;
+    T stddev = 1;
+
+    ALPAKA_FN_HOST_ACC auto operator()(impl_detail::Philox4x32 const& bits) const -> T
+    {
+        using std::cos;
+        using std::log;
+        using std::sqrt;
+        T const radius = sqrt(T(-2) * log(bits.template uniform<T>(0)));
+        T const angle = T(6.283185307179586476925286766559) * bits.template uniform<T>(2);
+        return mean + stddev * radius * cos(angle);
+    }
+};
+
+//! Cauchy (Lorentz) distribution with the given location and scale, e.g. for oscillator frequencies.
+template<typename T>
+struct CauchyDistribution
+{
+    using value_type = T;
+
+    T location = 0;
+    T scale = 1;
+
+    ALPAKA_FN_HOST_ACC auto operator()(impl_detail::Philox4x32 const& bits) const -> T
+    {
+        using std::tan;
+        return location + scale * tan(T(3.1415926535897932384626433832795) * (bits.template uniform<T>(0) - T(0.5)));
+    }
+};
+
+//! Lazy random vector: element i is drawn from the distribution with the counter (i, stream) and the
+//! key seed. There is no state, the values depend neither on the work division nor on the evaluation
+//! order, and the leaf fuses into any cwise tree, e.g. fresh noise for every step of a stochastic ODE:
+//! dxdt = f(x) + sigma * random(x, NormalDistribution<double>{}, seed, step).
+template<typename TQueue, typename TAcc, typename TDistribution>
+class RandomExpression : public ExpressionBase<RandomExpression<TQueue, TAcc, TDistribution>>
+{
+public:
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using value_type = typename TDistribution::value_type;
+
+public:
+    struct AccExpressionHandler
+    {
+        TDistribution distribution_;
+        std::uint64_t seed_;
+        std::uint64_t stream_;
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return distribution_(impl_detail::Philox4x32(static_cast<std::uint64_t>(i), stream_, seed_));
+        }
+
+        void prepare()
+        {
+        }
+    };
+
+private:
+    TDistribution distribution_;
+    std::uint64_t seed_;
+    std::uint64_t stream_;
+
+public:
+    RandomExpression(
+        TQueue const& queue,
+        idx_type size,
+        TDistribution const& distribution,
+        std::uint64_t seed,
+        std::uint64_t stream = 0)
+        : distribution_(distribution)
+        , seed_(seed)
+        , stream_(stream)
+    {
+        this->queue_ = queue;
+        this->extent_[0] = size;
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {distribution_, seed_, stream_};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<RandomExpression>();
+        key.appendFunctor(distribution_);
+        key.append(seed_);
+        key.append(stream_);
+        key.append(this->extent_[0]);
+    }
+};
+
+template<typename TQueue, typename TAcc, typename TDistribution>
+struct expr_traits<RandomExpression<TQueue, TAcc, TDistribution>>
+{
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using value_type = typename TDistribution::value_type;
+    using eval_ret_type = Vector<alpaka::Buf<TAcc, value_type, dim_type, idx_type>, TQueue, TAcc>;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
+
+//! random<Acc>(queue, n, CauchyDistribution<double>{0.0, 1.0}, seed)
+template<typename TAcc, typename TQueue, typename TDistribution>
+inline RandomExpression<TQueue, TAcc, TDistribution> random(
+    TQueue const& queue,
+    alpaka::Idx<TAcc> size,
+    TDistribution const& distribution,
+    std::uint64_t seed,
+    std::uint64_t stream = 0)
+{
+    return {queue, size, distribution, seed, stream};
+}
+
+//! Random vector with the extent, queue and accelerator of another expression.
+template<typename TDerived, typename TDistribution>
+inline RandomExpression<
+    typename expr_traits<TDerived>::queue_type,
+    typename expr_traits<TDerived>::acc_type,
+    TDistribution>
+random(
+    ExpressionBase<TDerived> const& like,
+    TDistribution const& distribution,
+    std::uint64_t seed,
+    std::uint64_t stream = 0)
+{
+    return {like.getQueue(), like.getExtent()[0], distribution, seed, stream};
+}
@@ -0,0 +1,364 @@
+#pragma once
+
+#include "1d_reduction.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+template<typename TDerived>
+class ExpressionBase;
+
+template<typename TDerived>
+struct expr_traits;
+
+template<typename TBuf, typename TQueue, typename TAcc>
+class Vector;
+
+namespace impl_detail
+{
+    // Single pass prefix scan with decoupled look-back (Merrill, Garland: "Single-pass Parallel Prefix
+    // Scan with Decoupled Look-back"). Blocks take their tile in the order in which they start (dynamic
+    // tile ids), scan it locally and publish the tile aggregate. Then the first thread walks back over
+    // the tiles of the predecessors, adding their aggregates until it finds a tile whose inclusive prefix
+    // is already known, and publishes the inclusive prefix of its own tile. A tile only waits for tiles
+    // which have been started before it, so the scan can't deadlock on any backend.
+
+    enum ScanTileStatus : uint32_t
+    {
+        scan_tile_invalid = 0,
+        scan_tile_aggregate = 1,
+        scan_tile_prefix = 2
+    };
+
+    //! Tile configuration: on CPU accelerators one thread scans a tile which fits into the L1 cache.
+    template<typename TAcc, typename T, typename = void>
+    struct scan_tile_traits
+    {
+        static constexpr uint32_t block_size = getMaxBlockSize<TAcc, 256>();
+        static constexpr uint32_t items_per_thread = 8;
+    };
+
+    template<typename TAcc, typename T>
+    struct scan_tile_traits<TAcc, T, std::enable_if_t<std::is_same_v<alpaka::Dev<TAcc>, alpaka::DevCpu>>>
+    {
+        static constexpr uint32_t block_size = 1;
+        static constexpr uint32_t items_per_thread = 16384 / sizeof(T);
+    };
+
+    template<uint32_t TBlockSize, uint32_t TItemsPerThread, typename T, typename TFunc>
+    struct ScanKernel
+    {
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TAccExprHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TAccExprHandler handler,
+            T* result,
+            uint32_t* status, // status of each tile and the tile counter behind them
+            T* aggregates,
+            T* prefixes,
+            TIdx const& n,
+            TFunc func) const -> void
+        {
+            constexpr TIdx tileSize = TBlockSize * TItemsPerThread;
+
+            auto& sdata(alpaka::declareSharedVar<cheapArray<T, TBlockSize>, __COUNTER__>(acc));
+            auto& sswap(alpaka::declareSharedVar<cheapArray<T, TBlockSize>, __COUNTER__>(acc));
+            auto& tilePrefix(alpaka::declareSharedVar<cheapArray<T, 1>, __COUNTER__>(acc));
+            auto& tileId(alpaka::declareSharedVar<uint32_t, __COUNTER__>(acc));
+
+            auto const threadIndex(static_cast<uint32_t>(alpaka::getIdx<alpaka::Block, alpaka::Threads>(acc)[0]));
+            auto const numTiles = static_cast<uint32_t>((n + tileSize - 1) / tileSize);
+
+            if(threadIndex == 0)
+                tileId = alpaka::atomicAdd(acc, &status[numTiles], uint32_t{1});
+            alpaka::syncBlockThreads(acc);
+
+            uint32_t const tile = tileId;
+            TIdx const tileFirst = static_cast<TIdx>(tile) * tileSize;
+            TIdx const tileElems = n - tileFirst < tileSize ? n - tileFirst : tileSize;
+            auto const activeThreads = static_cast<uint32_t>((tileElems + TItemsPerThread - 1) / TItemsPerThread);
+            bool const active = threadIndex < activeThreads;
+
+            // thread local inclusive scan of its items
+            TIdx const first = tileFirst + static_cast<TIdx>(threadIndex) * TItemsPerThread;
+            TIdx const last = first + TItemsPerThread < tileFirst + tileElems ? first + TItemsPerThread
+                                                                              : tileFirst + tileElems;
+            if(active)
+            {
+                T running = handler.getValue(first);
+                result[first] = running;
+                for(TIdx i = first + 1; i < last; ++i)
+                {
+                    running = func(running, handler.getValue(i));
+                    result[i] = running;
+                }
+                sdata[threadIndex] = running;
+            }
+            alpaka::syncBlockThreads(acc);
+
+            // inclusive scan of the thread aggregates (Hillis-Steele)
+            for(uint32_t offset = 1; offset < activeThreads; offset *= 2)
+            {
+                if(active)
+                {
+                    sswap[threadIndex] = threadIndex >= offset ? func(sdata[threadIndex - offset], sdata[threadIndex])
+                                                               : sdata[threadIndex];
+                }
+                alpaka::syncBlockThreads(acc);
+                if(active)
+                    sdata[threadIndex] = sswap[threadIndex];
+                alpaka::syncBlockThreads(acc);
+            }
+
+            if(threadIndex == 0)
+            {
+                T const aggregate = sdata[activeThreads - 1];
+                if(tile == 0)
+                {
+                    prefixes[0] = aggregate;
+                    alpaka::mem_fence(acc, alpaka::memory_scope::Device{});
+                    alpaka::atomicExch(acc, &status[0], uint32_t{scan_tile_prefix});
+                }
+                else
+                {
+                    aggregates[tile] = aggregate;
+                    alpaka::mem_fence(acc, alpaka::memory_scope::Device{});
+                    alpaka::atomicExch(acc, &status[tile], uint32_t{scan_tile_aggregate});
+
+                    // look-back
+                    T exclusive;
+                    for(uint32_t predecessor = tile - 1;; --predecessor)
+                    {
+                        uint32_t flag;
+                        do
+                        {
+                            flag = alpaka::atomicAdd(acc, &status[predecessor], uint32_t{0});
+                        } while(flag == scan_tile_invalid);
+                        alpaka::mem_fence(acc, alpaka::memory_scope::Device{});
+
+                        T const value = flag == scan_tile_prefix ? prefixes[predecessor] : aggregates[predecessor];
+                        exclusive = predecessor == tile - 1 ? value : func(value, exclusive);
+                        if(flag == scan_tile_prefix)
+                            break;
+                    }
+
+                    prefixes[tile] = func(exclusive, aggregate);
+                    alpaka::mem_fence(acc, alpaka::memory_scope::Device{});
+                    alpaka::atomicExch(acc, &status[tile], uint32_t{scan_tile_prefix});
+                    tilePrefix[0] = exclusive;
+                }
+            }
+            alpaka::syncBlockThreads(acc);
+
+            // add the exclusive prefix of the tile and of the preceding threads
+            if(active && (tile > 0 || threadIndex > 0))
+            {
+                T prefix = threadIndex > 0 ? sdata[threadIndex - 1] : tilePrefix[0];
+                if(tile > 0 && threadIndex > 0)
+                    prefix = func(tilePrefix[0], prefix);
+                for(TIdx i = first; i < last; ++i)
+                    result[i] = func(prefix, result[i]);
+            }
+        }
+    };
+
+    //! Writes the inclusive scan of the expression handled by handler to result.
+    template<
+        typename T,
+        typename Idx,
+        typename Dim,
+        typename TAcc,
+        typename QueueAcc,
+        typename TAccExprHandler,
+        typename TFunc>
+    void inclusive_scan(QueueAcc queue, T* result, Idx n, TAccExprHandler handler, TFunc func)
+    {
+        if(n == 0)
+            return;
+
+        using traits = scan_tile_traits<TAcc, T>;
+        constexpr Idx tileSize = traits::block_size * traits::items_per_thread;
+        auto const numTiles = static_cast<Idx>((n + tileSize - 1) / tileSize);
+        auto const devAcc = alpaka::getDev(queue);
+
+        alpaka::Vec<Dim, Idx> const statusExtent(numTiles + 1);
+        alpaka::Vec<Dim, Idx> const tilesExtent(numTiles);
+        auto status = alpaka::allocBuf<uint32_t, Idx>(devAcc, statusExtent);
+        auto aggregates = alpaka::allocBuf<T, Idx>(devAcc, tilesExtent);
+        auto prefixes = alpaka::allocBuf<T, Idx>(devAcc, tilesExtent);
+        alpaka::memset(queue, status, 0, statusExtent);
+
+        handler.prepare();
+
+        ScanKernel<traits::block_size, traits::items_per_thread, T, TFunc> kernel;
+        alpaka::WorkDivMembers<Dim, Idx> const workDiv{
+            static_cast<Idx>(numTiles),
+            static_cast<Idx>(traits::block_size),
+            static_cast<Idx>(1)};
+        alpaka::enqueue(
+            queue,
+            alpaka::createTaskKernel<TAcc>(
+                workDiv,
+                kernel,
+                handler,
+                result,
+                alpaka::getPtrNative(status),
+                alpaka::getPtrNative(aggregates),
+                alpaka::getPtrNative(prefixes),
+                n,
+                func));
+        alpaka::wait(queue);
+    }
+} // namespace impl_detail
+
+//! Inclusive or exclusive prefix scan of the inner expression with an associative functor.
+//!
+//! The scan is not lazy: like a MaterializeExpression it is computed into a temporary when the tree is
+//! prepared, which is then read cwise. The exclusive scan starts with init, so it doesn't need a
+//! neutral element of the functor.
+template<typename InnerExpr, typename Op>
+class ScanExpression : public ExpressionBase<ScanExpression<InnerExpr, Op>>
+{
+public:
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename Op::return_type;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+    // the elements are those of the functor, e.g. counts of a scan over a mask
+    using eval_ret_type = Vector<alpaka::Buf<acc_type, value_type, dim_type, idx_type>, queue_type, acc_type>;
+
+public:
+    struct AccExpressionHandler
+    {
+        ScanExpression const& results_;
+        value_type* ptr_ = nullptr;
+        Op op_;
+        bool exclusive_;
+        value_type init_;
+
+        AccExpressionHandler(ScanExpression const& results, Op op, bool exclusive, value_type init)
+            : results_(results)
+            , op_(op)
+            , exclusive_(exclusive)
+            , init_(init)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            if(!exclusive_)
+                return ptr_[i];
+            return i == 0 ? init_ : op_(init_, ptr_[i - 1]);
+        }
+
+        void prepare()
+        {
+            // the scan reads all preceding elements, so the operand can't be evaluated tile by tile
+            impl_detail::TilingScope suspend_tiling;
+            results_.compute();
+            ptr_ = results_.getPtr();
+        }
+    };
+
+private:
+    // shared by all copies of the expression
+    struct State
+    {
+        eval_ret_type result;
+        std::optional<impl_detail::ExpressionKey> computed_key;
+        std::uint64_t evaluation = 0;
+    };
+
+    InnerExpr expr_;
+    Op op_;
+    bool exclusive_;
+    value_type init_;
+    std::shared_ptr<State> state_;
+
+private:
+    //! Computes the inclusive scan, the exclusive one is derived from it on access.
+    void compute() const
+    {
+        impl_detail::EvaluationScope evaluation;
+        if(state_->evaluation == evaluation.id())
+            return;
+
+        auto key = impl_detail::make_cache_key(*this);
+        if(!state_->computed_key || *state_->computed_key != key)
+        {
+            auto queue = expr_.getQueue();
+            auto const n = expr_.getExtent()[0];
+            state_->result.adjust_size(n, queue);
+            impl_detail::inclusive_scan<value_type, idx_type, dim_type, acc_type>(
+                queue,
+                state_->result.getPtr(),
+                n,
+                impl_detail::make_kernel_handler(expr_),
+                op_);
+            state_->result.markModified();
+            state_->computed_key = std::move(key);
+        }
+        state_->evaluation = evaluation.id();
+        impl_detail::keep_until_wait(state_);
+    }
+
+    value_type* getPtr() const
+    {
+        return state_->result.hasBuffer() ? state_->result.getPtr() : nullptr;
+    }
+
+public:
+    ScanExpression(InnerExpr const& expr, Op const& op, bool exclusive = false, value_type init = value_type{})
+        : expr_(expr)
+        , op_(op)
+        , exclusive_(exclusive)
+        , init_(init)
+        , state_(std::make_shared<State>())
+    {
+        this->queue_ = expr.getQueue();
+        this->extent_ = expr.getExtent();
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {*this, op_, exclusive_, init_};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        expr_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<ScanExpression>();
+        key.appendFunctor(op_);
+        key.append(exclusive_);
+        key.appendFunctor(init_);
+        impl_detail::append_cache_key(expr_, key);
+    }
+};
+
+template<typename InnerExpr, typename Op>
+struct expr_traits<ScanExpression<InnerExpr, Op>>
+{
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename Op::return_type;
+    using eval_ret_type = Vector<alpaka::Buf<acc_type, value_type, dim_type, idx_type>, queue_type, acc_type>;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = false;
+};
@@ -0,0 +1,286 @@
+#pragma once
+
+#include "deferred.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+#include "vector.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace impl_detail
+{
+    //! dest[idx_i] += value_i, conflicting updates are resolved with atomics.
+    class ScatterAddAtomicKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TElem, typename TIndicesHandler, typename TValuesHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TElem* const dest,
+            TIndicesHandler indices,
+            TValuesHandler values,
+            TIdx const& numElements) const -> void
+        {
+            TIdx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const threadElemExtent(alpaka::getWorkDiv<alpaka::Thread, alpaka::Elems>(acc)[0u]);
+            TIdx const threadFirstElemIdx(gridThreadIdx * threadElemExtent);
+            TIdx const threadLastElemIdx(
+                (numElements > threadFirstElemIdx + threadElemExtent) ? threadFirstElemIdx + threadElemExtent
+                                                                      : numElements);
+
+            for(TIdx i(threadFirstElemIdx); i < threadLastElemIdx; ++i)
+            {
+                auto const target = static_cast<TIdx>(indices.getValue(i));
+                alpaka::atomicAdd(acc, dest + target, static_cast<TElem>(values.getValue(i)));
+            }
+        }
+    };
+
+    //! Every thread sums the contributions of its targets in the order of a ScatterPlan, so there are
+    //! no conflicts and the result doesn't depend on the scheduling.
+    class ScatterAddSortedKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TElem, typename TValuesHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TElem* const dest,
+            TValuesHandler values,
+            TIdx const* const permutation,
+            TIdx const* const targets,
+            TIdx const* const offsets,
+            TIdx const& numTargets) const -> void
+        {
+            TIdx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const threadElemExtent(alpaka::getWorkDiv<alpaka::Thread, alpaka::Elems>(acc)[0u]);
+            TIdx const threadFirstTarget(gridThreadIdx * threadElemExtent);
+            TIdx const threadLastTarget(
+                (numTargets > threadFirstTarget + threadElemExtent) ? threadFirstTarget + threadElemExtent
+                                                                    : numTargets);
+
+            for(TIdx t(threadFirstTarget); t < threadLastTarget; ++t)
+            {
+                auto sum = static_cast<TElem>(values.getValue(permutation[offsets[t]]));
+                for(TIdx k(offsets[t] + 1); k < offsets[t + 1]; ++k)
+                    sum += static_cast<TElem>(values.getValue(permutation[k]));
+                dest[targets[t]] += sum;
+            }
+        }
+    };
+
+    //! The scatter kernels add to elements of the destination which other threads may still read, so no
+    //! vector which is read by the indices or the values may share memory with it. Trees with nodes
+    //! which read buffers without visiting them can't be checked.
+    template<typename TVector, typename TExpr>
+    void check_scatter_aliasing(TVector const& dest, TExpr const& expr)
+    {
+        StatementReads reads;
+        expr.visit(reads);
+        if(dest.hasBuffer() && overlaps_any(memory_range(dest), reads.vectors))
+            throw std::invalid_argument("The destination of scatter_add is read by the indices or values");
+    }
+
+    template<typename TAcc, typename TQueue, typename TKernel, typename TIdx, typename... TArgs>
+    void launch_scatter_kernel(TQueue& queue, TKernel const& kernel, TIdx numElements, TArgs&&... args)
+    {
+        if(numElements == 0)
+            return;
+
+        using Dim = alpaka::Dim<TAcc>;
+        TIdx const elementsPerThread(8u);
+        alpaka::Vec<Dim, TIdx> const extent(numElements);
+
+        alpaka::WorkDivMembers<Dim, TIdx> const workDiv(alpaka::getValidWorkDiv<TAcc>(
+            alpaka::getDev(queue),
+            extent,
+            elementsPerThread,
+            false,
+            alpaka::GridBlockExtentSubDivRestrictions::Unrestricted));
+
+        alpaka::enqueue(queue, alpaka::createTaskKernel<TAcc>(workDiv, kernel, std::forward<TArgs>(args)...));
+        impl_detail::finish_evaluation(queue);
+    }
+} // namespace impl_detail
+
+//! Precomputed order for the sort-based scatter_add: the element indices sorted by their targets and
+//! the range of every target within them. Building the plan downloads the indices once, so it pays
+//! off if the same indices (e.g. the edges of a network) are used for many scatters.
+template<typename TAcc, typename TIdx>
+class ScatterPlan
+{
+public:
+    using acc_type = TAcc;
+    using idx_type = TIdx;
+    using buf_type = alpaka::Buf<TAcc, TIdx, alpaka::DimInt<1u>, TIdx>;
+
+private:
+    std::optional<buf_type> permutation_;
+    std::optional<buf_type> targets_;
+    std::optional<buf_type> offsets_;
+    TIdx num_elements_ = 0;
+    TIdx num_targets_ = 0;
+
+public:
+    template<typename TBuf, typename TQueue>
+    explicit ScatterPlan(Vector<TBuf, TQueue, TAcc> const& indices)
+    {
+        using index_type = alpaka::Elem<TBuf>;
+        using extent_type = alpaka::Vec<alpaka::DimInt<1u>, TIdx>;
+
+        auto queue = indices.getQueue();
+        auto const devAcc = indices.getDevice();
+        auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+        num_elements_ = static_cast<TIdx>(indices.getExtent()[0]);
+
+        std::vector<index_type> host(num_elements_);
+        alpaka::memcpy(
+            queue,
+            alpaka::createView(devHost, host.data(), extent_type(num_elements_)),
+            indices.getConstBuffer());
+        alpaka::wait(queue);
+
+        // stable, so the contributions to a target are summed in the order of the elements
+        std::vector<TIdx> permutation(num_elements_);
+        std::iota(permutation.begin(), permutation.end(), TIdx{0});
+        std::stable_sort(
+            permutation.begin(),
+            permutation.end(),
+            [&host](TIdx a, TIdx b) { return host[a] < host[b]; });
+
+        std::vector<TIdx> targets;
+        std::vector<TIdx> offsets;
+        for(TIdx k = 0; k < num_elements_; ++k)
+        {
+            auto const target = static_cast<TIdx>(host[permutation[k]]);
+            if(targets.empty() || targets.back() != target)
+            {
+                targets.push_back(target);
+                offsets.push_back(k);
+            }
+        }
+        offsets.push_back(num_elements_);
+        num_targets_ = static_cast<TIdx>(targets.size());
+
+        auto upload = [&](std::vector<TIdx>& data)
+        {
+            extent_type const extent(static_cast<TIdx>(data.size()));
+            buf_type buf = alpaka::allocBuf<TIdx, TIdx>(devAcc, extent);
+            alpaka::memcpy(queue, buf, alpaka::createView(devHost, data.data(), extent));
+            return buf;
+        };
+        permutation_ = upload(permutation);
+        targets_ = upload(targets);
+        offsets_ = upload(offsets);
+        alpaka::wait(queue);
+    }
+
+    TIdx getNumElements() const
+    {
+        return num_elements_;
+    }
+
+    TIdx getNumTargets() const
+    {
+        return num_targets_;
+    }
+
+    TIdx const* getPermutation() const
+    {
+        return alpaka::getPtrNative(*permutation_);
+    }
+
+    TIdx const* getTargets() const
+    {
+        return alpaka::getPtrNative(*targets_);
+    }
+
+    TIdx const* getOffsets() const
+    {
+        return alpaka::getPtrNative(*offsets_);
+    }
+};
+
+template<typename TBuf, typename TQueue, typename TAcc>
+ScatterPlan<TAcc, alpaka::Idx<TBuf>> make_scatter_plan(Vector<TBuf, TQueue, TAcc> const& indices)
+{
+    return ScatterPlan<TAcc, alpaka::Idx<TBuf>>{indices};
+}
+
+//! dest[indices_i] += values_i for all i, the contributions to the same element are added with atomics.
+//! The values are evaluated inside the scatter kernel, no temporary is created for them. dest must not
+//! be read by the indices or the values (not even through a reduction), this throws std::invalid_argument.
+template<typename TBuf, typename TQueue, typename TAcc, typename TIndices, typename TValues>
+void scatter_add(
+    Vector<TBuf, TQueue, TAcc>& dest,
+    ExpressionBase<TIndices> const& indices,
+    ExpressionBase<TValues> const& values)
+{
+    using Idx = alpaka::Idx<TBuf>;
+    auto const n = static_cast<Idx>(indices.getExtent()[0]);
+    if(values.getExtent()[0] != n)
+        throw std::invalid_argument("Extents of indices and values are mismatched");
+    impl_detail::check_scatter_aliasing(dest, indices.derived());
+    impl_detail::check_scatter_aliasing(dest, values.derived());
+
+    impl_detail::EvaluationScope evaluation;
+    auto indicesHandler = impl_detail::make_kernel_handler(indices.derived());
+    auto valuesHandler = impl_detail::make_kernel_handler(values.derived());
+    {
+        impl_detail::TilingScope suspend_tiling;
+        indicesHandler.prepare();
+        valuesHandler.prepare();
+    }
+
+    auto queue = dest.getQueue();
+    impl_detail::launch_scatter_kernel<TAcc>(
+        queue,
+        impl_detail::ScatterAddAtomicKernel{},
+        n,
+        dest.getPtr(),
+        indicesHandler,
+        valuesHandler,
+        n);
+    dest.markModified();
+}
+
+//! dest[indices_i] += values_i for all i in the order of a ScatterPlan, deterministic and free of atomics.
+//! Like above, dest must not be read by the values.
+template<typename TBuf, typename TQueue, typename TAcc, typename TIdx, typename TValues>
+void scatter_add(
+    Vector<TBuf, TQueue, TAcc>& dest,
+    ScatterPlan<TAcc, TIdx> const& plan,
+    ExpressionBase<TValues> const& values)
+{
+    if(static_cast<TIdx>(values.getExtent()[0]) != plan.getNumElements())
+        throw std::invalid_argument("Extents of the scatter plan and values are mismatched");
+    impl_detail::check_scatter_aliasing(dest, values.derived());
+
+    impl_detail::EvaluationScope evaluation;
+    auto valuesHandler = impl_detail::make_kernel_handler(values.derived());
+    {
+        impl_detail::TilingScope suspend_tiling;
+        valuesHandler.prepare();
+    }
+
+    auto queue = dest.getQueue();
+    impl_detail::launch_scatter_kernel<TAcc>(
+        queue,
+        impl_detail::ScatterAddSortedKernel{},
+        plan.getNumTargets(),
+        dest.getPtr(),
+        valuesHandler,
+        plan.getPermutation(),
+        plan.getTargets(),
+        plan.getOffsets(),
+        plan.getNumTargets());
+    dest.markModified();
+}
@@ -0,0 +1,383 @@
+#pragma once
+
+#include "1d_reduction.hpp"
+#include "expression_base.hpp"
+#include "functors.hpp"
+#include "gather_expression.hpp"
+#include "generator_expression.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+#include "vector.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+//! y_i = i / n, the segment of element i when segments have n elements.
+template<typename TIdx>
+struct SegmentIndexGenerator
+{
+    TIdx n;
+
+    ALPAKA_FN_HOST_ACC auto operator()(TIdx i) const -> TIdx
+    {
+        return i / n;
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.append(n);
+    }
+};
+
+//! y_i = i % n, the position of element i within its segment when segments have n elements.
+template<typename TIdx>
+struct SegmentOffsetGenerator
+{
+    TIdx n;
+
+    ALPAKA_FN_HOST_ACC auto operator()(TIdx i) const -> TIdx
+    {
+        return i % n;
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.append(n);
+    }
+};
+
+namespace impl_detail
+{
+    //! Reduces every segment of segmentSize elements with one block on GPUs, the threads of the block stride
+    //! through the segment and combine their results in shared memory. The blocks loop over the segments.
+    template<uint32_t TBlockSize, typename T, typename TFunc>
+    struct SegmentedReduceKernel
+    {
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TAccExprHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TAccExprHandler handler,
+            T* destination,
+            TIdx const& segments,
+            TIdx const& segmentSize,
+            TFunc func) const -> void
+        {
+            auto& sdata(alpaka::declareSharedVar<cheapArray<T, TBlockSize>, __COUNTER__>(acc));
+
+            auto const blockIndex = static_cast<TIdx>(alpaka::getIdx<alpaka::Grid, alpaka::Blocks>(acc)[0]);
+            auto const threadIndex = static_cast<TIdx>(alpaka::getIdx<alpaka::Block, alpaka::Threads>(acc)[0]);
+            auto const gridBlocks = static_cast<TIdx>(alpaka::getWorkDiv<alpaka::Grid, alpaka::Blocks>(acc)[0]);
+
+            // threads which hold a value, the same for all segments
+            TIdx const active = (segmentSize < TBlockSize) ? segmentSize : static_cast<TIdx>(TBlockSize);
+
+            for(TIdx s = blockIndex; s < segments; s += gridBlocks)
+            {
+                TIdx const first = s * segmentSize;
+                if(threadIndex < active)
+                {
+                    T result = handler.getValue(first + threadIndex);
+                    for(TIdx i = threadIndex + TBlockSize; i < segmentSize; i += TBlockSize)
+                        result = func(result, handler.getValue(first + i));
+                    sdata[threadIndex] = result;
+                }
+
+                alpaka::syncBlockThreads(acc);
+
+                for(TIdx width = active; width > 1; width = (width + 1) / 2)
+                {
+                    TIdx const half = (width + 1) / 2;
+                    if(threadIndex + half < width)
+                        sdata[threadIndex] = func(sdata[threadIndex], sdata[threadIndex + half]);
+
+                    alpaka::syncBlockThreads(acc);
+                }
+
+                if(threadIndex == 0)
+                    destination[s] = sdata[0];
+
+                // the shared memory is reused by the next segment
+                alpaka::syncBlockThreads(acc);
+            }
+        }
+    };
+
+    //! Segmented reduction on CPU accelerators: every worker reduces a contiguous range of whole
+    //! segments, each of them with reduce_chunk().
+    template<uint32_t TAccumulators, typename T, typename TFunc>
+    struct CpuSegmentedReduceKernel
+    {
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TAccExprHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TAccExprHandler handler,
+            T* destination,
+            TIdx const& segments,
+            TIdx const& segmentSize,
+            TFunc func) const -> void
+        {
+            auto const worker = static_cast<TIdx>(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0]);
+            auto const workers = static_cast<TIdx>(alpaka::getWorkDiv<alpaka::Grid, alpaka::Threads>(acc)[0]);
+
+            TIdx const rest = segments % workers;
+            TIdx const first = segments / workers * worker + (worker < rest ? worker : rest);
+            TIdx const last = first + segments / workers + (worker < rest ? 1 : 0);
+
+            for(TIdx s = first; s < last; ++s)
+                destination[s]
+                    = reduce_chunk<TAccumulators, T>(handler, s * segmentSize, (s + 1) * segmentSize, func);
+        }
+    };
+
+    //! Enqueues the reduction of every segment of segmentSize elements of a prepared handler, the result of
+    //! segment s is written to destination[s]. segments and segmentSize have to be positive.
+    template<
+        typename T,
+        typename Idx,
+        typename Dim,
+        typename TAcc,
+        typename DevAcc,
+        typename QueueAcc,
+        typename TAccExprHandler,
+        typename TFunc>
+    void enqueue_segmented_reduce(
+        DevAcc const& devAcc,
+        QueueAcc& queue,
+        Idx segments,
+        Idx segmentSize,
+        TAccExprHandler const& handler,
+        TFunc func,
+        T* destination)
+    {
+        if constexpr(std::is_same_v<DevAcc, alpaka::DevCpu>)
+        {
+            static constexpr uint32_t accumulators = 4;
+
+            auto const workers = std::min(cpu_reduction_workers<TAcc, Idx>(devAcc), segments);
+            alpaka::Vec<Dim, Idx> const extent(workers);
+            alpaka::Vec<Dim, Idx> const one(Idx{1});
+            auto const workDiv = cpu_reduction_traits<TAcc>::parallelism == CpuParallelism::Threads
+                                     ? alpaka::WorkDivMembers<Dim, Idx>{one, extent, one}
+                                     : alpaka::WorkDivMembers<Dim, Idx>{extent, one, one};
+
+            CpuSegmentedReduceKernel<accumulators, T, TFunc> kernel;
+            alpaka::enqueue(
+                queue,
+                alpaka::createTaskKernel<TAcc>(workDiv, kernel, handler, destination, segments, segmentSize, func));
+        }
+        else
+        {
+            static constexpr uint64_t blockSize = getMaxBlockSize<TAcc, 256>();
+
+            auto const maxBlocks = static_cast<Idx>(alpaka::getAccDevProps<TAcc>(devAcc).m_multiProcessorCount * 8);
+            auto const blocks = std::min(segments, maxBlocks);
+            alpaka::WorkDivMembers<Dim, Idx> const workDiv{blocks, static_cast<Idx>(blockSize), Idx{1}};
+
+            SegmentedReduceKernel<blockSize, T, TFunc> kernel;
+            alpaka::enqueue(
+                queue,
+                alpaka::createTaskKernel<TAcc>(workDiv, kernel, handler, destination, segments, segmentSize, func));
+        }
+    }
+} // namespace impl_detail
+
+//! Reduces every segment of segmentSize consecutive elements of the inner expression to one value, e.g.
+//! the mean fields of P ensembles of N oscillators which are stacked into one state of P * N elements:
+//!
+//!     auto const sums = segmented_sum(x.sincos(), N);
+//!
+//! The extent is the number of segments. All segments are reduced by one kernel before the surrounding
+//! kernel runs, the results stay on the device and are read like a Vector.
+template<typename InnerExpr, typename Op>
+class SegmentedReductionExpression : public ExpressionBase<SegmentedReductionExpression<InnerExpr, Op>>
+{
+public:
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename Op::return_type;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+    using eval_ret_type = Vector<alpaka::Buf<acc_type, value_type, dim_type, idx_type>, queue_type, acc_type>;
+
+public:
+    struct AccExpressionHandler
+    {
+        SegmentedReductionExpression const& results_;
+        value_type* ptr_ = nullptr;
+
+        AccExpressionHandler(SegmentedReductionExpression const& results) : results_(results)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return ptr_[i];
+        }
+
+        void prepare()
+        {
+            impl_detail::TilingScope suspend_tiling;
+            results_.compute();
+            ptr_ = results_.getPtr();
+        }
+    };
+
+private:
+    // shared by all copies of the expression
+    struct State
+    {
+        eval_ret_type result;
+        // key of the tree when result was computed, the result is reused as long as no leaf was modified
+        std::optional<impl_detail::ExpressionKey> computed_key;
+        std::uint64_t evaluation = 0;
+    };
+
+    InnerExpr expr_;
+    Op op_;
+    idx_type segment_size_;
+    std::shared_ptr<State> state_;
+
+private:
+    void compute() const
+    {
+        impl_detail::EvaluationScope evaluation;
+        if(state_->evaluation == evaluation.id())
+            return;
+
+        auto key = impl_detail::make_cache_key(*this);
+        if(!state_->computed_key || *state_->computed_key != key)
+        {
+            auto queue = expr_.getQueue();
+            idx_type const segments = this->extent_[0];
+            state_->result.adjust_size(segments, queue);
+
+            auto handler = impl_detail::make_kernel_handler(expr_);
+            handler.prepare();
+
+            if(segments > 0 && segment_size_ > 0)
+            {
+                impl_detail::enqueue_segmented_reduce<value_type, idx_type, dim_type, acc_type>(
+                    alpaka::getDev(queue),
+                    queue,
+                    segments,
+                    segment_size_,
+                    handler,
+                    op_,
+                    state_->result.getPtr());
+            }
+            state_->result.markModified();
+            impl_detail::finish_evaluation(queue);
+
+            state_->computed_key = std::move(key);
+        }
+        state_->evaluation = evaluation.id();
+        impl_detail::keep_until_wait(state_);
+    }
+
+    value_type* getPtr() const
+    {
+        // no buffer is allocated for zero segments
+        return state_->result.hasBuffer() ? state_->result.getPtr() : nullptr;
+    }
+
+public:
+    SegmentedReductionExpression(InnerExpr const& expr, Op const& op, idx_type segmentSize)
+        : expr_(expr)
+        , op_(op)
+        , segment_size_(segmentSize)
+        , state_(std::make_shared<State>())
+    {
+        auto const n = expr.getExtent()[0];
+        if(segmentSize == 0 ? n != 0 : n % segmentSize != 0)
+            throw std::invalid_argument("The extent is not a multiple of the segment size");
+
+        this->queue_ = expr.getQueue();
+        this->extent_[0] = (segmentSize == 0) ? idx_type{0} : n / segmentSize;
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {*this};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        expr_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<SegmentedReductionExpression>();
+        key.appendFunctor(op_);
+        key.append(segment_size_);
+        impl_detail::append_cache_key(expr_, key);
+    }
+};
+
+template<typename InnerExpr, typename Op>
+struct expr_traits<SegmentedReductionExpression<InnerExpr, Op>>
+{
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename Op::return_type;
+    using eval_ret_type = Vector<alpaka::Buf<acc_type, value_type, dim_type, idx_type>, queue_type, acc_type>;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = false;
+};
+
+//! y_s = x_(s * n) op ... op x_(s * n + n - 1), one value per segment of n elements.
+template<typename TDerived, typename TOp>
+inline SegmentedReductionExpression<TDerived, TOp> segmented_reduce(
+    ExpressionBase<TDerived> const& expr,
+    typename expr_traits<TDerived>::idx_type segmentSize,
+    TOp const& op)
+{
+    return {expr.derived(), op, segmentSize};
+}
+
+//! Sums of the segments of n elements.
+template<typename TDerived>
+inline SegmentedReductionExpression<
+    TDerived,
+    AddFunctor<typename expr_traits<TDerived>::value_type, typename expr_traits<TDerived>::value_type>>
+segmented_sum(ExpressionBase<TDerived> const& expr, typename expr_traits<TDerived>::idx_type segmentSize)
+{
+    using value_type = typename expr_traits<TDerived>::value_type;
+    return segmented_reduce(expr, segmentSize, AddFunctor<value_type, value_type>{});
+}
+
+//! y_i = values_(i / n): every value is repeated for the n elements of its segment, e.g. the parameter of
+//! every member of a batch of ensembles.
+template<typename TDerived>
+inline auto broadcast_segments(ExpressionBase<TDerived> const& values, typename expr_traits<TDerived>::idx_type n)
+{
+    using acc_type = typename expr_traits<TDerived>::acc_type;
+    using idx_type = typename expr_traits<TDerived>::idx_type;
+    auto queue = values.getQueue();
+    return gather(values, generate<acc_type>(queue, values.getExtent()[0] * n, SegmentIndexGenerator<idx_type>{n}));
+}
+
+//! y_i = values_(i % n) for count segments, where n is the extent of values, e.g. the same initial
+//! condition for every member of a batch.
+template<typename TDerived>
+inline auto repeat_segments(ExpressionBase<TDerived> const& values, typename expr_traits<TDerived>::idx_type count)
+{
+    using acc_type = typename expr_traits<TDerived>::acc_type;
+    using idx_type = typename expr_traits<TDerived>::idx_type;
+    auto queue = values.getQueue();
+    auto const n = values.getExtent()[0];
+    return gather(values, generate<acc_type>(queue, n * count, SegmentOffsetGenerator<idx_type>{n}));
+}
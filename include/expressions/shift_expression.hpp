@@ -0,0 +1,121 @@
+#pragma once
+
+#include "memoization.hpp"
+#include "tiling.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstddef>
+
+template<typename TDerived>
+class ExpressionBase;
+
+template<typename TDerived>
+struct expr_traits;
+
+//! Reads the inner expression at the compile time shifted index i + shift.
+//! Indices outside of [0, N) are clamped to the boundary elements.
+template<typename InnerExpr, int shift>
+class ShiftExpression : public ExpressionBase<ShiftExpression<InnerExpr, shift>>
+{
+public:
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename InnerExpr::value_type;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+
+    static constexpr int offset = shift;
+
+public:
+    struct AccExpressionHandler
+    {
+        using inner_handler = typename InnerExpr::AccExpressionHandler;
+        inner_handler inner;
+        std::size_t N;
+
+        AccExpressionHandler(inner_handler const& inner, std::size_t N) : inner(inner), N(N)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+#pragma nv_diag_suppress 68
+            idx_type real_idx = i + shift;
+#pragma nv_diag_suppress 68
+            if constexpr(shift < 0)
+            {
+                if(i < -shift)
+                    real_idx = static_cast<idx_type>(0);
+            }
+            else
+            {
+                if(real_idx > N - 1)
+                    real_idx = static_cast<idx_type>(N - 1);
+            }
+            return inner.getValue(real_idx);
+        }
+
+        void prepare()
+        {
+            // neighbouring elements are read, so the operand can't be evaluated tile by tile
+            impl_detail::TilingScope suspend_tiling;
+            inner.prepare();
+        }
+
+        ALPAKA_FN_ACC void beginTile(idx_type slot, idx_type first, idx_type last)
+        {
+            // only handlers which were prepared for it react, e.g. the windows of temporal blocking
+            impl_detail::begin_tile(inner, slot, first, last);
+        }
+    };
+
+private:
+    InnerExpr expr_;
+    std::size_t N_;
+
+public:
+    ShiftExpression(InnerExpr const& expr) : expr_(expr)
+    {
+        this->queue_ = expr.getQueue();
+        this->extent_ = expr.getExtent();
+        N_ = this->extent_[0];
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {expr_.getHandler(), N_};
+    }
+
+    InnerExpr const& getInner() const
+    {
+        return expr_;
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        expr_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<ShiftExpression>();
+        impl_detail::append_cache_key(expr_, key);
+    }
+};
+
+template<typename InnerExpr, int shift>
+struct expr_traits<ShiftExpression<InnerExpr, shift>>
+{
+    using acc_type = typename expr_traits<InnerExpr>::acc_type;
+    using idx_type = typename expr_traits<InnerExpr>::idx_type;
+    using dim_type = typename expr_traits<InnerExpr>::dim_type;
+    using queue_type = typename expr_traits<InnerExpr>::queue_type;
+    using value_type = typename expr_traits<InnerExpr>::value_type;
+    using eval_ret_type = typename expr_traits<InnerExpr>::eval_ret_type;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
@@ -0,0 +1,290 @@
+#pragma once
+
+#include "expression_base.hpp"
+#include "flat_handler.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+#include "vector.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+namespace impl_detail
+{
+    //! Handlers of the expressions of all components, stored recursively because kernel arguments
+    //! have to be trivially copyable.
+    template<typename... THandlers>
+    struct ComponentHandlers
+    {
+        void prepare()
+        {
+        }
+
+        //! Stores the values of all components once they have been evaluated, so in place assignments like
+        //! b.assign(b.component(1), b.component(0)) read the old values of every component.
+        template<typename TElem, typename TIdx, typename... TValues>
+        ALPAKA_FN_ACC void assign(TElem* const res, TIdx stride, TIdx i, TValues const... values) const
+        {
+            TIdx c = 0;
+            ((res[c++ * stride + i] = values), ...);
+        }
+    };
+
+    template<typename THead, typename... TTail>
+    struct ComponentHandlers<THead, TTail...>
+    {
+        THead head;
+        ComponentHandlers<TTail...> tail;
+
+        void prepare()
+        {
+            head.prepare();
+            tail.prepare();
+        }
+
+        //! Writes element i of every component, the components are stride elements apart. The values of the
+        //! components which have been evaluated so far are passed along in registers.
+        template<typename TElem, typename TIdx, typename... TValues>
+        ALPAKA_FN_ACC void assign(TElem* const res, TIdx stride, TIdx i, TValues const... values) const
+        {
+            tail.assign(res, stride, i, values..., static_cast<TElem>(head.getValue(i)));
+        }
+    };
+
+    inline ComponentHandlers<> make_component_handlers()
+    {
+        return {};
+    }
+
+    template<typename THead, typename... TTail>
+    ComponentHandlers<THead, TTail...> make_component_handlers(THead const& head, TTail const&... tail)
+    {
+        return {head, make_component_handlers(tail...)};
+    }
+
+    //! Evaluates the expressions of all components of a StateBundle, every thread computes element i of
+    //! all components, so operands which are shared between the components are read only once.
+    class ComponentAssignKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TElem, typename THandlers, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TElem* const res,
+            THandlers handlers,
+            TIdx const& numElements) const -> void
+        {
+            static_assert(alpaka::Dim<TAcc>::value == 1, "The ComponentAssignKernel expects 1-dimensional indices!");
+
+            TIdx const gridThreadIdx(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const threadElemExtent(alpaka::getWorkDiv<alpaka::Thread, alpaka::Elems>(acc)[0u]);
+            TIdx const threadFirstElemIdx(gridThreadIdx * threadElemExtent);
+
+            if(threadFirstElemIdx < numElements)
+            {
+                TIdx const threadLastElemIdx(threadFirstElemIdx + threadElemExtent);
+                TIdx const threadLastElemIdxClipped(
+                    (numElements > threadLastElemIdx) ? threadLastElemIdx : numElements);
+
+                for(TIdx i(threadFirstElemIdx); i < threadLastElemIdxClipped; ++i)
+                {
+                    handlers.assign(res, numElements, i);
+                }
+            }
+        }
+    };
+} // namespace impl_detail
+
+//! Reads one component of a StateBundle, i.e. the elements [c * n, (c + 1) * n) of its buffer.
+//! Assigning to it evaluates the expression into the component only.
+template<typename TVector>
+class ComponentExpression : public ExpressionBase<ComponentExpression<TVector>>
+{
+public:
+    using acc_type = typename TVector::acc_type;
+    using queue_type = typename TVector::queue_type;
+    using dim_type = typename TVector::dim_type;
+    using idx_type = typename TVector::idx_type;
+    using value_type = typename TVector::value_type;
+
+public:
+    struct AccExpressionHandler
+    {
+        ComponentExpression const& component_;
+        value_type* ptr_;
+
+        AccExpressionHandler(ComponentExpression const& component) : component_(component)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return ptr_[i];
+        }
+
+        void prepare()
+        {
+            ptr_ = component_.getPtr();
+        }
+    };
+
+private:
+    TVector vector_;
+    idx_type offset_;
+
+public:
+    ComponentExpression(TVector const& vector, idx_type offset, idx_type size) : vector_(vector), offset_(offset)
+    {
+        this->queue_ = vector.getQueue();
+        this->extent_[0] = size;
+    }
+
+    //! Evaluates the other component instead of rebinding the view.
+    ComponentExpression& operator=(ComponentExpression const& other)
+    {
+        return operator=<ComponentExpression>(other);
+    }
+
+    template<typename TOtherDerived>
+    ComponentExpression& operator=(ExpressionBase<TOtherDerived> const& other)
+    {
+        if(other.getExtent() != this->extent_)
+            throw std::invalid_argument("Extents of arguments are mismatched");
+
+        auto queue = this->getQueue();
+        impl_detail::EvaluationScope evaluation;
+        auto handler = impl_detail::make_kernel_handler(other.derived());
+        {
+            impl_detail::TilingScope suspend_tiling;
+            handler.prepare();
+        }
+        impl_detail::launch_assign_kernel<acc_type>(queue, getPtr(), handler, idx_type{0}, this->extent_[0]);
+        vector_.markModified();
+
+        impl_detail::finish_evaluation(queue);
+        return *this;
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {*this};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<ComponentExpression>();
+        key.append(offset_);
+        vector_.appendCacheKey(key);
+    }
+
+    value_type* getPtr() const
+    {
+        return vector_.getPtr() + offset_;
+    }
+};
+
+template<typename TVector>
+struct expr_traits<ComponentExpression<TVector>>
+{
+    using acc_type = typename expr_traits<TVector>::acc_type;
+    using queue_type = typename expr_traits<TVector>::queue_type;
+    using dim_type = typename expr_traits<TVector>::dim_type;
+    using idx_type = typename expr_traits<TVector>::idx_type;
+    using value_type = typename expr_traits<TVector>::value_type;
+    using eval_ret_type = typename expr_traits<TVector>::eval_ret_type;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
+
+//! State of a system with several components per element, e.g. position and velocity of oscillators,
+//! stored as structure of arrays: component c of element i is at c * n + i. For odeint and in
+//! expressions it is one Vector of size components * n, so all algebra operations are fused across the
+//! components; the system function assigns all components in one kernel:
+//!
+//!     enum { position, velocity };
+//!     dxdt.assign(x.component(velocity), -x.component(position) - 0.15 * x.component(velocity));
+template<typename TBuf, typename TQueue, typename TAcc, std::size_t TComponents>
+class StateBundle : public Vector<TBuf, TQueue, TAcc>
+{
+public:
+    using vector_type = Vector<TBuf, TQueue, TAcc>;
+    using idx_type = typename vector_type::idx_type;
+    using value_type = typename vector_type::value_type;
+    using component_type = ComponentExpression<vector_type>;
+
+    static constexpr std::size_t components = TComponents;
+
+public:
+    StateBundle() = default;
+
+    //! A bundle with size elements per component.
+    StateBundle(TQueue& queue, idx_type size = 1) : vector_type(queue, static_cast<idx_type>(TComponents) * size)
+    {
+    }
+
+    template<typename TOtherDerived>
+    StateBundle& operator=(ExpressionBase<TOtherDerived> const& other)
+    {
+        vector_type::operator=(other);
+        return *this;
+    }
+
+    //! Number of elements of each component.
+    idx_type componentSize() const
+    {
+        return this->extent_[0] / static_cast<idx_type>(TComponents);
+    }
+
+    component_type component(std::size_t c) const
+    {
+        return {*this, static_cast<idx_type>(c) * componentSize(), componentSize()};
+    }
+
+    //! Evaluates the expressions of all components in one kernel.
+    template<typename... TDerived>
+    StateBundle& assign(ExpressionBase<TDerived> const&... exprs)
+    {
+        static_assert(sizeof...(TDerived) == TComponents, "An expression is needed for every component");
+
+        idx_type const n = componentSize();
+        if(((exprs.getExtent()[0] != n) || ...))
+            throw std::invalid_argument("Extents of arguments are mismatched");
+
+        auto queue = this->getQueue();
+        impl_detail::EvaluationScope evaluation;
+        auto handlers = impl_detail::make_component_handlers(impl_detail::make_kernel_handler(exprs.derived())...);
+        {
+            impl_detail::TilingScope suspend_tiling;
+            handlers.prepare();
+        }
+
+        if(n > 0)
+        {
+            using dim_type = alpaka::Dim<TAcc>;
+            alpaka::Vec<dim_type, idx_type> const extent(n);
+            alpaka::WorkDivMembers<dim_type, idx_type> const workDiv(alpaka::getValidWorkDiv<TAcc>(
+                alpaka::getDev(queue),
+                extent,
+                idx_type{8u},
+                false,
+                alpaka::GridBlockExtentSubDivRestrictions::Unrestricted));
+
+            impl_detail::ComponentAssignKernel kernel;
+            alpaka::enqueue(queue, alpaka::createTaskKernel<TAcc>(workDiv, kernel, this->getPtr(), handlers, n));
+        }
+        this->markModified();
+
+        impl_detail::finish_evaluation(queue);
+        return *this;
+    }
+};
@@ -0,0 +1,388 @@
+#pragma once
+
+#include "1d_reduction.hpp"
+#include "expression_base.hpp"
+#include "flat_handler.hpp"
+#include "memoization.hpp"
+#include "tiling.hpp"
+#include "vector.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Number of stencil updates which are applied to a tile before it is written back
+#ifndef EXPR_TEMPORAL_BLOCK_DEPTH
+#    define EXPR_TEMPORAL_BLOCK_DEPTH 4u
+#endif
+
+template<typename TVector>
+class StencilWindow;
+
+namespace impl_detail
+{
+    // Temporal blocking: x = update(x) is applied k times to a tile and a halo of k times the reach of
+    // the stencil on each side while both stay in the cache, only the final tile is written back. The
+    // update is instantiated with a StencilWindow instead of the state, whose handler reads the per-thread
+    // window of the previous step. Before every step the kernel calls beginTile(window, first, last) with
+    // the range the step computes; Shift handlers forward it like cwise handlers, so every window leaf
+    // selects its source window and its first index from it.
+
+    //! Whether a tree can be evaluated on windows: point wise nodes, shifts and leaves which don't
+    //! depend on the state.
+    template<typename TExpr>
+    struct supports_temporal_blocking : std::false_type
+    {
+    };
+
+    template<typename TVector>
+    struct supports_temporal_blocking<StencilWindow<TVector>> : std::true_type
+    {
+    };
+
+    template<typename TBuf, typename TQueue, typename TAcc>
+    struct supports_temporal_blocking<Vector<TBuf, TQueue, TAcc>> : std::true_type
+    {
+    };
+
+    template<typename TQueue, typename TAcc, typename TGenerator>
+    struct supports_temporal_blocking<GeneratorExpression<TQueue, TAcc, TGenerator>> : std::true_type
+    {
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct supports_temporal_blocking<UnaryCwiseExpression<InnerExpr, Functor>> : supports_temporal_blocking<InnerExpr>
+    {
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct supports_temporal_blocking<BinaryCwiseExpression<Lhs, Rhs, Functor>>
+        : std::bool_constant<supports_temporal_blocking<Lhs>::value && supports_temporal_blocking<Rhs>::value>
+    {
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr>
+    struct supports_temporal_blocking<WhereExpression<Mask, TrueExpr, FalseExpr>>
+        : std::bool_constant<
+              supports_temporal_blocking<Mask>::value && supports_temporal_blocking<TrueExpr>::value
+              && supports_temporal_blocking<FalseExpr>::value>
+    {
+    };
+
+    template<typename InnerExpr, int shift>
+    struct supports_temporal_blocking<ShiftExpression<InnerExpr, shift>> : supports_temporal_blocking<InnerExpr>
+    {
+    };
+
+    //! Smallest and largest offset at which a tree reads its leaves, nested shifts add up.
+    template<typename TExpr>
+    struct stencil_reach
+    {
+        static constexpr int lo = 0;
+        static constexpr int hi = 0;
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct stencil_reach<UnaryCwiseExpression<InnerExpr, Functor>> : stencil_reach<InnerExpr>
+    {
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct stencil_reach<BinaryCwiseExpression<Lhs, Rhs, Functor>>
+    {
+        static constexpr int lo = std::min(stencil_reach<Lhs>::lo, stencil_reach<Rhs>::lo);
+        static constexpr int hi = std::max(stencil_reach<Lhs>::hi, stencil_reach<Rhs>::hi);
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr>
+    struct stencil_reach<WhereExpression<Mask, TrueExpr, FalseExpr>>
+    {
+        static constexpr int lo = std::min(
+            {stencil_reach<Mask>::lo, stencil_reach<TrueExpr>::lo, stencil_reach<FalseExpr>::lo});
+        static constexpr int hi = std::max(
+            {stencil_reach<Mask>::hi, stencil_reach<TrueExpr>::hi, stencil_reach<FalseExpr>::hi});
+    };
+
+    template<typename InnerExpr, int shift>
+    struct stencil_reach<ShiftExpression<InnerExpr, shift>>
+    {
+        static constexpr int lo = std::min(0, stencil_reach<InnerExpr>::lo + shift);
+        static constexpr int hi = std::max(0, stencil_reach<InnerExpr>::hi + shift);
+    };
+
+    template<typename TAcc>
+    constexpr bool use_temporal_blocking =
+#ifndef NOT_TEMPORAL_BLOCK_EXPR_EVAL
+        std::is_same_v<alpaka::Dev<TAcc>, alpaka::DevCpu>;
+#else
+        false;
+#endif
+
+    //! Elements which a tile [first, last) depends on after steps more updates, clamped to [0, N).
+    template<typename TIdx>
+    ALPAKA_FN_ACC void widen_tile(
+        TIdx first,
+        TIdx last,
+        TIdx steps,
+        TIdx left,
+        TIdx right,
+        TIdx numElements,
+        TIdx& lo,
+        TIdx& hi)
+    {
+        lo = (first > steps * left) ? first - steps * left : static_cast<TIdx>(0);
+        hi = (numElements - last > steps * right) ? last + steps * right : numElements;
+    }
+
+    //! Every grid thread owns two windows of the scratch and applies depth updates to its tiles, the
+    //! range which is computed shrinks by the reach of the stencil with every step.
+    class TemporalBlockingKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename TElem, typename TAccExprHandler, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            TElem const* const src,
+            TElem* const res,
+            TElem* const scratch,
+            TAccExprHandler update,
+            TIdx const& numElements,
+            TIdx const& tileSize,
+            TIdx const& stride,
+            TIdx const& depth,
+            TIdx const& left,
+            TIdx const& right) const -> void
+        {
+            static_assert(
+                alpaka::Dim<TAcc>::value == 1,
+                "The TemporalBlockingKernel expects 1-dimensional indices!");
+
+            TIdx const slot(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            TIdx const numSlots(alpaka::getWorkDiv<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+
+            for(TIdx first = slot * tileSize; first < numElements; first += numSlots * tileSize)
+            {
+                TIdx const last((numElements > first + tileSize) ? first + tileSize : numElements);
+
+                TIdx lo, hi;
+                widen_tile(first, last, depth, left, right, numElements, lo, hi);
+                TElem* const window = scratch + 2 * slot * stride;
+                for(TIdx i(lo); i < hi; ++i)
+                    window[i - lo] = src[i];
+
+                for(TIdx step = 1; step <= depth; ++step)
+                {
+                    widen_tile(first, last, depth - step, left, right, numElements, lo, hi);
+                    begin_tile(update, 2 * slot + (step - 1) % 2, lo, hi);
+
+                    if(step == depth)
+                    {
+                        for(TIdx i(first); i < last; ++i)
+                            res[i] = update.getValue(i);
+                    }
+                    else
+                    {
+                        TElem* const next = scratch + (2 * slot + step % 2) * stride;
+                        for(TIdx i(lo); i < hi; ++i)
+                            next[i - lo] = update.getValue(i);
+                    }
+                }
+            }
+        }
+    };
+} // namespace impl_detail
+
+//! Stands in for the state while an update is applied with temporal blocking. Its handler reads the
+//! window of the previous step, beginTile(window, first, last) selects the window for a step which
+//! computes [first, last).
+template<typename TVector>
+class StencilWindow : public ExpressionBase<StencilWindow<TVector>>
+{
+public:
+    using acc_type = typename TVector::acc_type;
+    using idx_type = typename TVector::idx_type;
+    using dim_type = typename TVector::dim_type;
+    using queue_type = typename TVector::queue_type;
+    using value_type = typename TVector::value_type;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+
+public:
+    struct AccExpressionHandler
+    {
+        value_type const* scratch_;
+        idx_type stride_;
+        idx_type left_;
+        value_type const* ptr_ = nullptr;
+        idx_type first_ = 0;
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            return ptr_[i - first_];
+        }
+
+        void prepare()
+        {
+        }
+
+        ALPAKA_FN_ACC void beginTile(idx_type window, idx_type first, idx_type /* last */)
+        {
+            ptr_ = scratch_ + window * stride_;
+            first_ = (first > left_) ? first - left_ : static_cast<idx_type>(0);
+        }
+    };
+
+private:
+    value_type const* scratch_;
+    idx_type stride_;
+    idx_type left_;
+
+public:
+    //! Windows of stride elements in scratch, a step reads left elements before the first one it computes.
+    StencilWindow(TVector const& state, value_type const* scratch, idx_type stride, idx_type left)
+        : scratch_(scratch)
+        , stride_(stride)
+        , left_(left)
+    {
+        this->queue_ = state.getQueue();
+        this->extent_ = state.getExtent();
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {scratch_, stride_, left_};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<StencilWindow>();
+        key.invalidate();
+    }
+};
+
+template<typename TVector>
+struct expr_traits<StencilWindow<TVector>>
+{
+    using acc_type = typename expr_traits<TVector>::acc_type;
+    using idx_type = typename expr_traits<TVector>::idx_type;
+    using dim_type = typename expr_traits<TVector>::dim_type;
+    using queue_type = typename expr_traits<TVector>::queue_type;
+    using value_type = typename expr_traits<TVector>::value_type;
+    using eval_ret_type = TVector;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
+
+//! Applies x = update(x) steps times, e.g. explicit diffusion on a chain:
+//!
+//!     advance_stencil(u, 1000, [=](auto const& u) {
+//!         using state = std::decay_t<decltype(u)>;
+//!         return u + c * (ShiftExpression<state, -1>(u) - 2.0 * u + ShiftExpression<state, 1>(u));
+//!     });
+//!
+//! update has to be generic and read the state only through its argument, point wise or through
+//! ShiftExpressions. On CPUs depth updates are applied to a tile in cache before it is written back,
+//! with the same results as updating step by step. Other devices (and NOT_TEMPORAL_BLOCK_EXPR_EVAL)
+//! update step by step.
+template<typename TBuf, typename TQueue, typename TAcc, typename TUpdate>
+void advance_stencil(
+    Vector<TBuf, TQueue, TAcc>& x,
+    std::size_t steps,
+    TUpdate const& update,
+    std::size_t depth = EXPR_TEMPORAL_BLOCK_DEPTH)
+{
+    using vector_type = Vector<TBuf, TQueue, TAcc>;
+    using window_type = StencilWindow<vector_type>;
+    using update_type = std::decay_t<decltype(update(std::declval<window_type const&>()))>;
+    using idx_type = typename vector_type::idx_type;
+    using value_type = typename vector_type::value_type;
+
+    static_assert(
+        impl_detail::supports_temporal_blocking<update_type>::value,
+        "The update may only contain cwise expressions, shifts and leaves");
+
+    if(depth == 0)
+        throw std::invalid_argument("The depth of temporal blocking has to be positive");
+
+    auto queue = x.getQueue();
+    idx_type const n = x.getExtent()[0];
+    vector_type tmp(queue, n);
+    vector_type* current = &x;
+    vector_type* next = &tmp;
+
+    if constexpr(!impl_detail::use_temporal_blocking<TAcc>)
+    {
+        for(std::size_t step = 0; step < steps; ++step)
+        {
+            *next = update(*current);
+            std::swap(current, next);
+        }
+    }
+    else if(n > 0)
+    {
+        auto const left = static_cast<idx_type>(-impl_detail::stencil_reach<update_type>::lo);
+        auto const right = static_cast<idx_type>(impl_detail::stencil_reach<update_type>::hi);
+        auto const halo = static_cast<idx_type>(depth) * (left + right);
+
+        // the two windows of a thread should fit into the cache together
+        auto tileSize = static_cast<idx_type>(EXPR_EVAL_TILE_BYTES / (2 * sizeof(value_type)));
+        tileSize = (tileSize > halo) ? tileSize - halo : static_cast<idx_type>(1);
+        tileSize = (tileSize > n) ? n : tileSize;
+        idx_type const stride = tileSize + halo;
+
+        auto slots = impl_detail::cpu_reduction_workers<TAcc, idx_type>(alpaka::getDev(queue));
+        idx_type const numTiles = (n + tileSize - 1) / tileSize;
+        slots = (slots > numTiles) ? numTiles : slots;
+
+        vector_type scratch(queue, 2 * slots * stride);
+        auto const workDiv = impl_detail::cpu_work_div<TAcc>(slots);
+
+        for(std::size_t done = 0; done < steps; done += depth)
+        {
+            auto const blockDepth = static_cast<idx_type>(std::min(depth, steps - done));
+
+            impl_detail::EvaluationScope evaluation;
+            auto const expr = update(window_type(*current, scratch.getPtr(), stride, left));
+            auto handler = impl_detail::make_kernel_handler(expr);
+            {
+                impl_detail::TilingScope suspend_tiling;
+                handler.prepare();
+            }
+
+            impl_detail::TemporalBlockingKernel kernel;
+            alpaka::enqueue(
+                queue,
+                alpaka::createTaskKernel<TAcc>(
+                    workDiv,
+                    kernel,
+                    current->getPtr(),
+                    next->getPtr(),
+                    scratch.getPtr(),
+                    handler,
+                    n,
+                    tileSize,
+                    stride,
+                    blockDepth,
+                    left,
+                    right));
+            next->markModified();
+            std::swap(current, next);
+        }
+    }
+
+    if(current != &x)
+        alpaka::memcpy(queue, x.getBuffer(), current->getConstBuffer());
+
+    // the temporaries are released when returning
+    alpaka::wait(queue);
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <alpaka/alpaka.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Bytes of the per-thread scratch which should stay in cache during tiled evaluation
+#ifndef EXPR_EVAL_TILE_BYTES
+#    define EXPR_EVAL_TILE_BYTES (256u * 1024u)
+#endif
+
+template<typename TBuf, typename TQueue, typename TAcc>
+class Vector;
+
+template<typename InnerExpr, typename Functor>
+class UnaryCwiseExpression;
+
+template<typename Lhs, typename Rhs, typename Functor>
+class BinaryCwiseExpression;
+
+template<typename InnerExpr>
+class MaterializeExpression;
+
+template<typename InnerExpr, int shift>
+class ShiftExpression;
+
+template<typename InnerExpr, typename Op>
+class Reduction1DExpression;
+
+template<typename InnerExpr, typename Op>
+class ScanExpression;
+
+template<typename Source, typename Indices>
+class GatherExpression;
+
+template<typename Mask, typename TrueExpr, typename FalseExpr>
+class WhereExpression;
+
+template<typename TQueue, typename TAcc>
+class BitMask;
+
+template<typename TQueue, typename TAcc, typename TDistribution>
+class RandomExpression;
+
+template<typename TQueue, typename TAcc, typename TGenerator>
+class GeneratorExpression;
+
+template<typename TVector>
+class ComponentExpression;
+
+template<typename TFunctor, typename TFirst, typename... TRest>
+class IndexedExpression;
+
+namespace impl_detail
+{
+    // Tiled evaluation: on CPU accelerators every thread evaluates the tree tile by tile. Before a tile
+    // is computed, beginTile(slot, first, last) is called on the handler, so MaterializeExpressions whose
+    // elements are only read at the index which is currently computed can evaluate their sub-tree for
+    // the tile into a per-thread scratch instead of a full-size temporary.
+    // Handlers of cwise expressions forward beginTile to their operands.
+
+    template<typename THandler, typename = void>
+    struct has_begin_tile : std::false_type
+    {
+    };
+
+    template<typename THandler>
+    struct has_begin_tile<
+        THandler,
+        std::void_t<decltype(std::declval<THandler&>().beginTile(std::size_t{}, std::size_t{}, std::size_t{}))>>
+        : std::true_type
+    {
+    };
+
+    template<typename THandler, typename TIdx>
+    ALPAKA_FN_ACC void begin_tile(THandler& handler, TIdx slot, TIdx first, TIdx last)
+    {
+        if constexpr(has_begin_tile<THandler>::value)
+            handler.beginTile(slot, first, last);
+    }
+
+    //! Set by the evaluator while the handlers of a tiled evaluation are prepared.
+    struct TilingContext
+    {
+        bool active = false;
+        std::size_t slots = 0;
+        std::size_t tile_size = 0;
+        //! Identifies the kernel whose handlers are prepared.
+        std::uint64_t pass = 0;
+    };
+
+    inline TilingContext& tiling_context()
+    {
+        thread_local TilingContext context;
+        return context;
+    }
+
+    //! Activates (or suspends) tiling for all handlers prepared during the lifetime of the scope.
+    class TilingScope
+    {
+        TilingContext saved_;
+
+    public:
+        TilingScope(bool active = false, std::size_t slots = 0, std::size_t tile_size = 0)
+            : saved_(tiling_context())
+        {
+            static std::atomic<std::uint64_t> passes{0};
+            tiling_context() = {active, slots, tile_size, active ? ++passes : 0};
+        }
+
+        TilingScope(TilingScope const&) = delete;
+        TilingScope& operator=(TilingScope const&) = delete;
+
+        ~TilingScope()
+        {
+            tiling_context() = saved_;
+        }
+    };
+
+    //! Whether all nodes of the tree know how to take part in a tiled evaluation.
+    //! Nodes which read their operands at other indices suspend tiling for their sub-tree.
+    template<typename TExpr>
+    struct supports_tiling : std::false_type
+    {
+    };
+
+    template<typename TBuf, typename TQueue, typename TAcc>
+    struct supports_tiling<Vector<TBuf, TQueue, TAcc>> : std::true_type
+    {
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct supports_tiling<UnaryCwiseExpression<InnerExpr, Functor>> : supports_tiling<InnerExpr>
+    {
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct supports_tiling<BinaryCwiseExpression<Lhs, Rhs, Functor>>
+        : std::bool_constant<supports_tiling<Lhs>::value && supports_tiling<Rhs>::value>
+    {
+    };
+
+    template<typename InnerExpr>
+    struct supports_tiling<MaterializeExpression<InnerExpr>> : supports_tiling<InnerExpr>
+    {
+    };
+
+    template<typename InnerExpr, int shift>
+    struct supports_tiling<ShiftExpression<InnerExpr, shift>> : std::true_type
+    {
+    };
+
+    template<typename InnerExpr, typename Op>
+    struct supports_tiling<Reduction1DExpression<InnerExpr, Op>> : std::true_type
+    {
+    };
+
+    template<typename InnerExpr, typename Op>
+    struct supports_tiling<ScanExpression<InnerExpr, Op>> : std::true_type
+    {
+    };
+
+    template<typename Source, typename Indices>
+    struct supports_tiling<GatherExpression<Source, Indices>> : std::true_type
+    {
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr>
+    struct supports_tiling<WhereExpression<Mask, TrueExpr, FalseExpr>>
+        : std::bool_constant<
+              supports_tiling<Mask>::value && supports_tiling<TrueExpr>::value && supports_tiling<FalseExpr>::value>
+    {
+    };
+
+    template<typename TQueue, typename TAcc>
+    struct supports_tiling<BitMask<TQueue, TAcc>> : std::true_type
+    {
+    };
+
+    template<typename TQueue, typename TAcc, typename TDistribution>
+    struct supports_tiling<RandomExpression<TQueue, TAcc, TDistribution>> : std::true_type
+    {
+    };
+
+    template<typename TQueue, typename TAcc, typename TGenerator>
+    struct supports_tiling<GeneratorExpression<TQueue, TAcc, TGenerator>> : std::true_type
+    {
+    };
+
+    template<typename TVector>
+    struct supports_tiling<ComponentExpression<TVector>> : std::true_type
+    {
+    };
+
+    template<typename TFunctor, typename TFirst, typename... TRest>
+    struct supports_tiling<IndexedExpression<TFunctor, TFirst, TRest...>> : std::true_type
+    {
+    };
+
+    //! Number of MaterializeExpressions which are evaluated tile by tile.
+    template<typename TExpr>
+    struct tiled_materializations : std::integral_constant<std::size_t, 0>
+    {
+    };
+
+    template<typename InnerExpr, typename Functor>
+    struct tiled_materializations<UnaryCwiseExpression<InnerExpr, Functor>> : tiled_materializations<InnerExpr>
+    {
+    };
+
+    template<typename Lhs, typename Rhs, typename Functor>
+    struct tiled_materializations<BinaryCwiseExpression<Lhs, Rhs, Functor>>
+        : std::integral_constant<
+              std::size_t,
+              tiled_materializations<Lhs>::value + tiled_materializations<Rhs>::value>
+    {
+    };
+
+    template<typename Mask, typename TrueExpr, typename FalseExpr>
+    struct tiled_materializations<WhereExpression<Mask, TrueExpr, FalseExpr>>
+        : std::integral_constant<
+              std::size_t,
+              tiled_materializations<Mask>::value + tiled_materializations<TrueExpr>::value
+                  + tiled_materializations<FalseExpr>::value>
+    {
+    };
+
+    template<typename InnerExpr>
+    struct tiled_materializations<MaterializeExpression<InnerExpr>>
+        : std::integral_constant<std::size_t, 1 + tiled_materializations<InnerExpr>::value>
+    {
+    };
+
+    template<typename TAcc, typename TExpr>
+    constexpr bool use_tiled_evaluation =
+#ifndef NOT_TILE_EXPR_EVAL
+        std::is_same_v<alpaka::Dev<TAcc>, alpaka::DevCpu> && supports_tiling<TExpr>::value
+        && (tiled_materializations<TExpr>::value > 0);
+#else
+        false;
+#endif
+} // namespace impl_detail
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "memoization.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Size of the chunks of asynchronous transfers, the host side copy of a chunk overlaps with the DMA of the
+// previous one
+#ifndef EXPR_TRANSFER_CHUNK_BYTES
+#    define EXPR_TRANSFER_CHUNK_BYTES (4u * 1024u * 1024u)
+#endif
+
+// Number of chunks of one transfer in flight, bounds the staging memory of a transfer
+#ifndef EXPR_TRANSFER_STAGING_BUFFERS
+#    define EXPR_TRANSFER_STAGING_BUFFERS 3u
+#endif
+
+namespace impl_detail
+{
+    //! Reusable pinned host buffers for the transfers to and from the devices of TAcc. Buffers are
+    //! handed out as leases and returned to the pool when the last lease is released, so repeated
+    //! transfers of the same size don't allocate (and pin) host memory again.
+    template<typename TAcc, typename T, typename TIdx>
+    class StagingPool
+    {
+    public:
+        using dim_type = alpaka::DimInt<1u>;
+        using buf_type = alpaka::Buf<alpaka::DevCpu, T, dim_type, TIdx>;
+        using lease_type = std::shared_ptr<buf_type>;
+
+    private:
+        std::mutex mutex_;
+        std::multimap<TIdx, buf_type> free_;
+
+        StagingPool() = default;
+
+    public:
+        static std::shared_ptr<StagingPool> instance()
+        {
+            // shared, so leases which outlive static destruction can still return their buffer
+            static std::shared_ptr<StagingPool> pool(new StagingPool);
+            return pool;
+        }
+
+        //! A buffer of at least size elements.
+        static lease_type acquire(TIdx size)
+        {
+            auto pool = instance();
+            std::optional<buf_type> buf;
+            {
+                std::lock_guard<std::mutex> lock(pool->mutex_);
+                auto it = pool->free_.lower_bound(size);
+                if(it != pool->free_.end())
+                {
+                    buf = std::move(it->second);
+                    pool->free_.erase(it);
+                }
+            }
+            if(!buf)
+            {
+                using pltf_type = alpaka::Pltf<alpaka::Dev<TAcc>>;
+                auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+                alpaka::Vec<dim_type, TIdx> const extent(size);
+                buf = alpaka::allocMappedBufIfSupported<pltf_type, T, TIdx>(devHost, extent);
+            }
+
+            std::weak_ptr<StagingPool> owner = pool;
+            return lease_type(
+                new buf_type(std::move(*buf)),
+                [owner](buf_type* released)
+                {
+                    if(auto pool = owner.lock())
+                    {
+                        std::lock_guard<std::mutex> lock(pool->mutex_);
+                        pool->free_.emplace(alpaka::getExtentVec(*released)[0], std::move(*released));
+                    }
+                    delete released;
+                });
+        }
+
+        //! Frees all buffers which are currently not leased.
+        static void clear()
+        {
+            auto pool = instance();
+            std::lock_guard<std::mutex> lock(pool->mutex_);
+            pool->free_.clear();
+        }
+    };
+} // namespace impl_detail
+
+//! Completion handle of an asynchronous transfer. The transfer is done when wait() returns; the handle
+//! keeps the staging buffers until then, and its destructor waits as well, so the host memory passed to
+//! the transfer must stay valid while the handle exists.
+template<typename TQueue, typename T>
+class TransferHandle
+{
+public:
+    using event_type = alpaka::Event<TQueue>;
+
+private:
+    //! A chunk which is in flight: downloads copy the staging buffer to the destination once the event is reached.
+    struct Chunk
+    {
+        event_type done;
+        std::shared_ptr<void> lease;
+        T const* staging = nullptr;
+        T* destination = nullptr;
+        std::size_t count = 0;
+    };
+
+    std::vector<Chunk> chunks_;
+    // write version of the destination of an upload, drawn anew once the data has arrived
+    std::shared_ptr<std::uint64_t> version_;
+
+public:
+    TransferHandle() = default;
+    TransferHandle(TransferHandle&&) = default;
+    TransferHandle& operator=(TransferHandle&& other)
+    {
+        wait();
+        chunks_ = std::move(other.chunks_);
+        version_ = std::move(other.version_);
+        return *this;
+    }
+    TransferHandle(TransferHandle const&) = delete;
+    TransferHandle& operator=(TransferHandle const&) = delete;
+
+    ~TransferHandle()
+    {
+        wait();
+    }
+
+    void addChunk(
+        event_type done,
+        std::shared_ptr<void> lease,
+        T const* staging = nullptr,
+        T* destination = nullptr,
+        std::size_t count = 0)
+    {
+        chunks_.push_back({std::move(done), std::move(lease), staging, destination, count});
+    }
+
+    //! Marks the destination as modified once the transfer is finished, so results which were memoized
+    //! while the data was in flight are not reused.
+    void invalidateOnCompletion(std::shared_ptr<std::uint64_t> version)
+    {
+        version_ = std::move(version);
+    }
+
+    //! Whether all chunks have reached the device (uploads) or the staging memory (downloads).
+    bool isComplete() const
+    {
+        return std::all_of(
+            chunks_.begin(),
+            chunks_.end(),
+            [](Chunk const& chunk) { return alpaka::isComplete(chunk.done); });
+    }
+
+    std::size_t numChunks() const
+    {
+        return chunks_.size();
+    }
+
+    //! Waits for one chunk, finishes it and releases its staging buffer.
+    void retire(std::size_t index)
+    {
+        auto& chunk = chunks_[index];
+        if(!chunk.lease)
+            return;
+        alpaka::wait(chunk.done);
+        if(chunk.destination)
+            std::copy(chunk.staging, chunk.staging + chunk.count, chunk.destination);
+        chunk.lease.reset();
+    }
+
+    //! Blocks until the transfer is finished and releases the staging buffers.
+    void wait()
+    {
+        for(std::size_t i = 0; i < chunks_.size(); ++i)
+            retire(i);
+        chunks_.clear();
+        if(version_)
+        {
+            *version_ = impl_detail::next_write_version();
+            version_.reset();
+        }
+    }
+};
+
+namespace impl_detail
+{
+    template<typename TAcc, typename TQueue, typename T, typename TIdx>
+    TransferHandle<TQueue, T> upload_staged(TQueue& queue, T* device, T const* host, TIdx count, TIdx chunkSize)
+    {
+        using pool_type = StagingPool<TAcc, T, std::size_t>;
+        using dim_type = alpaka::DimInt<1u>;
+
+        TransferHandle<TQueue, T> handle;
+        auto const dev = alpaka::getDev(queue);
+        for(TIdx first = 0; first < count; first += chunkSize)
+        {
+            // at most EXPR_TRANSFER_STAGING_BUFFERS chunks are in flight, their buffers are reused
+            if(handle.numChunks() >= EXPR_TRANSFER_STAGING_BUFFERS)
+                handle.retire(handle.numChunks() - EXPR_TRANSFER_STAGING_BUFFERS);
+
+            TIdx const n = std::min(chunkSize, count - first);
+            auto lease = pool_type::acquire(static_cast<std::size_t>(chunkSize));
+            T* const staging = alpaka::getPtrNative(*lease);
+
+            // the host copy of this chunk overlaps with the DMA of the previous ones
+            std::copy(host + first, host + first + n, staging);
+            alpaka::Vec<dim_type, TIdx> const extent(n);
+            auto stagingView = alpaka::createView(alpaka::getDevByIdx<alpaka::DevCpu>(0u), staging, extent);
+            auto deviceView = alpaka::createView(dev, device + first, extent);
+            alpaka::memcpy(queue, deviceView, stagingView, extent);
+
+            typename TransferHandle<TQueue, T>::event_type done(dev);
+            alpaka::enqueue(queue, done);
+            handle.addChunk(std::move(done), std::move(lease));
+        }
+        return handle;
+    }
+
+    template<typename TAcc, typename TQueue, typename T, typename TIdx>
+    TransferHandle<TQueue, T> download_staged(TQueue& queue, T* host, T const* device, TIdx count, TIdx chunkSize)
+    {
+        using pool_type = StagingPool<TAcc, T, std::size_t>;
+        using dim_type = alpaka::DimInt<1u>;
+
+        TransferHandle<TQueue, T> handle;
+        auto const dev = alpaka::getDev(queue);
+        for(TIdx first = 0; first < count; first += chunkSize)
+        {
+            // at most EXPR_TRANSFER_STAGING_BUFFERS chunks are in flight, their buffers are reused
+            if(handle.numChunks() >= EXPR_TRANSFER_STAGING_BUFFERS)
+                handle.retire(handle.numChunks() - EXPR_TRANSFER_STAGING_BUFFERS);
+
+            TIdx const n = std::min(chunkSize, count - first);
+            auto lease = pool_type::acquire(static_cast<std::size_t>(chunkSize));
+            T* const staging = alpaka::getPtrNative(*lease);
+
+            alpaka::Vec<dim_type, TIdx> const extent(n);
+            auto stagingView = alpaka::createView(alpaka::getDevByIdx<alpaka::DevCpu>(0u), staging, extent);
+            auto deviceView = alpaka::createView(dev, const_cast<T*>(device) + first, extent);
+            alpaka::memcpy(queue, stagingView, deviceView, extent);
+
+            typename TransferHandle<TQueue, T>::event_type done(dev);
+            alpaka::enqueue(queue, done);
+            handle.addChunk(std::move(done), std::move(lease), staging, host + first, static_cast<std::size_t>(n));
+        }
+        return handle;
+    }
+} // namespace impl_detail
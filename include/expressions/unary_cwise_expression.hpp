@@ -1,5 +1,8 @@
 #pragma once
 
+#include "memoization.hpp"
+#include "tiling.hpp"
+
 #include <alpaka/alpaka.hpp>
 
 #include <memory>
@@ -10,6 +13,12 @@ class ExpressionBase;
 template<typename TDerived>
 struct expr_traits;
 
+template<typename TBuf, typename TQueue, typename TAcc>
+class Vector;
+
+template<typename TExpr>
+struct SinCosFunctor;
+
 template<typename InnerExpr, typename Functor>
 class UnaryCwiseExpression : public ExpressionBase<UnaryCwiseExpression<InnerExpr, Functor>>
 {
@@ -40,6 +49,11 @@ public:
         {
             inner_.prepare();
         }
+
+        ALPAKA_FN_ACC void beginTile(idx_type slot, idx_type first, idx_type last)
+        {
+            impl_detail::begin_tile(inner_, slot, first, last);
+        }
     };
 
 private:
@@ -57,6 +71,30 @@ public:
     {
         return {expr_.getHandler(), functor_};
     }
+
+    InnerExpr const& getInner() const
+    {
+        return expr_;
+    }
+
+    Functor const& getFunctor() const
+    {
+        return functor_;
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        expr_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<UnaryCwiseExpression>();
+        key.appendFunctor(functor_);
+        impl_detail::append_cache_key(expr_, key);
+    }
 };
 
 template<typename InnerExpr, typename Functor>
@@ -70,4 +108,36 @@ struct expr_traits<UnaryCwiseExpression<InnerExpr, Functor>>
     using eval_ret_type = typename expr_traits<InnerExpr>::eval_ret_type;
     constexpr static bool is_binary_op = false;
     constexpr static bool is_lazy_evaluatable = true;
-};
\ No newline at end of file
+};
+
+namespace impl_detail
+{
+    //! Container for the elements of type T of a tree which is evaluated into TContainer. Containers other
+    //! than Vector keep their type.
+    template<typename TContainer, typename T>
+    struct rebind_elem
+    {
+        using type = TContainer;
+    };
+
+    template<typename TBuf, typename TQueue, typename TAcc, typename T>
+    struct rebind_elem<Vector<TBuf, TQueue, TAcc>, T>
+    {
+        using type = Vector<alpaka::Buf<TAcc, T, alpaka::Dim<TBuf>, alpaka::Idx<TBuf>>, TQueue, TAcc>;
+    };
+} // namespace impl_detail
+
+//! Pairs of sine and cosine are evaluated into a vector of SinCos elements.
+template<typename InnerExpr, typename T>
+struct expr_traits<UnaryCwiseExpression<InnerExpr, SinCosFunctor<T>>>
+{
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename SinCosFunctor<T>::return_type;
+    using eval_ret_type =
+        typename impl_detail::rebind_elem<typename expr_traits<InnerExpr>::eval_ret_type, value_type>::type;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
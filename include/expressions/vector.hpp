@@ -1,10 +1,16 @@
 #pragma once
 
 #include "expression_base.hpp"
+#include "memoization.hpp"
+#include "transfer.hpp"
 
 #include <alpaka/alpaka.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <type_traits>
 
 template<typename TBuf, typename TQueue, typename TAcc>
 class Vector : public ExpressionBase<Vector<TBuf, TQueue, TAcc>>
@@ -34,13 +40,16 @@ public:
 
         void prepare()
         {
-            ptr_ = alpaka::getPtrNative(vector_.getBuffer());
+            ptr_ = vector_.getPtr();
         }
     };
 
 private:
     // Internally this is a shared pointer.
     mutable std::optional<TBuf> buff_;
+    // Write version of the buffer, shared by all copies. Vectors over buffers which are passed in
+    // by the user have none, because they can be modified behind our back, and are never cached.
+    std::shared_ptr<std::uint64_t> version_;
 
 public:
     Vector() = default;
@@ -83,16 +92,137 @@ public:
         return {*this};
     }
 
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+    }
+
+    //! Write access to the buffer, marks the vector as modified.
     TBuf& getBuffer() const
+    {
+        markModified();
+        return *buff_;
+    }
+
+    //! Read only access to the buffer.
+    TBuf const& getConstBuffer() const
     {
         return *buff_;
     }
 
+    //! Invalidates memoized results which depend on the vector,
+    //! has to be called after the data was modified through getPtr().
+    void markModified() const
+    {
+        if(version_)
+            *version_ = impl_detail::next_write_version();
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<Vector>();
+        key.append(getPtr());
+        key.append(this->extent_[0]);
+        if(version_)
+            key.append(*version_);
+        else
+            key.invalidate();
+    }
+
+    value_type* getPtr() const
+    {
+        return alpaka::getPtrNative(*buff_);
+    }
+
     alpaka::Dev<TBuf> getDevice() const
     {
         return alpaka::getDev(*buff_);
     }
 
+    using transfer_handle = TransferHandle<TQueue, value_type>;
+
+    //! Copies count elements from host to the elements [offset, offset + count) on the given queue, e.g. a
+    //! copy queue, so the transfer overlaps with kernels which are enqueued on the queue of the vector later.
+    //! It starts after the work which is already enqueued there. The host memory is staged through pinned
+    //! buffers of a reusable pool in chunks of EXPR_TRANSFER_CHUNK_BYTES. If the device is the host, the data
+    //! is copied directly and the returned handle is already complete. Memoized results are invalidated
+    //! when the transfer starts and again when the handle is waited on.
+    transfer_handle upload_async(TQueue& queue, value_type const* host, idx_type count, idx_type offset = 0)
+    {
+        markModified();
+        if constexpr(std::is_same_v<alpaka::Dev<TBuf>, alpaka::DevCpu>)
+        {
+            // kernels which are still running might use the old data
+            waitForQueues(queue);
+            std::copy(host, host + count, getPtr() + offset);
+            return {};
+        }
+        else
+        {
+            followOwnQueue(queue);
+            auto handle = impl_detail::upload_staged<TAcc>(queue, getPtr() + offset, host, count, chunkSize());
+            handle.invalidateOnCompletion(version_);
+            return handle;
+        }
+    }
+
+    transfer_handle upload_async(value_type const* host, idx_type count, idx_type offset = 0)
+    {
+        auto queue = this->getQueue();
+        return upload_async(queue, host, count, offset);
+    }
+
+    //! Copies the elements [offset, offset + count) to host on the given queue after the work which is
+    //! already enqueued on the queue of the vector. The data is in host once wait() of the returned handle
+    //! returns.
+    transfer_handle download_async(TQueue& queue, value_type* host, idx_type count, idx_type offset = 0) const
+    {
+        if constexpr(std::is_same_v<alpaka::Dev<TBuf>, alpaka::DevCpu>)
+        {
+            // kernels which are still running might write the data
+            waitForQueues(queue);
+            std::copy(getPtr() + offset, getPtr() + offset + count, host);
+            return {};
+        }
+        else
+        {
+            followOwnQueue(queue);
+            return impl_detail::download_staged<TAcc>(queue, host, getPtr() + offset, count, chunkSize());
+        }
+    }
+
+    transfer_handle download_async(value_type* host, idx_type count, idx_type offset = 0) const
+    {
+        auto queue = this->getQueue();
+        return download_async(queue, host, count, offset);
+    }
+
+private:
+    //! Waits for the work on the given queue and on the queue of the vector.
+    void waitForQueues(TQueue& queue) const
+    {
+        auto own = this->getQueue();
+        alpaka::wait(own);
+        alpaka::wait(queue);
+    }
+
+    //! Makes the given queue wait for the work which is already enqueued on the queue of the vector.
+    void followOwnQueue(TQueue& queue) const
+    {
+        auto own = this->getQueue();
+        alpaka::Event<TQueue> enqueued(getDevice());
+        alpaka::enqueue(own, enqueued);
+        alpaka::wait(queue, enqueued);
+    }
+
+public:
+    static idx_type chunkSize()
+    {
+        auto const elements = static_cast<idx_type>(EXPR_TRANSFER_CHUNK_BYTES / sizeof(value_type));
+        return elements > 0 ? elements : 1;
+    }
+
     template<class TSize>
     void adjust_size(TSize new_size)
     {
@@ -105,6 +235,7 @@ public:
 
         auto dev = alpaka::getDev(*this->queue_);
         buff_ = alpaka::allocBuf<value_type, idx_type>(dev, this->extent_);
+        version_ = std::make_shared<std::uint64_t>(impl_detail::next_write_version());
     }
 
     template<class TSize>
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "memoization.hpp"
+#include "tiling.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <stdexcept>
+#include <type_traits>
+
+template<typename TDerived>
+class ExpressionBase;
+
+template<typename TDerived>
+struct expr_traits;
+
+//! Element wise selection: y_i = mask_i ? a_i : b_i.
+//!
+//! Both branches are evaluated for every element and the result is selected afterwards, so the node
+//! compiles to a select (or a blend on SIMD units) instead of a divergent branch. The mask is any
+//! expression convertible to bool, e.g. a comparison or a BitMask.
+template<typename Mask, typename TrueExpr, typename FalseExpr>
+class WhereExpression : public ExpressionBase<WhereExpression<Mask, TrueExpr, FalseExpr>>
+{
+public:
+    using acc_type = typename TrueExpr::acc_type;
+    using idx_type = typename TrueExpr::idx_type;
+    using dim_type = typename TrueExpr::dim_type;
+    using queue_type = typename TrueExpr::queue_type;
+    using value_type = std::common_type_t<typename TrueExpr::value_type, typename FalseExpr::value_type>;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+
+public:
+    struct AccExpressionHandler
+    {
+        using mask_handler = typename Mask::AccExpressionHandler;
+        using true_handler = typename TrueExpr::AccExpressionHandler;
+        using false_handler = typename FalseExpr::AccExpressionHandler;
+
+        mask_handler mask_;
+        true_handler true_;
+        false_handler false_;
+
+        AccExpressionHandler(mask_handler mask, true_handler onTrue, false_handler onFalse)
+            : mask_{mask}
+            , true_{onTrue}
+            , false_{onFalse}
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            auto const a = static_cast<value_type>(true_.getValue(i));
+            auto const b = static_cast<value_type>(false_.getValue(i));
+            return static_cast<bool>(mask_.getValue(i)) ? a : b;
+        }
+
+        void prepare()
+        {
+            mask_.prepare();
+            true_.prepare();
+            false_.prepare();
+        }
+
+        ALPAKA_FN_ACC void beginTile(idx_type slot, idx_type first, idx_type last)
+        {
+            impl_detail::begin_tile(mask_, slot, first, last);
+            impl_detail::begin_tile(true_, slot, first, last);
+            impl_detail::begin_tile(false_, slot, first, last);
+        }
+    };
+
+private:
+    Mask mask_;
+    TrueExpr true_;
+    FalseExpr false_;
+
+public:
+    WhereExpression(Mask const& mask, TrueExpr const& onTrue, FalseExpr const& onFalse)
+        : mask_(mask)
+        , true_(onTrue)
+        , false_(onFalse)
+    {
+        this->queue_ = onTrue.getQueue();
+
+        // operands with one element are broadcast like in binary expressions
+        extent_type extent(1);
+        for(auto const& operand : {mask.getExtent(), onTrue.getExtent(), onFalse.getExtent()})
+        {
+            if(operand[0] == 1)
+                continue;
+            if(extent[0] != 1 && extent != operand)
+                throw std::invalid_argument("Extents of arguments are mismatched");
+            extent = operand;
+        }
+        this->extent_ = extent;
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {mask_.getHandler(), true_.getHandler(), false_.getHandler()};
+    }
+
+    Mask const& getMask() const
+    {
+        return mask_;
+    }
+
+    TrueExpr const& getTrue() const
+    {
+        return true_;
+    }
+
+    FalseExpr const& getFalse() const
+    {
+        return false_;
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        mask_.visit(visitor);
+        true_.visit(visitor);
+        false_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<WhereExpression>();
+        impl_detail::append_cache_key(mask_, key);
+        impl_detail::append_cache_key(true_, key);
+        impl_detail::append_cache_key(false_, key);
+    }
+};
+
+template<typename Mask, typename TrueExpr, typename FalseExpr>
+struct expr_traits<WhereExpression<Mask, TrueExpr, FalseExpr>>
+{
+    using acc_type = typename expr_traits<TrueExpr>::acc_type;
+    using idx_type = typename expr_traits<TrueExpr>::idx_type;
+    using dim_type = typename expr_traits<TrueExpr>::dim_type;
+    using queue_type = typename expr_traits<TrueExpr>::queue_type;
+    using value_type = std::common_type_t<
+        typename expr_traits<TrueExpr>::value_type,
+        typename expr_traits<FalseExpr>::value_type>;
+    using eval_ret_type = typename expr_traits<TrueExpr>::eval_ret_type;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = expr_traits<Mask>::is_lazy_evaluatable
+                                                && expr_traits<TrueExpr>::is_lazy_evaluatable
+                                                && expr_traits<FalseExpr>::is_lazy_evaluatable;
+};
@@ -0,0 +1,448 @@
+#pragma once
+
+#include "../expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Attempts which are enqueued before the first synchronization, later the number of attempts is
+// estimated from the previous observation interval
+#ifndef EXPR_ADAPTIVE_INITIAL_ATTEMPTS
+#    define EXPR_ADAPTIVE_INITIAL_ATTEMPTS 8u
+#endif
+
+// Accepted and rejected steps per observation interval after which integrate_device_adaptive gives up,
+// like the max_step_checker of odeint's integrate functions
+#ifndef EXPR_ADAPTIVE_MAX_ATTEMPTS
+#    define EXPR_ADAPTIVE_MAX_ATTEMPTS 500u
+#endif
+
+//! Step size control of integrate_device_adaptive, it lives in device memory.
+template<typename T>
+struct StepControl
+{
+    T t; //!< time of the state
+    T dt; //!< proposed step size
+    T dt_step; //!< step size of the next attempt, dt clamped to the next observation
+    T t_end; //!< time of the next observation
+    std::uint32_t accepted; //!< whether the last attempt was accepted
+    std::uint32_t steps; //!< accepted steps
+    std::uint32_t rejections; //!< rejected attempts
+};
+
+//! Counters of integrate_device_adaptive.
+struct DeviceAdaptiveStatistics
+{
+    std::size_t steps = 0; //!< accepted steps
+    std::size_t rejections = 0; //!< rejected attempts
+    std::size_t attempts = 0; //!< enqueued attempts, including idle ones after an observation was reached
+    std::size_t synchronizations = 0; //!< copies of the step size control to the host
+};
+
+namespace impl_detail
+{
+    // Device resident step size control: the attempts of Dormand-Prince 5(4) are enqueued without
+    // knowing whether they will be accepted. The step size enters the stage expressions through
+    // StepScaleFunctors and the stage times through StepControlExpression leaves, which read the
+    // StepControl in device memory. A single thread kernel reduces the error norm, accepts or
+    // rejects and adapts the step like odeint's default_step_adjuster; the state and the FSAL
+    // derivative are then replaced by the candidates if the attempt was accepted. Attempts after the
+    // next observation time is reached are idle. The host only copies the StepControl to check
+    // whether the observation time is reached.
+
+    //! Stage time t + c * dt_step.
+    template<typename T>
+    struct StageTimeField
+    {
+        T c;
+
+        ALPAKA_FN_HOST_ACC auto operator()(StepControl<T> const& control) const -> T
+        {
+            return control.t + c * control.dt_step;
+        }
+    };
+
+    //! 1 if the last attempt was accepted, 0 otherwise.
+    template<typename T>
+    struct AcceptedField
+    {
+        ALPAKA_FN_HOST_ACC auto operator()(StepControl<T> const& control) const -> T
+        {
+            return control.accepted ? T(1) : T(0);
+        }
+    };
+
+    //! factor * dt_step * x
+    template<typename T>
+    struct StepScaleFunctor
+    {
+        using return_type = T;
+
+        StepControl<T> const* control;
+        T factor;
+
+        ALPAKA_FN_ACC auto operator()(T x) const -> return_type
+        {
+            return factor * control->dt_step * x;
+        }
+    };
+
+    //! The step size of the next attempt.
+    template<typename T>
+    ALPAKA_FN_ACC void clamp_step(StepControl<T>& control)
+    {
+        T const remaining = control.t_end - control.t;
+        control.dt_step = (remaining > T(0)) ? ((control.dt < remaining) ? control.dt : remaining) : T(0);
+    }
+
+    //! Starts the observation interval which ends at t_end.
+    class BeginIntervalKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename T>
+        ALPAKA_FN_ACC auto operator()(TAcc const& /* acc */, StepControl<T>* const control, T t_end) const -> void
+        {
+            control->t_end = t_end;
+            clamp_step(*control);
+        }
+    };
+
+    //! Combines the partial maxima of the error norm, accepts or rejects the attempt and adapts the
+    //! step size of Dormand-Prince 5(4) (order 5, error order 4).
+    class StepControlKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename T, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            StepControl<T>* const control,
+            T const* const partials,
+            TIdx const& numPartials) const -> void
+        {
+            StepControl<T>& c = *control;
+
+            // idle attempt, the observation time is already reached
+            if(c.dt_step == T(0))
+            {
+                c.accepted = 0;
+                return;
+            }
+
+            T error = partials[0];
+            for(TIdx i = 1; i < numPartials; ++i)
+                error = (partials[i] > error) ? partials[i] : error;
+
+            if(error <= T(1))
+            {
+                // a step which was clamped to the observation ends exactly there
+                c.t = (c.dt_step < c.t_end - c.t) ? c.t + c.dt_step : c.t_end;
+                c.dt = c.dt_step;
+                if(error < T(0.5))
+                {
+                    T const smallest = T(1.0 / 3125.0); // 5^-5
+                    error = (error > smallest) ? error : smallest;
+                    c.dt *= T(0.9) * alpaka::math::pow(acc, error, T(-1.0 / 5.0));
+                }
+                c.accepted = 1;
+                ++c.steps;
+            }
+            else
+            {
+                // also taken for NaN errors
+                T const factor = T(0.9) * alpaka::math::pow(acc, error, T(-1.0 / 3.0));
+                c.dt = c.dt_step * ((factor > T(0.2)) ? factor : T(0.2));
+                c.accepted = 0;
+                ++c.rejections;
+            }
+            clamp_step(c);
+        }
+    };
+
+    template<typename TAcc, typename TQueue, typename TKernel, typename... TArgs>
+    void launch_single_thread(TQueue& queue, TKernel const& kernel, TArgs&&... args)
+    {
+        using Idx = alpaka::Idx<TAcc>;
+        alpaka::WorkDivMembers<alpaka::Dim<TAcc>, Idx> const workDiv{
+            static_cast<Idx>(1),
+            static_cast<Idx>(1),
+            static_cast<Idx>(1)};
+        alpaka::enqueue(queue, alpaka::createTaskKernel<TAcc>(workDiv, kernel, std::forward<TArgs>(args)...));
+    }
+} // namespace impl_detail
+
+//! Broadcasts a value computed from the StepControl in device memory, e.g. the time of a stage.
+//! It is a leaf like a scalar and doesn't read any vector.
+template<typename TQueue, typename TAcc, typename T, typename TField>
+class StepControlExpression : public ExpressionBase<StepControlExpression<TQueue, TAcc, T, TField>>
+{
+public:
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using value_type = T;
+
+public:
+    struct AccExpressionHandler
+    {
+        StepControl<T> const* control_;
+        TField field_;
+
+        ALPAKA_FN_ACC auto getValue(idx_type /* i */) const -> value_type
+        {
+            return field_(*control_);
+        }
+
+        void prepare()
+        {
+        }
+    };
+
+private:
+    StepControl<T> const* control_;
+    TField field_;
+
+public:
+    StepControlExpression(TQueue const& queue, StepControl<T> const* control, TField const& field)
+        : control_(control)
+        , field_(field)
+    {
+        this->queue_ = queue;
+        this->extent_[0] = 1;
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {control_, field_};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        // the value changes on the device without a write version
+        key.appendType<StepControlExpression>();
+        key.invalidate();
+    }
+};
+
+template<typename TQueue, typename TAcc, typename T, typename TField>
+struct expr_traits<StepControlExpression<TQueue, TAcc, T, TField>>
+{
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using value_type = T;
+    using eval_ret_type = Vector<alpaka::Buf<TAcc, value_type, dim_type, idx_type>, TQueue, TAcc>;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
+
+namespace impl_detail
+{
+    template<typename TQueue, typename TAcc, typename T, typename TField>
+    struct is_pointwise_node<StepControlExpression<TQueue, TAcc, T, TField>> : std::true_type
+    {
+    };
+} // namespace impl_detail
+
+//! Integrates dxdt = system(x, t) with Dormand-Prince 5(4) from t0 to t1 and calls observer(x, t) at
+//! t0, t0 + dt_observe, ... like odeint's integrate_const with make_controlled(eps_abs, eps_rel,
+//! runge_kutta_dopri5), but the error norm, the step size and the decision to accept a step stay on
+//! the device. The host enqueues attempts without waiting for them and only synchronizes to find out
+//! whether the next observation time is reached, so the queue runs many steps ahead.
+//!
+//! system(x, dxdt, t) is called with t as an expression which broadcasts the time of the stage on the
+//! device, if it accepts one. Otherwise it gets the time of the last observation and has to be
+//! autonomous. Returns the counters of steps, rejections and synchronizations.
+template<typename TSystem, typename TBuf, typename TQueue, typename TAcc, typename TObserver>
+DeviceAdaptiveStatistics integrate_device_adaptive(
+    TSystem system,
+    Vector<TBuf, TQueue, TAcc>& x,
+    double t0,
+    double t1,
+    double dt_observe,
+    double dt,
+    TObserver observer,
+    double eps_abs = 1e-6,
+    double eps_rel = 1e-6)
+{
+    using vector_type = Vector<TBuf, TQueue, TAcc>;
+    using value_type = typename vector_type::value_type;
+    using idx_type = typename vector_type::idx_type;
+    using dim_type = typename vector_type::dim_type;
+    using T = value_type;
+    using control_type = StepControl<T>;
+    using time_type = StepControlExpression<TQueue, TAcc, T, impl_detail::StageTimeField<T>>;
+    using accepted_type = StepControlExpression<TQueue, TAcc, T, impl_detail::AcceptedField<T>>;
+
+    if(!(dt_observe > 0.0) || !(dt > 0.0))
+        throw std::invalid_argument("The observation interval and the initial step have to be positive");
+
+    auto queue = x.getQueue();
+    auto const devAcc = alpaka::getDev(queue);
+    auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+    idx_type const n = x.getExtent()[0];
+    DeviceAdaptiveStatistics statistics;
+
+    alpaka::Vec<dim_type, idx_type> const one(static_cast<idx_type>(1));
+    auto controlBuf = alpaka::allocBuf<control_type, idx_type>(devAcc, one);
+    auto hostControlBuf = alpaka::allocBuf<control_type, idx_type>(devHost, one);
+    control_type* const control = alpaka::getPtrNative(controlBuf);
+    control_type& hostControl = *alpaka::getPtrNative(hostControlBuf);
+    hostControl = {T(t0), T(dt), T(0), T(t0), 0u, 0u, 0u};
+    alpaka::memcpy(queue, controlBuf, hostControlBuf);
+
+    observer(x, t0);
+    if(n == 0)
+        return statistics;
+
+    alpaka::Vec<dim_type, idx_type> const partialsExtent(impl_detail::reduction_buffer_size<TAcc>(devAcc, n));
+    auto partialsBuf = alpaka::allocBuf<T, idx_type>(devAcc, partialsExtent);
+    T* const partials = alpaka::getPtrNative(partialsBuf);
+    auto const numPartials = impl_detail::reduction_partials<TAcc>(devAcc, n);
+
+    vector_type stage(queue, n), xnew(queue, n);
+    vector_type k1(queue, n), k2(queue, n), k3(queue, n), k4(queue, n), k5(queue, n), k6(queue, n), k7(queue, n);
+
+    auto const h = [control](auto const& expr, T factor)
+    { return expr.apply(impl_detail::StepScaleFunctor<T>{control, factor}); };
+    auto const stage_time = [&queue, control](T c) { return time_type(queue, control, {c}); };
+    accepted_type const accepted(queue, control, {});
+
+    double observed = t0;
+    auto const rhs = [&](vector_type const& state, vector_type& dxdt, T c)
+    {
+        if constexpr(std::is_invocable_v<TSystem&, vector_type const&, vector_type&, time_type const&>)
+            system(state, dxdt, stage_time(c));
+        else
+            system(state, dxdt, observed);
+    };
+
+    // Dormand-Prince 5(4), the coefficients of odeint's runge_kutta_dopri5
+    auto const attempt = [&]()
+    {
+        stage = x + h(T(1.0 / 5) * k1, T(1));
+        rhs(stage, k2, T(1.0 / 5));
+        stage = x + h(T(3.0 / 40) * k1 + T(9.0 / 40) * k2, T(1));
+        rhs(stage, k3, T(3.0 / 10));
+        stage = x + h(T(44.0 / 45) * k1 - T(56.0 / 15) * k2 + T(32.0 / 9) * k3, T(1));
+        rhs(stage, k4, T(4.0 / 5));
+        stage = x
+                + h(T(19372.0 / 6561) * k1 - T(25360.0 / 2187) * k2 + T(64448.0 / 6561) * k3
+                        - T(212.0 / 729) * k4,
+                    T(1));
+        rhs(stage, k5, T(8.0 / 9));
+        stage = x
+                + h(T(9017.0 / 3168) * k1 - T(355.0 / 33) * k2 + T(46732.0 / 5247) * k3 + T(49.0 / 176) * k4
+                        - T(5103.0 / 18656) * k5,
+                    T(1));
+        rhs(stage, k6, T(1));
+        xnew = x
+               + h(T(35.0 / 384) * k1 + T(500.0 / 1113) * k3 + T(125.0 / 192) * k4 - T(2187.0 / 6784) * k5
+                       + T(11.0 / 84) * k6,
+                   T(1));
+        rhs(xnew, k7, T(1));
+
+        // max_i |err_i| / (eps_abs + eps_rel * (|x_i| + dt |dxdt_i|)) like odeint's default_error_checker
+        auto const error = abs(h(
+                               T(35.0 / 384 - 5179.0 / 57600) * k1 + T(500.0 / 1113 - 7571.0 / 16695) * k3
+                                   + T(125.0 / 192 - 393.0 / 640) * k4 + T(-2187.0 / 6784 + 92097.0 / 339200) * k5
+                                   + T(11.0 / 84 - 187.0 / 2100) * k6 + T(-1.0 / 40) * k7,
+                               T(1)))
+                           / (T(eps_abs) + T(eps_rel) * (abs(x) + h(abs(k1), T(1))));
+        {
+            impl_detail::EvaluationScope evaluation;
+            auto handler = impl_detail::make_kernel_handler(error);
+            {
+                impl_detail::TilingScope suspend_tiling;
+                handler.prepare();
+            }
+            impl_detail::enqueue_reduce<T, idx_type, dim_type, TAcc>(
+                devAcc,
+                queue,
+                n,
+                handler,
+                MaxFunctor<T, T>{},
+                partials);
+        }
+        impl_detail::launch_single_thread<TAcc>(
+            queue,
+            impl_detail::StepControlKernel{},
+            control,
+            partials,
+            numPartials);
+
+        defer(x, where(accepted, xnew, x)).then(k1, where(accepted, k7, k1)).flush();
+    };
+
+    {
+        impl_detail::AsyncEvaluationScope async;
+
+        rhs(x, k1, T(0));
+
+        std::size_t batch = EXPR_ADAPTIVE_INITIAL_ATTEMPTS;
+        auto const intervals = static_cast<std::size_t>(std::floor((t1 - t0) / dt_observe * (1.0 + 1e-12)));
+        for(std::size_t interval = 1; interval <= intervals; ++interval)
+        {
+            double const t_end = t0 + static_cast<double>(interval) * dt_observe;
+            impl_detail::launch_single_thread<TAcc>(queue, impl_detail::BeginIntervalKernel{}, control, T(t_end));
+
+            std::size_t const before = hostControl.steps + hostControl.rejections;
+            double const t_begin = observed;
+            while(true)
+            {
+                for(std::size_t a = 0; a < batch; ++a)
+                    attempt();
+                statistics.attempts += batch;
+
+                alpaka::memcpy(queue, hostControlBuf, controlBuf);
+                alpaka::wait(queue);
+                impl_detail::release_temporaries();
+                ++statistics.synchronizations;
+
+                std::size_t const used = hostControl.steps + hostControl.rejections - before;
+                if(hostControl.t >= T(t_end))
+                {
+                    batch = (used > 0) ? used : 1;
+                    break;
+                }
+                // e.g. a NaN in the state rejects every attempt until the step size underflows to zero,
+                // the queue is idle here
+                if(used >= EXPR_ADAPTIVE_MAX_ATTEMPTS || hostControl.dt_step == T(0))
+                    throw std::runtime_error("The step size control doesn't reach the next observation within "
+                                             "EXPR_ADAPTIVE_MAX_ATTEMPTS attempts");
+
+                // as many attempts as the same rate needs for the rest of the interval
+                double const done = static_cast<double>(hostControl.t) - t_begin;
+                double const rest = t_end - static_cast<double>(hostControl.t);
+                batch = (done > 0.0) ? static_cast<std::size_t>(std::ceil(used * rest / done)) : batch;
+                batch = (batch > 0) ? batch : 1;
+                batch = std::min<std::size_t>(batch, EXPR_ADAPTIVE_MAX_ATTEMPTS - used);
+            }
+
+            observed = t_end;
+            observer(x, t_end);
+        }
+    }
+
+    alpaka::wait(queue);
+    impl_detail::release_temporaries();
+    statistics.steps = hostControl.steps;
+    statistics.rejections = hostControl.rejections;
+    return statistics;
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include "../expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! Integration state which is stored next to the vectors of a checkpoint.
+struct CheckpointMetadata
+{
+    double time = 0.0;
+    std::string stepper;
+    double dt = 0.0;
+    std::uint64_t steps = 0;
+};
+
+namespace impl_detail
+{
+    // File layout (native endianness):
+    //   header: magic, version, number of records, time, dt, steps, stepper name
+    //   record: name, element size, element count, data offset, padding, data
+    // The data of every record is aligned to checkpoint_alignment, so it can be used in place after mmap.
+    static constexpr char checkpoint_magic[8] = {'A', 'E', 'T', 'C', 'K', 'P', 'T', '\0'};
+    static constexpr std::uint32_t checkpoint_version = 1;
+    static constexpr std::uint64_t checkpoint_alignment = 64;
+    static constexpr std::size_t checkpoint_chunk_size = std::size_t(1) << 20;
+
+    template<typename TDev>
+    constexpr bool is_host_device = std::is_same_v<TDev, alpaka::DevCpu>;
+
+    struct CheckpointRecord
+    {
+        std::uint64_t offset;
+        std::uint64_t count;
+        std::uint32_t elem_size;
+    };
+} // namespace impl_detail
+
+//! Writes named vectors and the integration state to a versioned binary file.
+//!
+//! Vectors are streamed in chunks, so no host copy of the whole state is needed.
+class CheckpointWriter
+{
+private:
+    std::ofstream out_;
+    std::uint32_t num_records_ = 0;
+    std::streamoff num_records_pos_;
+
+    template<typename T>
+    void put(T const& value)
+    {
+        out_.write(reinterpret_cast<char const*>(&value), sizeof(T));
+    }
+
+    void putString(std::string const& str)
+    {
+        put(static_cast<std::uint32_t>(str.size()));
+        out_.write(str.data(), static_cast<std::streamsize>(str.size()));
+    }
+
+public:
+    CheckpointWriter(std::string const& path, CheckpointMetadata const& metadata)
+        : out_(path, std::ios::binary | std::ios::trunc)
+    {
+        if(!out_)
+            throw std::runtime_error("Cannot open checkpoint file " + path);
+
+        out_.write(impl_detail::checkpoint_magic, sizeof(impl_detail::checkpoint_magic));
+        put(impl_detail::checkpoint_version);
+        num_records_pos_ = out_.tellp();
+        put(num_records_);
+        put(metadata.time);
+        put(metadata.dt);
+        put(metadata.steps);
+        putString(metadata.stepper);
+    }
+
+    ~CheckpointWriter()
+    {
+        if(out_.is_open())
+            close();
+    }
+
+    template<typename TBuf, typename TQueue, typename TAcc>
+    void write(
+        std::string const& name,
+        Vector<TBuf, TQueue, TAcc> const& vector,
+        std::size_t chunk_size = impl_detail::checkpoint_chunk_size)
+    {
+        using value_type = alpaka::Elem<TBuf>;
+        using idx_type = alpaka::Idx<TBuf>;
+        using dim_type = alpaka::Dim<TBuf>;
+        static_assert(
+            impl_detail::checkpoint_alignment % alignof(value_type) == 0,
+            "The checkpoint alignment does not satisfy the alignment of the element type");
+
+        if(chunk_size == 0)
+            throw std::invalid_argument("Chunk size for writing vector " + name + " has to be positive");
+
+        auto const count = static_cast<std::uint64_t>(vector.getExtent()[0]);
+        auto const header_end = static_cast<std::uint64_t>(out_.tellp()) + sizeof(std::uint32_t) + name.size()
+                                + sizeof(std::uint32_t) + 2 * sizeof(std::uint64_t);
+        auto const alignment = impl_detail::checkpoint_alignment;
+        auto const offset = (header_end + alignment - 1) / alignment * alignment;
+
+        putString(name);
+        put(static_cast<std::uint32_t>(sizeof(value_type)));
+        put(count);
+        put(offset);
+        std::vector<char> const padding(offset - header_end, 0);
+        out_.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+        auto queue = vector.getQueue();
+        auto const* const data = vector.getPtr();
+        if constexpr(impl_detail::is_host_device<alpaka::Dev<TBuf>>)
+        {
+            alpaka::wait(queue);
+            out_.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(count * sizeof(value_type)));
+        }
+        else
+        {
+            auto const devAcc = vector.getDevice();
+            auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+            std::vector<value_type> staging(std::min<std::uint64_t>(count, chunk_size));
+
+            for(std::uint64_t first = 0; first < count; first += chunk_size)
+            {
+                auto const n = std::min<std::uint64_t>(chunk_size, count - first);
+                alpaka::Vec<dim_type, idx_type> const extent(static_cast<idx_type>(n));
+                auto chunkDev = alpaka::createView(devAcc, vector.getPtr() + first, extent);
+                auto chunkHost = alpaka::createView(devHost, staging.data(), extent);
+                alpaka::memcpy(queue, chunkHost, chunkDev, extent);
+                alpaka::wait(queue);
+                out_.write(
+                    reinterpret_cast<char const*>(staging.data()),
+                    static_cast<std::streamsize>(n * sizeof(value_type)));
+            }
+        }
+
+        if(!out_)
+            throw std::runtime_error("Writing of vector " + name + " to the checkpoint failed");
+        ++num_records_;
+    }
+
+    void close()
+    {
+        out_.seekp(num_records_pos_);
+        put(num_records_);
+        out_.close();
+    }
+};
+
+//! Read access to a checkpoint file which is mapped into memory.
+//!
+//! On CPU accelerators vectors can be used in place as host backed views without any copies. For other
+//! accelerators load() uploads a vector chunk by chunk straight from the mapping.
+class Checkpoint
+{
+private:
+    int fd_ = -1;
+    char* base_ = nullptr;
+    std::size_t size_ = 0;
+    CheckpointMetadata metadata_;
+    std::map<std::string, impl_detail::CheckpointRecord> records_;
+
+    template<typename T>
+    T get(std::size_t& pos) const
+    {
+        if(pos + sizeof(T) > size_)
+            throw std::runtime_error("Checkpoint file is truncated");
+        T value;
+        std::memcpy(&value, base_ + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string getString(std::size_t& pos) const
+    {
+        auto const length = get<std::uint32_t>(pos);
+        if(pos + length > size_)
+            throw std::runtime_error("Checkpoint file is truncated");
+        std::string str(base_ + pos, length);
+        pos += length;
+        return str;
+    }
+
+    template<typename T>
+    impl_detail::CheckpointRecord const& record(std::string const& name) const
+    {
+        auto it = records_.find(name);
+        if(it == records_.end())
+            throw std::invalid_argument("Checkpoint does not contain vector " + name);
+        if(it->second.elem_size != sizeof(T))
+            throw std::invalid_argument("Element type of vector " + name + " does not match the checkpoint");
+        return it->second;
+    }
+
+    void unmap()
+    {
+        if(base_)
+            munmap(base_, size_);
+        if(fd_ >= 0)
+            ::close(fd_);
+        base_ = nullptr;
+        fd_ = -1;
+    }
+
+    void parse(std::string const& path)
+    {
+        std::size_t pos = 0;
+        if(std::memcmp(base_, impl_detail::checkpoint_magic, sizeof(impl_detail::checkpoint_magic)) != 0)
+            throw std::runtime_error(path + " is not a checkpoint file");
+        pos += sizeof(impl_detail::checkpoint_magic);
+
+        auto const version = get<std::uint32_t>(pos);
+        if(version != impl_detail::checkpoint_version)
+            throw std::runtime_error("Unsupported checkpoint version " + std::to_string(version));
+
+        auto const num_records = get<std::uint32_t>(pos);
+        metadata_.time = get<double>(pos);
+        metadata_.dt = get<double>(pos);
+        metadata_.steps = get<std::uint64_t>(pos);
+        metadata_.stepper = getString(pos);
+
+        for(std::uint32_t i = 0; i < num_records; ++i)
+        {
+            auto name = getString(pos);
+            impl_detail::CheckpointRecord record;
+            record.elem_size = get<std::uint32_t>(pos);
+            record.count = get<std::uint64_t>(pos);
+            record.offset = get<std::uint64_t>(pos);
+            auto const elem_size = std::max<std::uint32_t>(record.elem_size, 1);
+            if(record.offset > size_ || record.count > (size_ - record.offset) / elem_size)
+                throw std::runtime_error("Checkpoint file is truncated");
+            pos = record.offset + record.count * record.elem_size;
+            records_.emplace(std::move(name), record);
+        }
+    }
+
+public:
+    explicit Checkpoint(std::string const& path)
+    {
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if(fd_ < 0)
+            throw std::runtime_error("Cannot open checkpoint file " + path);
+
+        // the destructor doesn't run if the constructor throws
+        try
+        {
+            struct stat st;
+            if(fstat(fd_, &st) != 0)
+                throw std::runtime_error("Cannot determine the size of checkpoint file " + path);
+            size_ = static_cast<std::size_t>(st.st_size);
+            if(size_ < sizeof(impl_detail::checkpoint_magic))
+                throw std::runtime_error(path + " is not a checkpoint file");
+
+            // private writable mapping: views may be modified without touching the file (copy on write)
+            void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd_, 0);
+            if(mapping == MAP_FAILED)
+                throw std::runtime_error("Cannot map checkpoint file " + path);
+            base_ = static_cast<char*>(mapping);
+
+            parse(path);
+        }
+        catch(...)
+        {
+            unmap();
+            throw;
+        }
+    }
+
+    Checkpoint(Checkpoint const&) = delete;
+    Checkpoint& operator=(Checkpoint const&) = delete;
+
+    ~Checkpoint()
+    {
+        unmap();
+    }
+
+    CheckpointMetadata const& getMetadata() const
+    {
+        return metadata_;
+    }
+
+    bool contains(std::string const& name) const
+    {
+        return records_.count(name) != 0;
+    }
+
+    std::size_t getSize(std::string const& name) const
+    {
+        return static_cast<std::size_t>(records_.at(name).count);
+    }
+
+    //! Host backed Vector over the mapped data of the record. The view is valid as long as the checkpoint.
+    template<typename T, typename TQueue, typename TAcc>
+    auto view(std::string const& name, TQueue& queue) const
+    {
+        static_assert(
+            impl_detail::is_host_device<alpaka::Dev<TAcc>>,
+            "Checkpoint views can be used only by accelerators which run on the host, use load() instead");
+
+        using dim_type = alpaka::Dim<TAcc>;
+        using idx_type = alpaka::Idx<TAcc>;
+
+        auto const& rec = record<T>(name);
+        // offsets come from the file, which may have been written with a smaller alignment
+        if(reinterpret_cast<std::uintptr_t>(base_ + rec.offset) % alignof(T) != 0)
+            throw std::runtime_error("Data of vector " + name + " is not aligned for a view, use load() instead");
+        alpaka::Vec<dim_type, idx_type> const extent(static_cast<idx_type>(rec.count));
+        auto buffer = alpaka::createView(alpaka::getDev(queue), reinterpret_cast<T*>(base_ + rec.offset), extent);
+        return Vector<decltype(buffer), TQueue, TAcc>{queue, buffer};
+    }
+
+    //! Uploads the record into dest in chunks of chunk_size elements.
+    template<typename TBuf, typename TQueue, typename TAcc>
+    void load(
+        std::string const& name,
+        Vector<TBuf, TQueue, TAcc>& dest,
+        TQueue& queue,
+        std::size_t chunk_size = impl_detail::checkpoint_chunk_size) const
+    {
+        using value_type = alpaka::Elem<TBuf>;
+        using idx_type = alpaka::Idx<TBuf>;
+        using dim_type = alpaka::Dim<TBuf>;
+
+        if(chunk_size == 0)
+            throw std::invalid_argument("Chunk size for loading vector " + name + " has to be positive");
+
+        auto const& rec = record<value_type>(name);
+        dest.adjust_size(rec.count, queue);
+
+        auto const devAcc = dest.getDevice();
+        auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+        auto* const src = reinterpret_cast<value_type*>(base_ + rec.offset);
+        auto* const dst = alpaka::getPtrNative(dest.getBuffer());
+
+        for(std::uint64_t first = 0; first < rec.count; first += chunk_size)
+        {
+            auto const n = std::min<std::uint64_t>(chunk_size, rec.count - first);
+            alpaka::Vec<dim_type, idx_type> const extent(static_cast<idx_type>(n));
+            auto chunkHost = alpaka::createView(devHost, src + first, extent);
+            auto chunkDev = alpaka::createView(devAcc, dst + first, extent);
+            alpaka::memcpy(queue, chunkDev, chunkHost, extent);
+        }
+        alpaka::wait(queue);
+    }
+};
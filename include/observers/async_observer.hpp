@@ -0,0 +1,246 @@
+#pragma once
+
+#include <alpaka/alpaka.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//! What an AsyncObserver does with a snapshot when all staging buffers are in use.
+enum class SnapshotPolicy
+{
+    Block, //!< wait until the oldest snapshot is processed (counted as delayed)
+    Drop //!< skip the snapshot (counted as dropped)
+};
+
+struct AsyncObserverStatistics
+{
+    std::size_t delivered = 0;
+    std::size_t dropped = 0;
+    std::size_t delayed = 0;
+    double delay_seconds = 0.0;
+};
+
+//! odeint observer which downloads the state without blocking the integration.
+//!
+//! Every observed state is first copied into a device snapshot on the integration queue, so the
+//! integration can overwrite the state right away. The snapshot is then downloaded into one of a
+//! rotating pool of host staging buffers on a separate copy queue and handed to a background thread
+//! which calls handler(value_type const* data, std::size_t size, double t).
+//!
+//! An exception thrown by the handler is rethrown by the next call of the observer, by flush() or by the
+//! destructor. Later snapshots are still delivered.
+//!
+//! The observer is not copyable, pass it to the integrate functions with boost::ref.
+template<typename TState, typename THandler>
+class AsyncObserver
+{
+public:
+    using queue_type = typename TState::queue_type;
+    using buf_type = typename TState::buf_type;
+    using value_type = typename TState::value_type;
+    using idx_type = typename TState::idx_type;
+    using dim_type = typename TState::dim_type;
+    using host_buf_type = alpaka::Buf<alpaka::DevCpu, value_type, dim_type, idx_type>;
+    using event_type = alpaka::Event<queue_type>;
+
+private:
+    static constexpr bool is_host_device = std::is_same_v<alpaka::Dev<buf_type>, alpaka::DevCpu>;
+
+    struct Slot
+    {
+        std::optional<buf_type> device;
+        std::optional<host_buf_type> host;
+        std::optional<event_type> copied;
+        idx_type size = 0;
+        double t = 0.0;
+        bool busy = false;
+    };
+
+    THandler handler_;
+    queue_type copy_queue_;
+    SnapshotPolicy policy_;
+
+    std::vector<Slot> slots_;
+    std::size_t next_slot_ = 0;
+    std::deque<std::size_t> pending_;
+    AsyncObserverStatistics statistics_;
+    std::exception_ptr error_;
+    bool stop_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable slot_freed_;
+    std::condition_variable snapshot_ready_;
+    std::thread worker_;
+
+private:
+    void allocate(Slot& slot, TState const& x)
+    {
+        auto const size = x.getExtent()[0];
+        if(slot.host && slot.size == size)
+            return;
+
+        auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+        alpaka::Vec<dim_type, idx_type> const extent(size);
+        slot.host = alpaka::allocBuf<value_type, idx_type>(devHost, extent);
+        if constexpr(!is_host_device)
+            slot.device = alpaka::allocBuf<value_type, idx_type>(x.getDevice(), extent);
+        slot.size = size;
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true)
+        {
+            snapshot_ready_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+            if(pending_.empty())
+                return;
+
+            auto const index = pending_.front();
+            pending_.pop_front();
+            Slot& slot = slots_[index];
+
+            lock.unlock();
+            std::exception_ptr error;
+            try
+            {
+                if constexpr(!is_host_device)
+                    alpaka::wait(*slot.copied);
+                handler_(static_cast<value_type const*>(alpaka::getPtrNative(*slot.host)), slot.size, slot.t);
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            // the slot is freed in any case, otherwise a blocking observer would wait for it forever
+            slot.busy = false;
+            if(error)
+            {
+                if(!error_)
+                    error_ = error;
+            }
+            else
+                ++statistics_.delivered;
+            slot_freed_.notify_all();
+        }
+    }
+
+public:
+    AsyncObserver(
+        THandler handler,
+        queue_type copy_queue,
+        std::size_t num_buffers = 2,
+        SnapshotPolicy policy = SnapshotPolicy::Block)
+        : handler_(std::move(handler))
+        , copy_queue_(copy_queue)
+        , policy_(policy)
+        , slots_(num_buffers)
+    {
+        if(num_buffers == 0)
+            throw std::invalid_argument("AsyncObserver needs at least one staging buffer");
+        worker_ = std::thread([this] { work(); });
+    }
+
+    AsyncObserver(AsyncObserver const&) = delete;
+    AsyncObserver& operator=(AsyncObserver const&) = delete;
+
+    ~AsyncObserver() noexcept(false)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        snapshot_ready_.notify_all();
+        worker_.join();
+        // a second exception during stack unwinding would terminate the program
+        if(std::uncaught_exceptions() == 0)
+            rethrow();
+    }
+
+    void operator()(TState const& x, double t)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        rethrow();
+
+        // slots are used round robin, so snapshots are delivered in order
+        Slot& slot = slots_[next_slot_];
+        if(slot.busy)
+        {
+            if(policy_ == SnapshotPolicy::Drop)
+            {
+                ++statistics_.dropped;
+                return;
+            }
+
+            auto const start = std::chrono::steady_clock::now();
+            slot_freed_.wait(lock, [&slot] { return !slot.busy; });
+            std::chrono::duration<double> const delay = std::chrono::steady_clock::now() - start;
+            ++statistics_.delayed;
+            statistics_.delay_seconds += delay.count();
+        }
+        auto const index = next_slot_;
+        next_slot_ = (next_slot_ + 1) % slots_.size();
+        slot.busy = true;
+        lock.unlock();
+
+        allocate(slot, x);
+        slot.t = t;
+
+        auto queue = x.getQueue();
+        if constexpr(is_host_device)
+        {
+            alpaka::memcpy(queue, *slot.host, x.getConstBuffer());
+            alpaka::wait(queue);
+        }
+        else
+        {
+            // snapshot on the integration queue, download on the copy queue once the snapshot is taken
+            alpaka::memcpy(queue, *slot.device, x.getConstBuffer());
+            event_type snapshot_taken(alpaka::getDev(queue));
+            alpaka::enqueue(queue, snapshot_taken);
+
+            alpaka::wait(copy_queue_, snapshot_taken);
+            alpaka::memcpy(copy_queue_, *slot.host, *slot.device);
+            slot.copied.emplace(alpaka::getDev(copy_queue_));
+            alpaka::enqueue(copy_queue_, *slot.copied);
+        }
+
+        lock.lock();
+        pending_.push_back(index);
+        snapshot_ready_.notify_one();
+    }
+
+    //! Blocks until all snapshots taken so far are processed by the handler.
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slot_freed_.wait(
+            lock,
+            [this]
+            {
+                for(auto const& slot : slots_)
+                    if(slot.busy)
+                        return false;
+                return true;
+            });
+        rethrow();
+    }
+
+    AsyncObserverStatistics getStatistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return statistics_;
+    }
+};
@@ -0,0 +1,486 @@
+#pragma once
+
+#include "../expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// A matrix whose longest row is this many times longer than the average one is multiplied with the
+// merge-path kernel instead of row by row inside the enclosing kernel
+#ifndef EXPR_SPMV_MERGE_PATH_RATIO
+#    define EXPR_SPMV_MERGE_PATH_RATIO 8
+#endif
+
+//! Sparse matrix in compressed sparse row format stored in device buffers.
+template<typename T, typename TQueue, typename TAcc>
+class CsrMatrix
+{
+public:
+    using acc_type = TAcc;
+    using queue_type = TQueue;
+    using value_type = T;
+    using dim_type = alpaka::Dim<TAcc>;
+    using idx_type = alpaka::Idx<TAcc>;
+    using idx_buf_type = alpaka::Buf<TAcc, idx_type, dim_type, idx_type>;
+    using value_buf_type = alpaka::Buf<TAcc, T, dim_type, idx_type>;
+
+private:
+    TQueue queue_;
+    idx_type rows_;
+    idx_type cols_;
+    std::optional<idx_buf_type> row_offsets_;
+    std::optional<idx_buf_type> columns_;
+    std::optional<value_buf_type> values_;
+    idx_type max_row_length_ = 0;
+    // drawn from the write counter of the vectors and shared by all copies, so memoized products are
+    // told apart from those of a matrix which was rebuilt at the same addresses
+    std::shared_ptr<std::uint64_t> version_;
+
+    template<typename TElem>
+    static alpaka::Buf<TAcc, TElem, dim_type, idx_type> upload(TQueue& queue, std::vector<TElem> const& data)
+    {
+        alpaka::Vec<dim_type, idx_type> const extent(static_cast<idx_type>(data.size()));
+        auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+        auto buf = alpaka::allocBuf<TElem, idx_type>(alpaka::getDev(queue), extent);
+        auto view = alpaka::createView(devHost, const_cast<TElem*>(data.data()), extent);
+        alpaka::memcpy(queue, buf, view);
+        return buf;
+    }
+
+public:
+    //! Uploads a matrix with rows x cols elements from the host arrays of the CSR format,
+    //! row_offsets has rows + 1 entries.
+    CsrMatrix(
+        TQueue& queue,
+        idx_type rows,
+        idx_type cols,
+        std::vector<idx_type> const& row_offsets,
+        std::vector<idx_type> const& columns,
+        std::vector<T> const& values)
+        : queue_(queue)
+        , rows_(rows)
+        , cols_(cols)
+        , version_(std::make_shared<std::uint64_t>(impl_detail::next_write_version()))
+    {
+        if(row_offsets.size() != static_cast<std::size_t>(rows) + 1 || columns.size() != values.size()
+           || row_offsets.back() != static_cast<idx_type>(values.size()))
+            throw std::invalid_argument("Inconsistent CSR arrays");
+
+        for(idx_type row = 0; row < rows; ++row)
+            max_row_length_ = std::max(max_row_length_, row_offsets[row + 1] - row_offsets[row]);
+
+        row_offsets_ = upload(queue_, row_offsets);
+        columns_ = upload(queue_, columns);
+        values_ = upload(queue_, values);
+        alpaka::wait(queue_);
+    }
+
+    TQueue getQueue() const
+    {
+        return queue_;
+    }
+
+    idx_type getRows() const
+    {
+        return rows_;
+    }
+
+    idx_type getCols() const
+    {
+        return cols_;
+    }
+
+    idx_type getNonZeros() const
+    {
+        return static_cast<idx_type>(alpaka::getExtentVec(*values_)[0]);
+    }
+
+    idx_type getMaxRowLength() const
+    {
+        return max_row_length_;
+    }
+
+    double getMeanRowLength() const
+    {
+        return rows_ == 0 ? 0.0 : static_cast<double>(getNonZeros()) / static_cast<double>(rows_);
+    }
+
+    idx_type const* getRowOffsets() const
+    {
+        return alpaka::getPtrNative(*row_offsets_);
+    }
+
+    idx_type const* getColumns() const
+    {
+        return alpaka::getPtrNative(*columns_);
+    }
+
+    T const* getValues() const
+    {
+        return alpaka::getPtrNative(*values_);
+    }
+
+    //! Write version of the matrix, it differs from the one of every other matrix.
+    std::uint64_t getVersion() const
+    {
+        return *version_;
+    }
+
+    //! Invalidates memoized results which depend on the matrix,
+    //! has to be called after the values were modified on the device.
+    void markModified() const
+    {
+        *version_ = impl_detail::next_write_version();
+    }
+};
+
+enum class SpMVStrategy
+{
+    Auto, //!< merge path for matrices with strongly varying row lengths, row per thread otherwise
+    RowPerThread, //!< row i is computed on demand by the thread which needs element i
+    MergePath //!< the product is computed into a temporary with an even share of rows and nonzeros per thread
+};
+
+namespace impl_detail
+{
+    //! Merge-path SpMV (Merrill, Garland: "Merge-based Parallel Sparse Matrix-Vector Multiplication").
+    //! The row ends and the nonzeros are merged into one path which is split evenly between the threads.
+    //! Rows which end within the share of a thread are written by it, the partial sum of the row in which
+    //! the share ends is left as carry for the fix-up.
+    class MergePathSpMVKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename T, typename TIdx, typename TVectorHandler>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& acc,
+            T* const result,
+            TIdx* const carryRows,
+            T* const carryValues,
+            TIdx const* const rowOffsets,
+            TIdx const* const columns,
+            T const* const values,
+            TVectorHandler vector,
+            TIdx const& rows,
+            TIdx const& numThreads,
+            TIdx const& itemsPerThread) const -> void
+        {
+            TIdx const thread(alpaka::getIdx<alpaka::Grid, alpaka::Threads>(acc)[0u]);
+            if(thread >= numThreads)
+                return;
+
+            TIdx const nonZeros = rowOffsets[rows];
+            TIdx const pathLength = rows + nonZeros;
+            TIdx const diagonal = thread * itemsPerThread < pathLength ? thread * itemsPerThread : pathLength;
+            TIdx const diagonalEnd
+                = diagonal + itemsPerThread < pathLength ? diagonal + itemsPerThread : pathLength;
+
+            // search the coordinates (row, nonzero) of the diagonal on the merge path
+            TIdx low = diagonal > nonZeros ? diagonal - nonZeros : 0;
+            TIdx high = diagonal < rows ? diagonal : rows;
+            while(low < high)
+            {
+                TIdx const pivot = (low + high) / 2;
+                if(rowOffsets[pivot + 1] <= diagonal - pivot - 1)
+                    low = pivot + 1;
+                else
+                    high = pivot;
+            }
+            TIdx row = low;
+            TIdx nz = diagonal - low;
+
+            T sum = 0;
+            while(row + nz < diagonalEnd)
+            {
+                if(row < rows && nz < rowOffsets[row + 1])
+                {
+                    sum += values[nz] * vector.getValue(columns[nz]);
+                    ++nz;
+                }
+                else
+                {
+                    result[row] = sum;
+                    sum = 0;
+                    ++row;
+                }
+            }
+
+            carryRows[thread] = row;
+            carryValues[thread] = sum;
+        }
+    };
+
+    //! Adds the carries of the rows which are shared by several threads.
+    class MergePathFixupKernel
+    {
+    public:
+        ALPAKA_NO_HOST_ACC_WARNING
+        template<typename TAcc, typename T, typename TIdx>
+        ALPAKA_FN_ACC auto operator()(
+            TAcc const& /* acc */,
+            T* const result,
+            TIdx const* const carryRows,
+            T const* const carryValues,
+            TIdx const& rows,
+            TIdx const& numThreads) const -> void
+        {
+            for(TIdx thread = 0; thread < numThreads; ++thread)
+                if(carryRows[thread] < rows)
+                    result[carryRows[thread]] += carryValues[thread];
+        }
+    };
+
+    template<typename TAcc, typename T, typename = void>
+    struct spmv_merge_path_traits
+    {
+        static constexpr uint32_t items_per_thread = 64;
+    };
+
+    template<typename TAcc, typename T>
+    struct spmv_merge_path_traits<TAcc, T, std::enable_if_t<std::is_same_v<alpaka::Dev<TAcc>, alpaka::DevCpu>>>
+    {
+        static constexpr uint32_t items_per_thread = 16384 / sizeof(T);
+    };
+} // namespace impl_detail
+
+//! y = A * x, where x is an arbitrary expression with A.getCols() elements.
+//!
+//! With the row per thread strategy the handler computes row i when element i is requested, so the
+//! product is fused into the enclosing kernel. Matrices with strongly varying row lengths would leave
+//! most threads waiting for the few with the long rows, for them the product is computed beforehand
+//! with the merge-path kernel.
+template<typename Matrix, typename InnerExpr>
+class SpMVExpression : public ExpressionBase<SpMVExpression<Matrix, InnerExpr>>
+{
+public:
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename Matrix::value_type;
+    using extent_type = typename alpaka::Vec<dim_type, idx_type>;
+    using eval_ret_type = typename expr_traits<InnerExpr>::eval_ret_type;
+
+public:
+    struct AccExpressionHandler
+    {
+        using inner_handler = typename InnerExpr::AccExpressionHandler;
+
+        SpMVExpression const& results_;
+        inner_handler inner_;
+        idx_type const* row_offsets_;
+        idx_type const* columns_;
+        value_type const* values_;
+        value_type* ptr_ = nullptr; // the precomputed product in the merge path strategy
+
+        AccExpressionHandler(SpMVExpression const& results, inner_handler inner) : results_(results), inner_(inner)
+        {
+        }
+
+        ALPAKA_FN_ACC auto getValue(idx_type i) const -> value_type
+        {
+            if(ptr_)
+                return ptr_[i];
+
+            value_type sum = 0;
+            for(idx_type k = row_offsets_[i]; k < row_offsets_[i + 1]; ++k)
+                sum += values_[k] * inner_.getValue(columns_[k]);
+            return sum;
+        }
+
+        void prepare()
+        {
+            // the operand is read at the columns of the nonzeros, so it can't be evaluated tile by tile
+            impl_detail::TilingScope suspend_tiling;
+            row_offsets_ = results_.matrix_.getRowOffsets();
+            columns_ = results_.matrix_.getColumns();
+            values_ = results_.matrix_.getValues();
+            if(results_.useMergePath())
+            {
+                results_.compute();
+                ptr_ = results_.getPtr();
+            }
+            else
+            {
+                inner_.prepare();
+            }
+        }
+    };
+
+private:
+    using idx_buf_type = alpaka::Buf<acc_type, idx_type, dim_type, idx_type>;
+    using value_buf_type = alpaka::Buf<acc_type, value_type, dim_type, idx_type>;
+
+    // shared by all copies of the expression
+    struct State
+    {
+        eval_ret_type result;
+        std::optional<idx_buf_type> carry_rows;
+        std::optional<value_buf_type> carry_values;
+        std::uint64_t evaluation = 0;
+    };
+
+    Matrix matrix_;
+    InnerExpr expr_;
+    SpMVStrategy strategy_;
+    std::shared_ptr<State> state_;
+
+private:
+    bool useMergePath() const
+    {
+        if(strategy_ != SpMVStrategy::Auto)
+            return strategy_ == SpMVStrategy::MergePath;
+        return static_cast<double>(matrix_.getMaxRowLength())
+               > EXPR_SPMV_MERGE_PATH_RATIO * std::max(matrix_.getMeanRowLength(), 1.0);
+    }
+
+    void compute() const
+    {
+        impl_detail::EvaluationScope evaluation;
+        if(state_->evaluation == evaluation.id())
+            return;
+
+        auto queue = expr_.getQueue();
+        auto const devAcc = alpaka::getDev(queue);
+        idx_type const rows = matrix_.getRows();
+        state_->result.adjust_size(rows, queue);
+
+        using traits = impl_detail::spmv_merge_path_traits<acc_type, value_type>;
+        constexpr idx_type itemsPerThread = traits::items_per_thread;
+        idx_type const pathLength = rows + matrix_.getNonZeros();
+        idx_type const numThreads = std::max(idx_type{1}, (pathLength + itemsPerThread - 1) / itemsPerThread);
+
+        alpaka::Vec<dim_type, idx_type> const carryExtent(numThreads);
+        if(!state_->carry_rows || alpaka::getExtentVec(*state_->carry_rows)[0] < numThreads)
+        {
+            state_->carry_rows = alpaka::allocBuf<idx_type, idx_type>(devAcc, carryExtent);
+            state_->carry_values = alpaka::allocBuf<value_type, idx_type>(devAcc, carryExtent);
+        }
+
+        auto handler = impl_detail::make_kernel_handler(expr_);
+        handler.prepare();
+
+        alpaka::WorkDivMembers<dim_type, idx_type> const workDiv(alpaka::getValidWorkDiv<acc_type>(
+            devAcc,
+            carryExtent,
+            idx_type{1},
+            false,
+            alpaka::GridBlockExtentSubDivRestrictions::Unrestricted));
+        alpaka::enqueue(
+            queue,
+            alpaka::createTaskKernel<acc_type>(
+                workDiv,
+                impl_detail::MergePathSpMVKernel{},
+                state_->result.getPtr(),
+                alpaka::getPtrNative(*state_->carry_rows),
+                alpaka::getPtrNative(*state_->carry_values),
+                matrix_.getRowOffsets(),
+                matrix_.getColumns(),
+                matrix_.getValues(),
+                handler,
+                rows,
+                numThreads,
+                itemsPerThread));
+
+        alpaka::Vec<dim_type, idx_type> const one(idx_type{1});
+        alpaka::WorkDivMembers<dim_type, idx_type> const fixupWorkDiv{one, one, one};
+        alpaka::enqueue(
+            queue,
+            alpaka::createTaskKernel<acc_type>(
+                fixupWorkDiv,
+                impl_detail::MergePathFixupKernel{},
+                state_->result.getPtr(),
+                static_cast<idx_type const*>(alpaka::getPtrNative(*state_->carry_rows)),
+                static_cast<value_type const*>(alpaka::getPtrNative(*state_->carry_values)),
+                rows,
+                numThreads));
+        alpaka::wait(queue);
+
+        state_->result.markModified();
+        state_->evaluation = evaluation.id();
+        impl_detail::keep_until_wait(state_);
+    }
+
+    value_type* getPtr() const
+    {
+        return state_->result.getPtr();
+    }
+
+public:
+    SpMVExpression(Matrix const& matrix, InnerExpr const& expr, SpMVStrategy strategy = SpMVStrategy::Auto)
+        : matrix_(matrix)
+        , expr_(expr)
+        , strategy_(strategy)
+        , state_(std::make_shared<State>())
+    {
+        if(expr.getExtent()[0] != matrix.getCols())
+            throw std::invalid_argument("Extents of matrix and vector are mismatched");
+
+        this->queue_ = expr.getQueue();
+        this->extent_ = extent_type(matrix.getRows());
+    }
+
+    AccExpressionHandler getHandler() const
+    {
+        return {*this, expr_.getHandler()};
+    }
+
+    template<typename TVisitor>
+    void visit(TVisitor& visitor) const
+    {
+        visitor(*this);
+        expr_.visit(visitor);
+    }
+
+    void appendCacheKey(impl_detail::ExpressionKey& key) const
+    {
+        key.appendType<SpMVExpression>();
+        key.append(matrix_.getVersion());
+        impl_detail::append_cache_key(expr_, key);
+    }
+};
+
+template<typename Matrix, typename InnerExpr>
+struct expr_traits<SpMVExpression<Matrix, InnerExpr>>
+{
+    using acc_type = typename InnerExpr::acc_type;
+    using idx_type = typename InnerExpr::idx_type;
+    using dim_type = typename InnerExpr::dim_type;
+    using queue_type = typename InnerExpr::queue_type;
+    using value_type = typename Matrix::value_type;
+    using eval_ret_type = typename expr_traits<InnerExpr>::eval_ret_type;
+    constexpr static bool is_binary_op = false;
+    constexpr static bool is_lazy_evaluatable = true;
+};
+
+namespace impl_detail
+{
+    template<typename Matrix, typename InnerExpr>
+    struct supports_tiling<SpMVExpression<Matrix, InnerExpr>> : std::true_type
+    {
+    };
+} // namespace impl_detail
+
+template<typename T, typename TQueue, typename TAcc, typename TDerived>
+inline SpMVExpression<CsrMatrix<T, TQueue, TAcc>, TDerived> spmv(
+    CsrMatrix<T, TQueue, TAcc> const& matrix,
+    ExpressionBase<TDerived> const& expr,
+    SpMVStrategy strategy = SpMVStrategy::Auto)
+{
+    return {matrix, expr.derived(), strategy};
+}
+
+template<typename T, typename TQueue, typename TAcc, typename TDerived>
+inline SpMVExpression<CsrMatrix<T, TQueue, TAcc>, TDerived> operator*(
+    CsrMatrix<T, TQueue, TAcc> const& matrix,
+    ExpressionBase<TDerived> const& expr)
+{
+    return spmv(matrix, expr);
+}
@@ -1,4 +1,5 @@
 #include "algebra/alpaka.hpp"
+#include "integrators/device_adaptive.hpp"
 
 #include <alpaka/alpaka.hpp>
 #include <alpaka/example/ExampleDefaultAcc.hpp>
@@ -60,7 +61,7 @@ struct harmonic_oscillator
         auto const taskKernel = alpaka::createTaskKernel<Acc>(
             workDiv,
             kernel,
-            alpaka::getPtrNative(x.getBuffer()),
+            alpaka::getPtrNative(x.getConstBuffer()),
             alpaka::getPtrNative(dxdt.getBuffer()),
             extent[0]);
 
@@ -69,6 +70,34 @@ struct harmonic_oscillator
     }
 };
 
+template<typename TBuf, typename TQueue, typename TAcc>
+struct harmonic_oscillator<StateBundle<TBuf, TQueue, TAcc, 2>>
+{
+    using state_type = StateBundle<TBuf, TQueue, TAcc, 2>;
+
+    enum
+    {
+        position,
+        velocity
+    };
+
+    void operator()(state_type const& x, state_type& dxdt, double const /* t */)
+    {
+        dxdt.assign(x.component(velocity), -x.component(position) - 0.15 * x.component(velocity));
+    }
+};
+
+template<typename TBuf, typename TQueue, typename TAcc>
+struct harmonic_oscillator<FixedVector<TBuf, TQueue, TAcc, 2>>
+{
+    using state_type = FixedVector<TBuf, TQueue, TAcc, 2>;
+
+    void operator()(state_type const& x, state_type& dxdt, double const /* t */)
+    {
+        dxdt.assign(x.element(1), -x.element(0) - 0.15 * x.element(1));
+    }
+};
+
 template<typename T>
 struct harmonic_oscillator<std::vector<T>>
 {
@@ -120,8 +149,8 @@ struct copy_state_and_time
 
     void operator()(acc_state_type const& x, double t)
     {
-        auto size = alpaka::getExtentVec(x.getBuffer())[0];
-        alpaka::memcpy(queue_, temp_host_buf_, x.getBuffer());
+        auto size = alpaka::getExtentVec(x.getConstBuffer())[0];
+        alpaka::memcpy(queue_, temp_host_buf_, x.getConstBuffer());
         auto* const state = alpaka::getPtrNative(temp_host_buf_);
 
         std::vector<typename acc_state_type::value_type> copy(size);
@@ -137,6 +166,35 @@ auto is_float_equal(float a, float b) -> bool
     return fabs(a - b) < 10e-2;
 }
 
+//! Whether a trajectory of position and velocity matches the reference.
+template<typename TState>
+auto matches_trajectory(std::vector<TState> const& states, std::vector<TState> const& reference) -> bool
+{
+    if(states.size() != reference.size())
+        return false;
+    for(std::size_t i = 0; i < states.size(); ++i)
+    {
+        if(!is_float_equal(states[i][0], reference[i][0]) || !is_float_equal(states[i][1], reference[i][1]))
+            return false;
+    }
+    return true;
+}
+
+//! Integrates the oscillator from the initial state x0 with the device state x and returns the trajectory.
+template<typename TState, typename THostBuf>
+auto integrate_on_device(TState x, typename TState::value_type const* x0, THostBuf& temp_host_buf)
+    -> std::vector<std::vector<typename TState::value_type>>
+{
+    x.upload_async(x0, 2).wait();
+    harmonic_oscillator<TState> system;
+    runge_kutta4_classic<TState> stepper;
+    std::vector<std::vector<typename TState::value_type>> states;
+    std::vector<double> times;
+    copy_state_and_time<TState, THostBuf> observer{states, times, temp_host_buf, x.getQueue()};
+    integrate_const(stepper, system, x, 0.0, 10.0, 0.1, observer);
+    return states;
+}
+
 auto main() -> int
 {
     using Dim = alpaka::DimInt<1u>;
@@ -196,6 +254,30 @@ auto main() -> int
             return 1;
     }
 
+    // the same system with position and velocity as components of a bundle
+    using bundle_state_type = alpaka_bundle_wrapper<BufAcc, QueueAcc, Acc, 2>;
+    if(!matches_trajectory(integrate_on_device(bundle_state_type{queue, 1}, pBufHostX, bufHostTemp), statesHost))
+        return 1;
+
+    // and as a fixed size system
+    using fixed_state_type = alpaka_fixed_wrapper<BufAcc, QueueAcc, Acc, 2>;
+    if(!matches_trajectory(integrate_on_device(fixed_state_type{queue, 1}, pBufHostX, bufHostTemp), statesHost))
+        return 1;
+
+    // with the step size control of Dormand-Prince 5(4) on the device
+    acc_state_type xAdaptive{queue, numElements};
+    xAdaptive.upload_async(pBufHostX, numElements).wait();
+    std::vector<host_state_type> statesAdaptive;
+    std::vector<double> timesAdaptive;
+    copy_state_and_time<acc_state_type, BufHost> observerAdaptive{statesAdaptive, timesAdaptive, bufHostTemp, queue};
+    auto const statistics
+        = integrate_device_adaptive(systemAcc, xAdaptive, 0.0, 10.0, 0.1, 0.1, observerAdaptive, 1e-5, 1e-5);
+    std::cout << "Device adaptive: " << statistics.steps << " steps, " << statistics.rejections << " rejections, "
+              << statistics.synchronizations << " synchronizations" << std::endl;
+
+    if(!matches_trajectory(statesAdaptive, statesHost))
+        return 1;
+
     std::cout << "Execution results correct!" << std::endl;
     return 0;
 }
\ No newline at end of file
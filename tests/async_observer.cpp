@@ -0,0 +1,155 @@
+#include "expressions/expressions.hpp"
+#include "observers/async_observer.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+using Elem = double;
+using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+using vector_type = Vector<Buf, Queue, Acc>;
+
+//! Remembers the time of every snapshot and whether all its elements had the expected value t.
+struct SnapshotChecker
+{
+    std::vector<double>& times;
+    std::vector<bool>& consistent;
+    std::chrono::milliseconds delay;
+
+    void operator()(Elem const* data, std::size_t size, double t)
+    {
+        bool equal = true;
+        for(std::size_t i = 0; i < size; ++i)
+            equal &= data[i] == t;
+        times.push_back(t);
+        consistent.push_back(equal);
+        std::this_thread::sleep_for(delay);
+    }
+};
+
+//! Fails for the snapshot at fail_at.
+struct FailingHandler
+{
+    double fail_at;
+
+    void operator()(Elem const*, std::size_t, double t)
+    {
+        if(t == fail_at)
+            throw std::runtime_error("snapshot rejected");
+    }
+};
+
+auto main() -> int
+{
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev), copyQueue(dev);
+
+    Idx const N = 10000;
+    int const steps = 20;
+    bool correct = true;
+
+    // blocking: every snapshot is delivered in order and shows the state at the time it was taken, although
+    // the state is overwritten right after the observer returns
+    {
+        std::vector<double> times;
+        std::vector<bool> consistent;
+        vector_type x(queue, N);
+        x = fill<Acc>(queue, Elem(0), N);
+        {
+            AsyncObserver<vector_type, SnapshotChecker> observer(
+                SnapshotChecker{times, consistent, std::chrono::milliseconds(1)},
+                copyQueue,
+                2,
+                SnapshotPolicy::Block);
+            for(int step = 0; step < steps; ++step)
+            {
+                observer(x, step);
+                x = x + 1.0;
+            }
+            observer.flush();
+
+            auto const statistics = observer.getStatistics();
+            correct &= statistics.delivered == steps && statistics.dropped == 0;
+        }
+
+        bool inOrder = times.size() == steps;
+        for(std::size_t i = 0; i < times.size(); ++i)
+            inOrder &= times[i] == static_cast<double>(i) && consistent[i];
+        std::cout << "blocking snapshots: " << (inOrder ? "correct" : "incorrect") << std::endl;
+        correct &= inOrder;
+    }
+
+    // dropping: a slow handler loses snapshots, but every delivered one is intact
+    {
+        std::vector<double> times;
+        std::vector<bool> consistent;
+        vector_type x(queue, N);
+        x = fill<Acc>(queue, Elem(0), N);
+        AsyncObserverStatistics statistics;
+        {
+            AsyncObserver<vector_type, SnapshotChecker> observer(
+                SnapshotChecker{times, consistent, std::chrono::milliseconds(20)},
+                copyQueue,
+                1,
+                SnapshotPolicy::Drop);
+            for(int step = 0; step < steps; ++step)
+            {
+                observer(x, step);
+                x = x + 1.0;
+            }
+            observer.flush();
+            statistics = observer.getStatistics();
+        }
+
+        bool intact = statistics.delivered + statistics.dropped == steps && statistics.delivered == times.size()
+                      && statistics.delivered > 0;
+        for(std::size_t i = 0; i < times.size(); ++i)
+            intact &= consistent[i] && (i == 0 || times[i] > times[i - 1]);
+        std::cout << "dropping snapshots: " << statistics.dropped << " dropped, " << (intact ? "correct" : "incorrect")
+                  << std::endl;
+        correct &= intact;
+    }
+
+    // a throwing handler frees its slot and the exception reaches the integration thread
+    {
+        vector_type x(queue, N);
+        x = fill<Acc>(queue, Elem(0), N);
+        bool rethrown = false;
+        try
+        {
+            AsyncObserver<vector_type, FailingHandler> observer(FailingHandler{3.0}, copyQueue, 1);
+            for(int step = 0; step < steps; ++step)
+                observer(x, step);
+            observer.flush();
+        }
+        catch(std::runtime_error const&)
+        {
+            rethrown = true;
+        }
+
+        bool rejected = false;
+        try
+        {
+            AsyncObserver<vector_type, FailingHandler> observer(FailingHandler{-1.0}, copyQueue, 0);
+        }
+        catch(std::invalid_argument const&)
+        {
+            rejected = true;
+        }
+        std::cout << "handler errors: " << (rethrown && rejected ? "correct" : "incorrect") << std::endl;
+        correct &= rethrown && rejected;
+    }
+
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+#include "expressions/expressions.hpp"
+#include "io/checkpoint.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+
+    std::string const path = "checkpoint_test.bin";
+    Idx const N = 1003;
+
+    vector_type x(queue, N), v(queue, 17);
+    x = iota<Acc, Elem>(queue, N, 0.5);
+    v = fill<Acc>(queue, Elem(-2), Idx{17});
+
+    // small chunks, so a vector is written and loaded in several pieces
+    {
+        CheckpointWriter writer(path, {1.5, "rk4", 0.01, 150});
+        writer.write("x", x, 100);
+        writer.write("v", v, 100);
+    }
+
+    bool correct = true;
+    {
+        Checkpoint checkpoint(path);
+        auto const& metadata = checkpoint.getMetadata();
+        correct &= metadata.time == 1.5 && metadata.stepper == "rk4" && metadata.dt == 0.01 && metadata.steps == 150;
+        correct &= checkpoint.contains("x") && checkpoint.contains("v") && !checkpoint.contains("y");
+
+        vector_type loaded(queue, 1);
+        checkpoint.load("x", loaded, queue, 100);
+        std::vector<Elem> host(N);
+        loaded.download_async(host.data(), N).wait();
+        for(Idx i = 0; i < N; ++i)
+            correct &= host[i] == 0.5 + static_cast<Elem>(i);
+
+        checkpoint.load("v", loaded, queue);
+        correct &= loaded.getExtent()[0] == 17 && loaded.max().compute() == -2.0;
+    }
+    std::cout << "checkpoint round trip: " << (correct ? "correct" : "incorrect") << std::endl;
+
+    // an empty chunk would never advance the copy loop
+    bool zero_chunk = false;
+    try
+    {
+        Checkpoint checkpoint(path);
+        vector_type loaded(queue, 1);
+        checkpoint.load("x", loaded, queue, 0);
+    }
+    catch(std::invalid_argument const&)
+    {
+        zero_chunk = true;
+    }
+    std::cout << "zero chunk size rejected: " << (zero_chunk ? "correct" : "incorrect") << std::endl;
+    correct &= zero_chunk;
+
+    // a file which ends within the data of the last vector is rejected
+    bool rejected = false;
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+    try
+    {
+        Checkpoint checkpoint(path);
+    }
+    catch(std::runtime_error const& e)
+    {
+        rejected = true;
+        std::cout << "truncated checkpoint rejected: " << e.what() << std::endl;
+    }
+    correct &= rejected;
+
+    std::remove(path.c_str());
+    return correct ? 0 : 1;
+}
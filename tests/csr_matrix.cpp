@@ -0,0 +1,86 @@
+#include "expressions/expressions.hpp"
+#include "sparse/csr_matrix.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <iostream>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+using Elem = double;
+using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+using vector_type = Vector<Buf, Queue, Acc>;
+using matrix_type = CsrMatrix<Elem, Queue, Acc>;
+
+//! Tridiagonal matrix with diagonal elements d and off-diagonal elements o.
+matrix_type tridiagonal(Queue& queue, Idx n, Elem d, Elem o)
+{
+    std::vector<Idx> offsets{0};
+    std::vector<Idx> columns;
+    std::vector<Elem> values;
+    for(Idx row = 0; row < n; ++row)
+    {
+        for(Idx col = row > 0 ? row - 1 : 0; col <= row + 1 && col < n; ++col)
+        {
+            columns.push_back(col);
+            values.push_back(col == row ? d : o);
+        }
+        offsets.push_back(static_cast<Idx>(columns.size()));
+    }
+    return matrix_type(queue, n, n, offsets, columns, values);
+}
+
+auto main() -> int
+{
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+
+    Idx const N = 1000;
+    vector_type x(queue, N), y(queue, N);
+    x = iota<Acc, Elem>(queue, N, 1.0);
+
+    bool correct = true;
+
+    // both strategies give the product of the host
+    {
+        auto const A = tridiagonal(queue, N, 2.0, -1.0);
+        std::vector<Elem> rowHost(N), mergeHost(N);
+        y = spmv(A, x, SpMVStrategy::RowPerThread);
+        y.download_async(rowHost.data(), N).wait();
+        y = spmv(A, x, SpMVStrategy::MergePath);
+        y.download_async(mergeHost.data(), N).wait();
+
+        bool product = true;
+        for(Idx i = 0; i < N; ++i)
+        {
+            Elem expected = 2.0 * static_cast<Elem>(i + 1);
+            if(i > 0)
+                expected -= static_cast<Elem>(i);
+            if(i + 1 < N)
+                expected -= static_cast<Elem>(i + 2);
+            product &= rowHost[i] == expected && mergeHost[i] == expected;
+        }
+        std::cout << "sparse products: " << (product ? "correct" : "incorrect") << std::endl;
+        correct &= product;
+    }
+
+    // a matrix which is rebuilt (possibly at the addresses of the old one) doesn't reuse memoized results
+    {
+        Elem sums[2];
+        for(int rebuild = 0; rebuild < 2; ++rebuild)
+        {
+            auto const A = tridiagonal(queue, N, 1.0 + rebuild, 0.0);
+            sums[rebuild] = (A * x).sum().compute();
+        }
+        Elem const expected = static_cast<Elem>(N * (N + 1) / 2);
+        bool const rebuilt = sums[0] == expected && sums[1] == 2.0 * expected;
+        std::cout << "rebuilt matrix: " << (rebuilt ? "correct" : "incorrect") << std::endl;
+        correct &= rebuilt;
+    }
+
+    return correct ? 0 : 1;
+}
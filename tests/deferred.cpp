@@ -0,0 +1,85 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Elem = double;
+
+//! x_i plus the first element of the second input.
+struct AddFirst
+{
+    template<typename TX, typename TTotal>
+    ALPAKA_FN_ACC auto operator()(Idx i, TX const& x, TTotal const& total) const -> Elem
+    {
+        return x[i] + total[0];
+    }
+};
+
+auto main() -> int
+{
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    Idx const N = 1001;
+    vector_type x(queue, N), y(queue, N), z(queue, N);
+    x = iota<Acc, Elem>(queue, N, 1.0);
+    std::vector<Elem> xHost(N);
+    x.download_async(xHost.data(), N).wait();
+
+    bool correct = true;
+
+    // a chain of dependent statements, the first destination is too small and is resized
+    {
+        vector_type k(queue, 1);
+        defer(k, 2.0 * x).then(y, x + 0.5 * k).then(z, ShiftExpression<vector_type, 1>(y) - k).flush();
+
+        std::vector<Elem> kHost(N), yHost(N), zHost(N);
+        k.download_async(kHost.data(), N).wait();
+        y.download_async(yHost.data(), N).wait();
+        z.download_async(zHost.data(), N).wait();
+        bool chained = k.getExtent()[0] == N;
+        for(Idx i = 0; i < N; ++i)
+        {
+            chained &= kHost[i] == 2.0 * xHost[i] && yHost[i] == 2.0 * xHost[i];
+            chained &= zHost[i] == 2.0 * xHost[std::min(i + 1, N - 1)] - 2.0 * xHost[i];
+        }
+        std::cout << "dependent statements: " << (chained ? "correct" : "incorrect") << std::endl;
+        correct &= chained;
+    }
+
+    // a later kernel reduces the destination of an earlier one, the memoized sum of its old values is not used
+    {
+        y = fill<Acc>(queue, Elem(1), N);
+        auto const before = y.sum().compute();
+        defer(y, 2.0 * x).then(z, indexed(AddFirst{}, x, y.sum())).flush();
+
+        std::vector<Elem> zHost(N);
+        z.download_async(zHost.data(), N).wait();
+        Elem const total = static_cast<Elem>(N * (N + 1));
+        bool fresh = before == static_cast<Elem>(N);
+        for(Idx i = 0; i < N; ++i)
+            fresh &= zHost[i] == xHost[i] + total;
+        std::cout << "reduced destination: " << (fresh ? "correct" : "incorrect") << std::endl;
+        correct &= fresh;
+    }
+
+    std::cout << "deferred statements: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
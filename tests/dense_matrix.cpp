@@ -0,0 +1,63 @@
+#include "dense/matrix.hpp"
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+using Elem = double;
+using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+using vector_type = Vector<Buf, Queue, Acc>;
+using matrix_type = Matrix<Buf, Queue, Acc>;
+using Extent = alpaka::Vec<alpaka::DimInt<1>, Idx>;
+
+auto main() -> int
+{
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+    Queue queue(dev);
+
+    // neither extent is a multiple of a CPU tile, a row group or a GPU block
+    Idx const rows = 77;
+    Idx const cols = 1031;
+
+    std::vector<Elem> K(rows * cols);
+    std::vector<Elem> x0(cols);
+    for(Idx j = 0; j < cols; ++j)
+        x0[j] = 0.01 * static_cast<Elem>(j);
+    for(Idx i = 0; i < rows; ++i)
+        for(Idx j = 0; j < cols; ++j)
+            K[i * cols + j] = 1.0 + 0.5 * std::cos(static_cast<Elem>(i + 2 * j));
+
+    matrix_type coupling(queue, rows, cols, K);
+    vector_type x(queue, cols), y(queue, rows);
+    alpaka::memcpy(queue, x.getBuffer(), alpaka::createView(devHost, x0.data(), Extent(cols)));
+    alpaka::wait(queue);
+
+    y = coupling * sin(x);
+
+    std::vector<Elem> host(rows);
+    alpaka::memcpy(queue, alpaka::createView(devHost, host.data(), Extent(rows)), y.getConstBuffer());
+    alpaka::wait(queue);
+
+    bool correct = true;
+    for(Idx i = 0; i < rows; ++i)
+    {
+        Elem expected = 0;
+        for(Idx j = 0; j < cols; ++j)
+            expected += K[i * cols + j] * std::sin(x0[j]);
+        correct &= std::abs(host[i] - expected) <= 1e-10 * static_cast<Elem>(cols);
+    }
+    std::cout << "dense matvec: " << (correct ? "correct" : "incorrect") << std::endl;
+
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include "integrators/device_adaptive.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+using Elem = double;
+using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+
+//! Diffusive coupling of sin(x) with damping. The planner materializes sin(x) for both shifts, so the
+//! assignment leaves a temporary behind which its kernel reads after the call returned.
+struct SineChain
+{
+    template<typename TVector>
+    void operator()(TVector const& x, TVector& dxdt, double /* t */) const
+    {
+        auto const s = sin(x);
+        using sin_type = std::decay_t<decltype(s)>;
+        dxdt = ShiftExpression<sin_type, -1>(s) - 2.0 * s + ShiftExpression<sin_type, 1>(s) - 0.1 * x;
+    }
+};
+
+//! Every error estimate is NaN, so every attempt is rejected.
+struct NotANumber
+{
+    template<typename TVector>
+    void operator()(TVector const& x, TVector& dxdt, double /* t */) const
+    {
+        dxdt = 0.0 * x + std::numeric_limits<Elem>::quiet_NaN();
+    }
+};
+
+//! Integrates system from a linear profile and returns the observed states.
+template<typename TQueue, typename TSystem>
+auto integrate(TSystem system, Idx n, DeviceAdaptiveStatistics& statistics) -> std::vector<std::vector<Elem>>
+{
+    using vector_type = Vector<Buf, TQueue, Acc>;
+
+    TQueue queue(alpaka::getDevByIdx<Acc>(0));
+    vector_type x(queue, n);
+    x = linspace<Acc>(queue, Elem(0), Elem(3), n);
+
+    std::vector<std::vector<Elem>> states;
+    auto observer = [&](vector_type const& state, double /* t */)
+    {
+        states.emplace_back(n);
+        state.download_async(states.back().data(), n).wait();
+    };
+    statistics = integrate_device_adaptive(system, x, 0.0, 2.0, 0.25, 0.01, observer, 1e-8, 1e-8);
+    return states;
+}
+
+auto main() -> int
+{
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    Idx const n = 1001;
+    bool correct = true;
+
+    // an expression based system on a non-blocking queue takes the same steps as on a blocking one
+    {
+        DeviceAdaptiveStatistics blockingStatistics, asyncStatistics;
+        auto const blocking = integrate<alpaka::Queue<Acc, alpaka::Blocking>>(SineChain{}, n, blockingStatistics);
+        auto const async = integrate<alpaka::Queue<Acc, alpaka::NonBlocking>>(SineChain{}, n, asyncStatistics);
+
+        bool same = blocking.size() == 9 && async.size() == blocking.size()
+                    && asyncStatistics.steps == blockingStatistics.steps
+                    && asyncStatistics.rejections == blockingStatistics.rejections;
+        for(std::size_t o = 0; same && o < blocking.size(); ++o)
+        {
+            for(Idx i = 0; i < n; ++i)
+                same &= std::abs(async[o][i] - blocking[o][i]) < 1e-12;
+        }
+        std::cout << "non-blocking queue, " << asyncStatistics.steps << " steps, " << asyncStatistics.synchronizations
+                  << " synchronizations: " << (same ? "correct" : "incorrect") << std::endl;
+        correct &= same;
+    }
+
+    // a step size which never gets accepted ends the integration instead of enqueuing attempts forever
+    {
+        bool stopped = false;
+        try
+        {
+            DeviceAdaptiveStatistics statistics;
+            integrate<alpaka::Queue<Acc, alpaka::Blocking>>(NotANumber{}, n, statistics);
+        }
+        catch(std::runtime_error const&)
+        {
+            stopped = true;
+        }
+        std::cout << "rejected steps: " << (stopped ? "correct" : "incorrect") << std::endl;
+        correct &= stopped;
+    }
+
+    std::cout << "device adaptive integration: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include "distributed/distributed_vector.hpp"
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+auto main(int argc, char* argv[]) -> int
+{
+    MPI_Init(&argc, &argv);
+
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    using Dim = alpaka::DimInt<1u>;
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<Dim, Idx>;
+    using QueueAcc = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Data = double;
+    using BufAcc = alpaka::Buf<Acc, Data, Dim, Idx>;
+    using DevHost = alpaka::DevCpu;
+    using BufHost = alpaka::Buf<DevHost, Data, Dim, Idx>;
+    using vector_type = DistributedVector<BufAcc, QueueAcc, Acc>;
+
+    auto const devAcc = alpaka::getDevByIdx<Acc>(0u);
+    auto const devHost = alpaka::getDevByIdx<DevHost>(0u);
+    QueueAcc queue(devAcc);
+
+    Idx const N = 1003;
+    vector_type x{queue, N};
+
+    Idx const n = x.getExtent()[0];
+    Idx const w = x.getHaloWidth();
+    Idx const offset = x.getGlobalOffset();
+    alpaka::Vec<Dim, Idx> const extent(n + 2 * w);
+
+    // x[i] = i for the global index i
+    BufHost hostBuf(alpaka::allocBuf<Data, Idx>(devHost, extent));
+    Data* const host = alpaka::getPtrNative(hostBuf);
+    for(Idx i = 0; i < n; ++i)
+        host[w + i] = static_cast<Data>(offset + i);
+    alpaka::memcpy(queue, x.getBuffer(), hostBuf);
+    alpaka::wait(queue);
+
+    bool correct = true;
+
+    auto const sum = x.sum().compute();
+    correct &= sum == static_cast<Data>(N * (N - 1) / 2);
+
+    vector_type y;
+    y = ShiftExpression<vector_type, 1>(x) - ShiftExpression<vector_type, -1>(x);
+
+    alpaka::memcpy(queue, hostBuf, y.getConstBuffer());
+    alpaka::wait(queue);
+    for(Idx i = 0; i < n; ++i)
+    {
+        Idx const global = offset + i;
+        Idx const next = std::min(global + 1, N - 1);
+        Idx const prev = global == 0 ? 0 : global - 1;
+        correct &= host[w + i] == static_cast<Data>(next - prev);
+    }
+
+    auto const max = y.max().compute();
+    correct &= max == 2;
+
+    // masked trees are distributed as well: the elements 0, 1 and 2 are dropped on the first process
+    auto const masked = where(x > 2.0, x, 0.0).sum().compute();
+    correct &= masked == static_cast<Data>(N * (N - 1) / 2 - 3);
+
+    auto const min = (x + 5.0).min().compute();
+    correct &= min == 5;
+
+    // pairs are reduced component wise across the processes: sin(0) = 0, cos(0) = 1
+    auto const mean_field = (0.0 * x).sincos().sum().compute();
+    correct &= mean_field.sin == 0 && mean_field.cos == static_cast<Data>(N);
+
+    int local_correct = correct ? 1 : 0;
+    int all_correct = 0;
+    MPI_Allreduce(&local_correct, &all_correct, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+
+    if(rank == 0)
+    {
+        std::cout << "Distributed sum = " << sum << ", max of central difference = " << max << ": ";
+        if(all_correct)
+            std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+        else
+            std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    }
+
+    MPI_Finalize();
+    return all_correct ? 0 : 1;
+}
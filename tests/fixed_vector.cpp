@@ -0,0 +1,85 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Elem = double;
+
+//! Element k of every system reads element k + 1 of the same system, the last one reads the first.
+struct RotateElements
+{
+    Idx batch;
+    Idx size;
+
+    template<typename TX>
+    ALPAKA_FN_ACC auto operator()(Idx i, TX const& x) const -> Elem
+    {
+        Idx const k = i / batch;
+        return x[((k + 1) % size) * batch + i % batch];
+    }
+};
+
+auto main() -> int
+{
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using fixed_type = FixedVector<Buf, Queue, Acc, 3>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    // more systems than workers or threads per block, and not a multiple of either
+    Idx const batch = 1001;
+    Idx const n = 3 * batch;
+    std::vector<Elem> host(n);
+    for(Idx i = 0; i < n; ++i)
+        host[i] = static_cast<Elem>(i % batch) + 0.25 * static_cast<Elem>(i / batch);
+
+    fixed_type x(queue, batch), y(queue, batch);
+    x.upload_async(host.data(), n).wait();
+    bool correct = true;
+
+    // one expression per element, every system is written
+    {
+        y.assign(x.element(1), -x.element(0) - 0.15 * x.element(1), 2.0 * x.element(2));
+        std::vector<Elem> result(n);
+        y.download_async(result.data(), n).wait();
+        bool assigned = true;
+        for(Idx b = 0; b < batch; ++b)
+        {
+            assigned &= result[b] == host[batch + b];
+            assigned &= std::abs(result[batch + b] - (-host[b] - 0.15 * host[batch + b])) < 1e-12;
+            assigned &= result[2 * batch + b] == 2.0 * host[2 * batch + b];
+        }
+        std::cout << "element assignment: " << (assigned ? "correct" : "incorrect") << std::endl;
+        correct &= assigned;
+    }
+
+    // in place, every element reads the old values of the others
+    {
+        x.assign(x.element(2), x.element(0), x.element(1));
+        x = indexed(RotateElements{batch, 3}, x);
+        std::vector<Elem> result(n);
+        x.download_async(result.data(), n).wait();
+        bool rotated = true;
+        for(Idx i = 0; i < n; ++i)
+            rotated &= result[i] == host[i];
+        std::cout << "in place rotations: " << (rotated ? "correct" : "incorrect") << std::endl;
+        correct &= rotated;
+    }
+
+    std::cout << "fixed size systems: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    Idx const N = 1001;
+    vector_type x(queue, N), flat(queue, N), recursive(queue, N), a(queue, N), b(queue, N);
+    x = linspace<Acc>(queue, Elem(-1), Elem(1), N);
+
+    auto const next = ShiftExpression<vector_type, 1>(x);
+    auto const prev = ShiftExpression<vector_type, -1>(x);
+    auto const lhs = 0.5 * sin(x) + 2.0 * cos(next);
+    auto const rhs = (1.0 - abs(prev)) * 3.0 + 0.25;
+    auto const positive = where(x > 0.0, x, 0.0);
+
+    // the whole tree is a flat program, its parts are evaluated by recursive handlers
+    auto const deep = lhs + rhs + sin(lhs - rhs) * 0.1 + positive;
+    static_assert(impl_detail::num_cwise_nodes<std::decay_t<decltype(deep)>>::value >= EXPR_FLATTEN_MIN_NODES);
+    static_assert(!impl_detail::is_flattened<std::decay_t<decltype(lhs)>>::value);
+    static_assert(!impl_detail::is_flattened<std::decay_t<decltype(rhs)>>::value);
+
+    flat = deep;
+    a = lhs;
+    b = rhs;
+    recursive = a + b + sin(a - b) * 0.1 + positive;
+    auto const flatSum = deep.sum().compute();
+
+    std::vector<Elem> xHost(N), flatHost(N), recursiveHost(N);
+    x.download_async(xHost.data(), N).wait();
+    flat.download_async(flatHost.data(), N).wait();
+    recursive.download_async(recursiveHost.data(), N).wait();
+
+    bool correct = true;
+    Elem sum = 0;
+    for(Idx i = 0; i < N; ++i)
+    {
+        Elem const v = xHost[i];
+        Elem const l = 0.5 * std::sin(v) + 2.0 * std::cos(xHost[std::min(i + 1, N - 1)]);
+        Elem const r = (1.0 - std::abs(xHost[i > 0 ? i - 1 : 0])) * 3.0 + 0.25;
+        Elem const expected = l + r + std::sin(l - r) * 0.1 + (v > 0.0 ? v : 0.0);
+        correct &= std::abs(flatHost[i] - recursiveHost[i]) < 1e-12 && std::abs(flatHost[i] - expected) < 1e-12;
+        sum += recursiveHost[i];
+    }
+    correct &= std::abs(flatSum - sum) < 1e-9;
+
+    std::cout << "flat and recursive evaluation of "
+              << impl_detail::num_cwise_nodes<std::decay_t<decltype(deep)>>::value << " cwise nodes: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
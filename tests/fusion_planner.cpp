@@ -0,0 +1,123 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Elem = double;
+
+//! Number of occurrences of pattern in text.
+std::size_t occurrences(std::string const& text, std::string const& pattern)
+{
+    std::size_t count = 0;
+    for(auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + pattern.size()))
+        ++count;
+    return count;
+}
+
+auto main() -> int
+{
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    Idx const N = 1001;
+    vector_type x(queue, N), y(queue, N), res(queue, N);
+    x = linspace<Acc>(queue, Elem(-1), Elem(1), N);
+    y = linspace<Acc>(queue, Elem(0), Elem(3), N);
+    std::vector<Elem> xHost(N), yHost(N), resHost(N);
+    x.download_async(xHost.data(), N).wait();
+    y.download_async(yHost.data(), N).wait();
+
+    auto const sx = sin(x);
+    auto const sy = sin(y);
+    using sin_type = std::decay_t<decltype(sx)>;
+    auto const next = [&](std::vector<Elem> const& v, Idx i) { return std::sin(v[std::min(i + 1, N - 1)]); };
+    auto const prev = [&](std::vector<Elem> const& v, Idx i) { return std::sin(v[i > 0 ? i - 1 : 0]); };
+
+    bool correct = true;
+
+    // sin(x) and sin(y) have the same type but are read by one shift each, so both stay fused
+    {
+        auto const tree = ShiftExpression<sin_type, -1>(sx) + ShiftExpression<sin_type, 1>(sy);
+        auto const report = fusion_report(tree);
+        res = tree;
+        res.download_async(resHost.data(), N).wait();
+        bool planned = occurrences(report, "read by 1 shifts") == 2 && occurrences(report, "-> fused") == 2
+                       && occurrences(report, "materialized") == 0;
+        for(Idx i = 0; i < N; ++i)
+            planned &= std::abs(resHost[i] - (prev(xHost, i) + next(yHost, i))) < 1e-12;
+        std::cout << report << "different operands: " << (planned ? "correct" : "incorrect") << std::endl;
+        correct &= planned;
+    }
+
+    // a stencil of sin(x) next to a shift of sin(y): only sin(x) is materialized, once for both shifts
+    {
+        auto const tree = ShiftExpression<sin_type, -1>(sx) - 2.0 * sx + ShiftExpression<sin_type, 1>(sx)
+                          + ShiftExpression<sin_type, 1>(sy);
+        auto const report = fusion_report(tree);
+        res = tree;
+        res.download_async(resHost.data(), N).wait();
+        bool planned = occurrences(report, "read by 2 shifts") == 2 && occurrences(report, "read by 1 shifts") == 1
+                       && occurrences(report, "-> materialized\n") == 1
+                       && occurrences(report, "shared with an equal shift") == 1 && occurrences(report, "-> fused") == 1;
+        for(Idx i = 0; i < N; ++i)
+        {
+            Elem const expected = prev(xHost, i) - 2.0 * std::sin(xHost[i]) + next(xHost, i) + next(yHost, i);
+            planned &= std::abs(resHost[i] - expected) < 1e-12;
+        }
+        std::cout << report << "shared operands: " << (planned ? "correct" : "incorrect") << std::endl;
+        correct &= planned;
+    }
+
+    // sin and cos of equal operands built separately are evaluated with one sincos call
+    {
+        auto const tree = 2.0 * cos(x - 1.0) - 3.0 * sin(x - 1.0);
+        auto const report = fusion_report(tree);
+        res = tree;
+        res.download_async(resHost.data(), N).wait();
+        bool planned = occurrences(report, "read by 1 sin and 1 cos nodes") == 2
+                       && occurrences(report, "-> sincos pair\n") == 1
+                       && occurrences(report, "-> reads the shared sincos pair") == 1;
+        for(Idx i = 0; i < N; ++i)
+        {
+            Elem const expected = 2.0 * std::cos(xHost[i] - 1.0) - 3.0 * std::sin(xHost[i] - 1.0);
+            planned &= std::abs(resHost[i] - expected) < 1e-12;
+        }
+        std::cout << report << "sin and cos pairs: " << (planned ? "correct" : "incorrect") << std::endl;
+        correct &= planned;
+    }
+
+    // cos(x) and sin(y) have the same type but different operands, so both functions are called
+    {
+        auto const tree = cos(x) + sin(y);
+        auto const report = fusion_report(tree);
+        res = tree;
+        res.download_async(resHost.data(), N).wait();
+        bool planned = occurrences(report, "-> fused") == 2 && occurrences(report, "sincos pair") == 0;
+        for(Idx i = 0; i < N; ++i)
+            planned &= std::abs(resHost[i] - (std::cos(xHost[i]) + std::sin(yHost[i]))) < 1e-12;
+        std::cout << report << "sin and cos of different operands: " << (planned ? "correct" : "incorrect")
+                  << std::endl;
+        correct &= planned;
+    }
+
+    std::cout << "fusion planning: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using IdxBuf = alpaka::Buf<Acc, Idx, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+    using index_vector_type = Vector<IdxBuf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    // every target gets several contributions, so the updates conflict
+    Idx const N = 10007;
+    Idx const M = 101;
+    std::vector<Idx> idxHost(N);
+    for(Idx i = 0; i < N; ++i)
+        idxHost[i] = (i * 37) % M;
+
+    vector_type x(queue, N);
+    x = iota<Acc, Elem>(queue, N, 1.0);
+    index_vector_type idx(queue, N), reversed(queue, N);
+    idx.upload_async(idxHost.data(), N).wait();
+    reversed = Idx{N - 1} - iota<Acc, Idx>(queue, N);
+
+    bool correct = true;
+
+    // gather inside a cwise tree: y_i = x[N - 1 - i] + 1
+    {
+        vector_type y(queue, N);
+        y = gather(x, reversed) + 1.0;
+        std::vector<Elem> yHost(N);
+        y.download_async(yHost.data(), N).wait();
+        bool gathered = true;
+        for(Idx i = 0; i < N; ++i)
+            gathered &= yHost[i] == static_cast<Elem>(N - i) + 1.0;
+        std::cout << "gather: " << (gathered ? "correct" : "incorrect") << std::endl;
+        correct &= gathered;
+    }
+
+    // scatter with atomics and with a plan give the sums of the contributions to every target
+    {
+        std::vector<Elem> expected(M, 1.0);
+        for(Idx i = 0; i < N; ++i)
+            expected[idxHost[i]] += 2.0 * static_cast<Elem>(i + 1);
+
+        vector_type atomic(queue, M), planned(queue, M);
+        atomic = fill<Acc>(queue, Elem(1), M);
+        planned = fill<Acc>(queue, Elem(1), M);
+        scatter_add(atomic, idx, 2.0 * x);
+        scatter_add(planned, make_scatter_plan(idx), 2.0 * x);
+
+        std::vector<Elem> atomicHost(M), plannedHost(M);
+        atomic.download_async(atomicHost.data(), M).wait();
+        planned.download_async(plannedHost.data(), M).wait();
+        bool scattered = true;
+        for(Idx t = 0; t < M; ++t)
+            scattered &= atomicHost[t] == expected[t] && plannedHost[t] == expected[t];
+        std::cout << "scatter_add: " << (scattered ? "correct" : "incorrect") << std::endl;
+        correct &= scattered;
+    }
+
+    // the destination must not be read by the values
+    {
+        bool rejected = false;
+        try
+        {
+            scatter_add(x, idx, 2.0 * x);
+        }
+        catch(std::invalid_argument const&)
+        {
+            rejected = true;
+        }
+        std::cout << "aliased scatter_add rejected: " << (rejected ? "correct" : "incorrect") << std::endl;
+        correct &= rejected;
+    }
+
+    std::cout << "gather and scatter: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Elem = double;
+
+//! Reads a second array through a captured device pointer, which the bytes of the functor don't identify.
+struct ScaledByPointer
+{
+    Elem const* scale;
+
+    template<typename TX>
+    ALPAKA_FN_ACC auto operator()(Idx i, TX const& x) const -> Elem
+    {
+        return scale[i] * x[i];
+    }
+};
+
+auto main() -> int
+{
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    Idx const N = 1001;
+    vector_type x(queue, N), y(queue, N);
+    x = iota<Acc, Elem>(queue, N, 1.0);
+    std::vector<Elem> xHost(N);
+    x.download_async(xHost.data(), N).wait();
+
+    bool correct = true;
+
+    // nearest neighbour coupling with clamped boundaries, compared with the host
+    {
+        y = indexed(
+            [] ALPAKA_FN_ACC(Idx i, auto v)
+            {
+                auto const j = static_cast<std::ptrdiff_t>(i);
+                return v.at(j - 1) - 2.0 * v[i] + v.at(j + 1) + static_cast<Elem>(v.size());
+            },
+            x);
+        std::vector<Elem> yHost(N);
+        y.download_async(yHost.data(), N).wait();
+        bool coupled = true;
+        for(Idx i = 0; i < N; ++i)
+        {
+            Elem const left = xHost[i > 0 ? i - 1 : 0];
+            Elem const right = xHost[i + 1 < N ? i + 1 : N - 1];
+            coupled &= yHost[i] == left - 2.0 * xHost[i] + right + static_cast<Elem>(N);
+        }
+        std::cout << "coupling: " << (coupled ? "correct" : "incorrect") << std::endl;
+        correct &= coupled;
+    }
+
+    // an empty input reads as zeros instead of indexing out of bounds
+    {
+        y = indexed(
+            [] ALPAKA_FN_ACC(Idx i, auto v, auto empty) { return v[i] + empty.at(static_cast<std::ptrdiff_t>(i)); },
+            x,
+            fill<Acc>(queue, Elem(1), Idx{0}));
+        auto const sum = y.sum().compute();
+        bool const empty = sum == static_cast<Elem>(N * (N + 1) / 2);
+        std::cout << "empty input: " << (empty ? "correct" : "incorrect") << std::endl;
+        correct &= empty;
+    }
+
+    // a functor with a captured pointer is not memoized: a changed pointee gives a new result
+    {
+        vector_type scale(queue, N);
+        scale = fill<Acc>(queue, Elem(1), N);
+        auto const first = indexed(ScaledByPointer{scale.getPtr()}, x).sum().compute();
+        scale = fill<Acc>(queue, Elem(2), N);
+        auto const second = indexed(ScaledByPointer{scale.getPtr()}, x).sum().compute();
+        bool const fresh = second == 2.0 * first && first == static_cast<Elem>(N * (N + 1) / 2);
+        std::cout << "functor with state: " << (fresh ? "correct" : "incorrect") << std::endl;
+        correct &= fresh;
+    }
+
+    std::cout << "indexed expressions: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+    using mask_type = BitMask<Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    // not a multiple of the 32 bits of a mask word, so the last word is partial
+    Idx const N = 1001;
+    vector_type x(queue, N), selected(queue, N), clamped(queue, N), masked(queue, N);
+    x = linspace<Acc>(queue, Elem(-1), Elem(1), N);
+
+    selected = where(x > 0.0, x, -x);
+    clamped = clamp(x, -0.5, 0.5);
+    auto const positiveSum = where(x > 0.0, x, 0.0).sum().compute();
+    auto const positiveCount = (x > 0.0).count().compute();
+
+    mask_type mask(queue, N);
+    mask = x > 0.5;
+    masked = where(mask && (x < 0.9), x, 0.0);
+    auto const maskCount = mask.count().compute();
+    auto const notMaskCount = (!mask).count().compute();
+
+    std::vector<Elem> xHost(N), selectedHost(N), clampedHost(N), maskedHost(N);
+    x.download_async(xHost.data(), N).wait();
+    selected.download_async(selectedHost.data(), N).wait();
+    clamped.download_async(clampedHost.data(), N).wait();
+    masked.download_async(maskedHost.data(), N).wait();
+
+    bool correct = true;
+    Elem sum = 0;
+    Idx count = 0, above = 0;
+    for(Idx i = 0; i < N; ++i)
+    {
+        Elem const v = xHost[i];
+        correct &= selectedHost[i] == std::abs(v);
+        correct &= clampedHost[i] == std::min(std::max(v, -0.5), 0.5);
+        correct &= maskedHost[i] == (v > 0.5 && v < 0.9 ? v : 0.0);
+        sum += v > 0.0 ? v : 0.0;
+        count += v > 0.0 ? 1 : 0;
+        above += v > 0.5 ? 1 : 0;
+    }
+    correct &= std::abs(positiveSum - sum) < 1e-9 && positiveCount == count;
+    correct &= maskCount == above && notMaskCount == N - above;
+
+    std::cout << "masks and selection, " << positiveCount << " positive elements: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <iostream>
+
+
+bool report(char const* name, bool correct)
+{
+    std::cout << name << ": ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct;
+}
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+
+    Idx const N = 1000;
+    vector_type x(queue, N);
+    x = fill<Acc>(queue, Elem(1), N);
+
+    bool correct = true;
+
+    // trees which are built separately have equal keys, empty functors contribute their type only
+    {
+        auto const first = impl_detail::make_cache_key(sin(x) + x);
+        auto const second = impl_detail::make_cache_key(sin(x) + x);
+        correct &= report("keys of equal trees", first.isCacheable() && first == second);
+    }
+
+    // a reduction is reused while the vector is unchanged and recomputed after it was assigned
+    {
+        auto const before = x.sum().compute();
+        auto const again = x.sum().compute();
+        x = x + 1.0;
+        auto const after = x.sum().compute();
+        correct &= report(
+            "reductions after assignments",
+            before == Elem(N) && again == before && after == Elem(2 * N));
+    }
+
+    // vectors over user buffers have no write version: they are never cached, but two of them are still
+    // told apart, so sub-trees over them aren't shared by mistake
+    {
+        alpaka::Vec<alpaka::DimInt<1>, Idx> const extent(N);
+        Buf bufA = alpaka::allocBuf<Elem, Idx>(dev, extent);
+        Buf bufB = alpaka::allocBuf<Elem, Idx>(dev, extent);
+        vector_type a(queue, bufA), b(queue, bufB);
+        a = fill<Acc>(queue, Elem(1), N);
+        b = fill<Acc>(queue, Elem(2), N);
+
+        auto const keyA = impl_detail::make_identity_key(sin(a));
+        auto const keyB = impl_detail::make_identity_key(sin(b));
+        bool const distinct = !keyA.isCacheable() && !keyA.isSameTree(keyB) && keyA.isSameTree(keyA);
+
+        auto const sumA = a.sum().compute();
+        a = fill<Acc>(queue, Elem(3), N);
+        bool const recomputed = sumA == Elem(N) && a.sum().compute() == Elem(3 * N);
+        correct &= report("unversioned vectors", distinct && recomputed);
+    }
+
+    // a generator which reads memory through a captured pointer isn't cached, the built in ones still are
+    {
+        Elem const* const data = x.getPtr();
+        auto const reader = generate<Acc>(queue, N, [data] ALPAKA_FN_ACC(Idx i) { return data[i]; });
+        x = fill<Acc>(queue, Elem(1), N);
+        auto const before = reader.sum().compute();
+        x = fill<Acc>(queue, Elem(2), N);
+        auto const after = reader.sum().compute();
+
+        bool const keys = !impl_detail::make_cache_key(reader).isCacheable()
+                          && impl_detail::make_cache_key(iota<Acc, Elem>(queue, N)).isCacheable()
+                          && impl_detail::make_cache_key(linspace<Acc>(queue, Elem(0), Elem(1), N)).isCacheable();
+        correct &= report("generators with state", keys && before == Elem(N) && after == Elem(2 * N));
+    }
+
+    // a single value of linspace is its start
+    {
+        vector_type single(queue, 1);
+        single = linspace<Acc>(queue, Elem(2), Elem(5), Idx{1});
+        correct &= report("single value linspace", single.sum().compute() == Elem(2));
+    }
+
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+
+struct SquareFunctor
+{
+    using return_type = double;
+
+    ALPAKA_FN_ACC auto operator()(double x) const -> double
+    {
+        return x * x;
+    }
+};
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using FloatBuf = alpaka::Buf<Acc, float, alpaka::DimInt<1>, Idx>;
+    using DoubleBuf = alpaka::Buf<Acc, double, alpaka::DimInt<1>, Idx>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    bool correct = true;
+
+    // the largest and the smallest words give uniforms strictly inside (0, 1)
+    {
+        impl_detail::Philox4x32 bits(0, 0, 0);
+        for(auto& word : bits.v)
+            word = 0xFFFFFFFFu;
+        bool inside = bits.uniform<float>(0) < 1.0f && bits.uniform<double>(0) < 1.0;
+        for(auto& word : bits.v)
+            word = 0u;
+        inside &= bits.uniform<float>(0) > 0.0f && bits.uniform<double>(0) > 0.0;
+        std::cout << "uniform bounds: " << (inside ? "correct" : "incorrect") << std::endl;
+        correct &= inside;
+    }
+
+    Idx const N = Idx{1} << 20;
+    double const n = static_cast<double>(N);
+
+    // uniform floats in [2, 3): range, mean and variance within 5 standard errors
+    {
+        Vector<FloatBuf, Queue, Acc> u(queue, N);
+        u = random<Acc>(queue, N, UniformDistribution<float>{2.0f, 3.0f}, 1234);
+        auto const lo = u.min().compute();
+        auto const hi = u.max().compute();
+        Vector<DoubleBuf, Queue, Acc> centered(queue, N);
+        centered = u.apply(CastFunctor<double, float>{}) - 2.5;
+        auto const mean = centered.sum().compute() / n;
+        auto const variance = centered.apply(SquareFunctor{}).sum().compute() / n;
+
+        bool const uniform = lo >= 2.0f && hi < 3.0f && std::abs(mean) < 5.0 * std::sqrt(1.0 / 12.0 / n)
+                             && std::abs(variance - 1.0 / 12.0) < 5.0 * std::sqrt(1.0 / 180.0 / n);
+        std::cout << "uniform distribution in [" << lo << ", " << hi << "], mean " << mean + 2.5 << ": "
+                  << (uniform ? "correct" : "incorrect") << std::endl;
+        correct &= uniform;
+    }
+
+    // normal doubles: mean and variance, and the stream selects another sequence
+    {
+        Vector<DoubleBuf, Queue, Acc> g(queue, N), other(queue, N);
+        g = random<Acc>(queue, N, NormalDistribution<double>{0.0, 2.0}, 1234);
+        other = random<Acc>(queue, N, NormalDistribution<double>{0.0, 2.0}, 1234, 1);
+        auto const mean = g.sum().compute() / n;
+        auto const variance = g.apply(SquareFunctor{}).sum().compute() / n;
+        auto const differences = (g != other).count().compute();
+
+        bool const normal = std::abs(mean) < 5.0 * 2.0 / std::sqrt(n)
+                            && std::abs(variance - 4.0) < 5.0 * 4.0 * std::sqrt(2.0 / n) && differences == N;
+        std::cout << "normal distribution, variance " << variance << ": " << (normal ? "correct" : "incorrect")
+                  << std::endl;
+        correct &= normal;
+    }
+
+    return correct ? 0 : 1;
+}
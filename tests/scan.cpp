@@ -0,0 +1,77 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <iostream>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    Queue queue(dev);
+
+    using Elem = long;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+
+    // several tiles with a partial last one, so the look-back is exercised
+    Idx const N = 100003;
+    alpaka::Vec<alpaka::DimInt<1>, Idx> const extent(N);
+    std::vector<Elem> host(N);
+    for(Idx i = 0; i < N; ++i)
+        host[i] = static_cast<Elem>(i % 7) - 3;
+
+    Vector<Buf, Queue, Acc> x(queue, N);
+    auto hostView = alpaka::createView(devHost, host.data(), extent);
+    alpaka::memcpy(queue, x.getBuffer(), hostView);
+
+    // as assignment source
+    Vector<Buf, Queue, Acc> inclusive(queue, N), exclusive(queue, N), combined(queue, N);
+    inclusive = x.cumsum();
+    exclusive = x.exclusive_scan(AddFunctor<Elem, Elem>{}, Elem{10});
+
+    // as operand of a cwise tree: x_i + (x_0 + ... + x_i) - (x_0 + ... + x_i)
+    combined = x + x.cumsum() - x.cumsum();
+
+    // the elements of the scan are those of the functor, so a scan over a mask counts
+    using CountBuf = alpaka::Buf<Acc, Idx, alpaka::DimInt<1>, Idx>;
+    Vector<CountBuf, Queue, Acc> positives(queue, N);
+    positives = (x > Elem{0}).inclusive_scan(AddFunctor<Idx, Idx>{});
+
+    std::vector<Elem> inclusiveHost(N), exclusiveHost(N), combinedHost(N);
+    std::vector<Idx> positivesHost(N);
+    alpaka::memcpy(queue, alpaka::createView(devHost, inclusiveHost.data(), extent), inclusive.getConstBuffer());
+    alpaka::memcpy(queue, alpaka::createView(devHost, exclusiveHost.data(), extent), exclusive.getConstBuffer());
+    alpaka::memcpy(queue, alpaka::createView(devHost, combinedHost.data(), extent), combined.getConstBuffer());
+    alpaka::memcpy(queue, alpaka::createView(devHost, positivesHost.data(), extent), positives.getConstBuffer());
+    alpaka::wait(queue);
+
+    bool correct = true;
+    Elem running = 0;
+    Idx count = 0;
+    for(Idx i = 0; i < N; ++i)
+    {
+        correct &= exclusiveHost[i] == 10 + running;
+        running += host[i];
+        correct &= inclusiveHost[i] == running;
+        correct &= combinedHost[i] == host[i];
+        count += host[i] > 0 ? 1 : 0;
+        correct &= positivesHost[i] == count;
+    }
+
+    std::cout << "Scan of " << N << " elements, total = " << inclusiveHost[N - 1] << ": ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+
+    return correct ? 0 : 1;
+}
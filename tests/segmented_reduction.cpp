@@ -0,0 +1,157 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+using Idx = std::size_t;
+using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+using Elem = double;
+using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+using vector_type = Vector<Buf, Queue, Acc>;
+
+//! epsilon_p / n * (sin_sum cos(x_i) - cos_sum sin(x_i)) of the segment p of x_i.
+struct segment_coupling
+{
+    Idx n;
+
+    template<typename TX, typename TSums, typename TEpsilon>
+    ALPAKA_FN_ACC auto operator()(Idx i, TX const& x, TSums const& sums, TEpsilon const& epsilon) const -> Elem
+    {
+        using std::cos;
+        using std::sin;
+        Idx const p = i / n;
+        auto const sum = sums[p];
+        Elem const xi = x[i];
+        return epsilon[p] / Elem(n) * (sum.sin * cos(xi) - sum.cos * sin(xi));
+    }
+};
+
+bool report(char const* name, bool correct)
+{
+    std::cout << name << ": ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+    return correct;
+}
+
+auto main() -> int
+{
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+    Queue queue(dev);
+
+    bool correct = true;
+
+    // segments which are not a multiple of the block size and the number of accumulators, small integers
+    // are summed exactly
+    {
+        Idx const P = 7;
+        Idx const N = 1003;
+        std::vector<Elem> host(P * N);
+        for(Idx i = 0; i < P * N; ++i)
+            host[i] = static_cast<Elem>((i * 7919) % 101);
+
+        vector_type x(queue, P * N);
+        x.upload_async(host.data(), P * N).wait();
+
+        vector_type sums(queue, P), maxima(queue, P);
+        sums = segmented_sum(x, N);
+        maxima = segmented_reduce(x, N, MaxFunctor<Elem, Elem>{});
+
+        std::vector<Elem> sumsHost(P), maximaHost(P);
+        sums.download_async(sumsHost.data(), P).wait();
+        maxima.download_async(maximaHost.data(), P).wait();
+
+        bool equal = true;
+        for(Idx p = 0; p < P; ++p)
+        {
+            Elem sum = 0, maximum = host[p * N];
+            for(Idx i = p * N; i < (p + 1) * N; ++i)
+            {
+                sum += host[i];
+                maximum = std::max(maximum, host[i]);
+            }
+            equal &= (sumsHost[p] == sum) && (maximaHost[p] == maximum);
+        }
+        correct &= report("segmented sum and maximum", equal);
+    }
+
+    // broadcasting and repeating segments
+    {
+        Idx const P = 3;
+        Idx const N = 5;
+        vector_type values(queue, N), broadcast(queue, N * P), repeated(queue, N * P);
+        values = iota<Acc, Elem>(queue, N);
+        broadcast = broadcast_segments(values, P);
+        repeated = repeat_segments(values, P);
+
+        std::vector<Elem> broadcastHost(N * P), repeatedHost(N * P);
+        broadcast.download_async(broadcastHost.data(), N * P).wait();
+        repeated.download_async(repeatedHost.data(), N * P).wait();
+
+        bool equal = true;
+        for(Idx i = 0; i < N * P; ++i)
+            equal &= (broadcastHost[i] == static_cast<Elem>(i / P)) && (repeatedHost[i] == static_cast<Elem>(i % N));
+        correct &= report("broadcast and repeated segments", equal);
+    }
+
+    // a sweep over the coupling of a phase oscillator ensemble: one batched state against one run per value
+    {
+        Idx const N = 1000;
+        Idx const steps = 20;
+        Elem const dt = 0.05;
+        std::vector<Elem> const epsilons{0.0, 0.5, 2.0, 4.0};
+        Idx const P = epsilons.size();
+
+        vector_type omega(queue, N), init(queue, N);
+        omega = random<Acc>(queue, N, CauchyDistribution<Elem>{0.0, 1.0}, 1);
+        init = random<Acc>(queue, N, UniformDistribution<Elem>{0.0, 6.283185307179586}, 2);
+
+        std::vector<Elem> sequential(P * N);
+        for(Idx p = 0; p < P; ++p)
+        {
+            vector_type x(queue, N), next(queue, N);
+            x = 1.0 * init;
+            for(Idx step = 0; step < steps; ++step)
+            {
+                auto const sums = x.sincos().sum().compute();
+                Elem const a = epsilons[p] / Elem(N) * sums.sin;
+                Elem const b = epsilons[p] / Elem(N) * sums.cos;
+                next = x + dt * (omega + a * cos(x) - b * sin(x));
+                std::swap(x, next);
+            }
+            x.download_async(sequential.data() + p * N, N).wait();
+        }
+
+        vector_type epsilon(queue, P), omegaBatch(queue, P * N), x(queue, P * N), next(queue, P * N);
+        epsilon.upload_async(epsilons.data(), P).wait();
+        omegaBatch = repeat_segments(omega, P);
+        x = repeat_segments(init, P);
+        for(Idx step = 0; step < steps; ++step)
+        {
+            auto const sums = segmented_sum(x.sincos(), N);
+            next = x + dt * (omegaBatch + indexed(segment_coupling{N}, x, sums, epsilon));
+            std::swap(x, next);
+        }
+        std::vector<Elem> batched(P * N);
+        x.download_async(batched.data(), P * N).wait();
+
+        // the mean fields are summed in a different order
+        Elem deviation = 0;
+        for(Idx i = 0; i < P * N; ++i)
+            deviation = std::max(deviation, std::abs(batched[i] - sequential[i]));
+        std::cout << "largest deviation of the batched sweep: " << deviation << std::endl;
+        correct &= report("batched parameter sweep", deviation < 1e-10);
+    }
+
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using bundle_type = StateBundle<Buf, Queue, Acc, 2>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    enum
+    {
+        position,
+        velocity
+    };
+
+    Idx const n = 1001;
+    std::vector<Elem> host(2 * n);
+    for(Idx i = 0; i < n; ++i)
+    {
+        host[position * n + i] = static_cast<Elem>(i);
+        host[velocity * n + i] = -0.5 * static_cast<Elem>(i);
+    }
+
+    bundle_type x(queue, n), dxdt(queue, n);
+    x.upload_async(host.data(), 2 * n).wait();
+    bool correct = true;
+
+    // all components are written by one kernel
+    {
+        dxdt.assign(x.component(velocity), -x.component(position) - 0.15 * x.component(velocity));
+        std::vector<Elem> result(2 * n);
+        dxdt.download_async(result.data(), 2 * n).wait();
+        bool assigned = true;
+        for(Idx i = 0; i < n; ++i)
+        {
+            Elem const p = host[position * n + i];
+            Elem const v = host[velocity * n + i];
+            assigned &= result[position * n + i] == v;
+            assigned &= std::abs(result[velocity * n + i] - (-p - 0.15 * v)) < 1e-12;
+        }
+        std::cout << "component assignment: " << (assigned ? "correct" : "incorrect") << std::endl;
+        correct &= assigned;
+    }
+
+    // in place, every component reads the old values of the others: the components are swapped
+    {
+        x.assign(x.component(velocity), x.component(position));
+        std::vector<Elem> result(2 * n);
+        x.download_async(result.data(), 2 * n).wait();
+        bool swapped = true;
+        for(Idx i = 0; i < n; ++i)
+            swapped &= result[position * n + i] == host[velocity * n + i]
+                       && result[velocity * n + i] == host[position * n + i];
+        std::cout << "in place swap: " << (swapped ? "correct" : "incorrect") << std::endl;
+        correct &= swapped;
+    }
+
+    return correct ? 0 : 1;
+}
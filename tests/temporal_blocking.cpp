@@ -0,0 +1,74 @@
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    auto const devHost = alpaka::getDevByIdx<alpaka::DevCpu>(0u);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    Queue queue(dev);
+
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    // several tiles with a partial last one, the stencil reaches further to the right than to the left
+    Idx const N = 100003;
+    Idx const steps = 10;
+    alpaka::Vec<alpaka::DimInt<1>, Idx> const extent(N);
+    std::vector<Elem> host(N);
+    for(Idx i = 0; i < N; ++i)
+        host[i] = static_cast<Elem>((i * 7919) % 101) / 101.0;
+
+    auto update = [](auto const& u)
+    {
+        using state = std::decay_t<decltype(u)>;
+        return u + 0.1 * (ShiftExpression<state, -1>(u) - 2.0 * u + ShiftExpression<state, 2>(u));
+    };
+
+    // reference: one assignment per step
+    vector_type reference(queue, N), next(queue, N);
+    alpaka::memcpy(queue, reference.getBuffer(), alpaka::createView(devHost, host.data(), extent));
+    for(Idx step = 0; step < steps; ++step)
+    {
+        next = update(reference);
+        std::swap(reference, next);
+    }
+    std::vector<Elem> referenceHost(N);
+    alpaka::memcpy(queue, alpaka::createView(devHost, referenceHost.data(), extent), reference.getConstBuffer());
+    alpaka::wait(queue);
+
+    bool correct = true;
+    for(std::size_t depth : {1u, 3u, 4u, 16u})
+    {
+        vector_type x(queue, N);
+        alpaka::memcpy(queue, x.getBuffer(), alpaka::createView(devHost, host.data(), extent));
+        advance_stencil(x, steps, update, depth);
+
+        std::vector<Elem> result(N);
+        alpaka::memcpy(queue, alpaka::createView(devHost, result.data(), extent), x.getConstBuffer());
+        alpaka::wait(queue);
+
+        bool equal = result == referenceHost;
+        std::cout << steps << " steps with depth " << depth << ": ";
+        if(equal)
+            std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+        else
+            std::cout << "\x1b[1;31mincorrect!\x1b[m\n";
+        correct &= equal;
+    }
+
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+// small tiles, so the vectors span many tiles and the last one is partial
+#define EXPR_EVAL_TILE_BYTES 4096u
+
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::Blocking>;
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    Idx const N = 10007;
+    vector_type x(queue, N), y(queue, N);
+    x = linspace<Acc>(queue, Elem(-3), Elem(3), N);
+
+    // the materialized sub-tree is read twice at the index which is computed, on CPU accelerators it is
+    // evaluated into a per-thread tile instead of a temporary of N elements
+    auto const inner = sin(x) + 0.5 * x;
+    MaterializeExpression<std::decay_t<decltype(inner)>> const materialized(inner);
+    static_assert(
+        !std::is_same_v<alpaka::Dev<Acc>, alpaka::DevCpu>
+            || impl_detail::use_tiled_evaluation<Acc, std::decay_t<decltype(2.0 * materialized - materialized + x)>>,
+        "The tree should be evaluated tile by tile on CPU accelerators");
+    y = 2.0 * materialized - materialized + x;
+
+    std::vector<Elem> xHost(N), yHost(N);
+    x.download_async(xHost.data(), N).wait();
+    y.download_async(yHost.data(), N).wait();
+
+    Elem deviation = 0;
+    for(Idx i = 0; i < N; ++i)
+    {
+        Elem const m = std::sin(xHost[i]) + 0.5 * xHost[i];
+        deviation = std::max(deviation, std::abs(yHost[i] - (2.0 * m - m + xHost[i])));
+    }
+
+    bool const correct = deviation < 1e-12;
+    std::cout << "tiled evaluation: ";
+    if(correct)
+        std::cout << "\x1b[1;32mcorrect!\x1b[m\n";
+    else
+        std::cout << "\x1b[1;31mincorrect!\x1b[m deviation " << deviation << "\n";
+    return correct ? 0 : 1;
+}
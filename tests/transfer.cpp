@@ -0,0 +1,73 @@
+// small chunks, so a transfer is staged in several pieces
+#define EXPR_TRANSFER_CHUNK_BYTES 4096u
+
+#include "expressions/expressions.hpp"
+
+#include <alpaka/alpaka.hpp>
+#include <alpaka/example/ExampleDefaultAcc.hpp>
+
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+
+auto main() -> int
+{
+    using Idx = std::size_t;
+    using Acc = alpaka::ExampleDefaultAcc<alpaka::DimInt<1>, Idx>;
+    using Queue = alpaka::Queue<Acc, alpaka::NonBlocking>;
+    using Elem = double;
+    using Buf = alpaka::Buf<Acc, Elem, alpaka::DimInt<1>, Idx>;
+    using vector_type = Vector<Buf, Queue, Acc>;
+
+    auto const dev = alpaka::getDevByIdx<Acc>(0);
+    Queue queue(dev), copyQueue(dev);
+    std::cout << "Using alpaka accelerator: " << alpaka::getAccName<Acc>() << std::endl;
+
+    Idx const N = 10007;
+    std::vector<Elem> twos(N, 2.0), host(N);
+    vector_type x(queue, N);
+    bool correct = true;
+
+    // the upload on the copy queue starts after the assignment on the queue of the vector, and the sum
+    // which was memoized before it is not reused
+    {
+        x = fill<Acc>(queue, Elem(1), N);
+        auto const before = x.sum().compute();
+        auto handle = x.upload_async(copyQueue, twos.data(), N);
+        handle.wait();
+        auto const after = x.sum().compute();
+        bool const uploaded = before == Elem(N) && after == Elem(2 * N);
+        std::cout << "upload: " << (uploaded ? "correct" : "incorrect") << std::endl;
+        correct &= uploaded;
+    }
+
+    // the download on the copy queue waits for the kernel on the queue of the vector, which is still
+    // running because the assignment doesn't wait
+    {
+        {
+            impl_detail::AsyncEvaluationScope async;
+            x = x + 1.0;
+        }
+        x.download_async(copyQueue, host.data(), N).wait();
+        bool downloaded = true;
+        for(Idx i = 0; i < N; ++i)
+            downloaded &= host[i] == 3.0;
+        std::cout << "download: " << (downloaded ? "correct" : "incorrect") << std::endl;
+        correct &= downloaded;
+    }
+
+    // a key which is built while an upload is in flight doesn't match the one after it
+    {
+        auto handle = x.upload_async(copyQueue, twos.data(), N);
+        auto const during = impl_detail::make_cache_key(x);
+        handle.wait();
+        // on CPU devices the data is copied before upload_async returns
+        bool const invalidated
+            = std::is_same_v<alpaka::Dev<Acc>, alpaka::DevCpu> || impl_detail::make_cache_key(x) != during;
+        std::cout << "invalidation on completion: " << (invalidated ? "correct" : "incorrect") << std::endl;
+        correct &= invalidated;
+    }
+
+    return correct ? 0 : 1;
+}